@@ -0,0 +1,296 @@
+#!/usr/bin/env python3
+# encoding:utf8
+
+#
+# badged.py : badge flashing service for the event desk
+#
+# Replaces 'make clear_eeprom textconvert eeflash' per visitor (sm.py,
+# external.sh): every name is substituted into the template (text.orig) and
+# converted in process by libblinken (the converter of textconv, ctypes),
+# the image is written with a single avrdude run. Names come in on a unix socket (sm.py) or stdin, one
+# per line; jobs are taken in order by one worker per programmer (-P, once each).
+#
+#   ./badged.py [-s socket] [-t template] [-p picture] [-a avrdude command] [-P port ..]
+#
+# socket protocol, one line each:
+#   name <name>      queue a badge       -> ok <id> <jobs ahead>
+#   status [id]      job states          -> one line per job, then 'end'
+#   wait <id>        block until done    -> done <id> <state> <seconds>
+#
+#  Copyright (C) 2011 Manuel Jerger <nom@nomnom.de>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+import argparse
+import ctypes
+import os
+import re
+import shlex
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+try:
+	import queue
+except ImportError:
+	import Queue as queue
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+TOOLS = os.path.join(HERE, '..', 'tools')
+LIBBLINKEN = os.path.join(TOOLS, 'libblinken.so')
+
+BL_MAXEEPROM = 1024
+BL_EE = 1
+
+
+class Template(object):
+	"""the template text, converted with libblinken once per name. the
+	pictures are read once"""
+
+	def __init__(self, template, picture, placeholder, profile):
+		if not os.path.exists(LIBBLINKEN):
+			subprocess.check_call(['make', '-C', TOOLS, 'libblinken.so'])
+		self.lib = ctypes.CDLL(LIBBLINKEN)
+		self.lib.bl_convert_buf.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_char_p,
+		                                    ctypes.c_int, ctypes.c_char_p, ctypes.c_int]
+		self.lib.bl_profile.restype = ctypes.c_void_p
+		self.lib.bl_profile.argtypes = [ctypes.c_char_p]
+		self.profile = profile.encode()
+		if not self.lib.bl_profile(self.profile):
+			raise ValueError('unknown profile %s' % profile)
+		self.lib.bl_pictures_open.restype = ctypes.c_void_p
+		self.lib.bl_pictures_open.argtypes = [ctypes.c_char_p]
+
+		self.pics = None
+		if picture:
+			self.pics = self.lib.bl_pictures_open(picture.encode())
+			if not self.pics:
+				raise ValueError('%s is no 64x8 pixel pgm' % picture)
+
+		self.placeholder = placeholder.encode('utf8')
+		self.text = open(template, 'rb').read()
+		if self.placeholder not in self.text:
+			raise ValueError('%s not found in %s' % (placeholder, template))
+		# room for the name: a name too long by far is over by exactly that much
+		probe = BL_MAXEEPROM * 2
+		self.budget = probe - self.convert(self.text.replace(self.placeholder, b'x' * probe))[1]
+
+	def convert(self, text):
+		# image, or None and the bytes over the budget
+		out = ctypes.create_string_buffer(BL_MAXEEPROM)
+		n = self.lib.bl_convert_buf(text, len(text), self.pics, self.profile, BL_EE, out, BL_MAXEEPROM)
+		if n < 0:
+			return None, -n
+		return bytearray(out.raw[:n]), 0
+
+	def render(self, name):
+		# a name is text, not commands
+		name = name.strip().encode('utf8').replace(b'\\', b'\\\\')
+		image, n = self.convert(self.text.replace(self.placeholder, name))
+		if image is None:
+			raise ValueError('name too long, %d bytes over' % n)
+		return image
+
+
+class Job(object):
+
+	def __init__(self, id, name):
+		self.id = id
+		self.name = name
+		self.state = 'queued'
+		self.tries = 0
+		self.t_in = time.time()
+		self.t_start = self.t_done = None
+		self.error = ''
+		self.done = threading.Event()
+
+	def line(self):
+		t = (self.t_done or time.time()) - self.t_in
+		s = '%d %s %s %.1fs' % (self.id, self.state, self.name, t)
+		if self.t_start and self.t_done:
+			s += ' (flash %.1fs, %d tries)' % (self.t_done - self.t_start, self.tries)
+		if self.error:
+			s += ' ' + self.error
+		return s
+
+
+class Service(object):
+
+	def __init__(self, template, retries, log):
+		self.template = template
+		self.retries = retries
+		self.log = log
+		self.queue = queue.Queue()
+		self.jobs = {}
+		self.lock = threading.Lock()
+		self.nextid = 1
+		self.tmp = tempfile.mkdtemp(prefix='badged')
+
+	def submit(self, name):
+		with self.lock:
+			job = Job(self.nextid, name)
+			self.nextid += 1
+			self.jobs[job.id] = job
+		try:
+			job.image = self.template.render(name)
+		except ValueError as e:
+			job.state, job.error, job.t_done = 'failed', str(e), time.time()
+			job.done.set()
+			return job
+		self.queue.put(job)
+		return job
+
+	def ahead(self):
+		return self.queue.qsize() - 1
+
+	def flash(self, job, avrdude):
+		path = os.path.join(self.tmp, 'badge%d.bin' % job.id)
+		open(path, 'wb').write(job.image)
+		cmd = avrdude + ['-U', 'eeprom:w:%s:r' % path]
+		while job.tries <= self.retries:
+			job.tries += 1
+			p = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+			out = p.communicate()[0].decode('utf8', 'replace')
+			if p.returncode == 0:
+				job.error = ''
+				break
+			job.error = out.strip().splitlines()[-1] if out.strip() else 'avrdude failed'
+		os.unlink(path)
+		return p.returncode == 0
+
+	def worker(self, avrdude):
+		while True:
+			job = self.queue.get()
+			job.state = 'flashing'
+			job.t_start = time.time()
+			ok = self.flash(job, avrdude)
+			job.t_done = time.time()
+			job.state = 'done' if ok else 'failed'
+			self.log(job.line())
+			job.done.set()
+
+	def stats(self):
+		with self.lock:
+			jobs = list(self.jobs.values())
+		done = [j for j in jobs if j.state == 'done']
+		failed = len([j for j in jobs if j.state == 'failed'])
+		if not done:
+			return 'no badges yet, %d failed' % failed
+		turn = sum(j.t_done - j.t_in for j in done) / len(done)
+		hw = sum(j.t_done - j.t_start for j in done) / len(done)
+		return '%d badges, %d failed, mean turnaround %.1fs, of it %.1fs avrdude' % (len(done), failed, turn, hw)
+
+	def handle(self, line):
+		cmd, _, arg = line.partition(' ')
+		if cmd == 'name' and arg.strip():
+			job = self.submit(arg)
+			if job.state == 'failed':
+				return ['err %d %s' % (job.id, job.error)]
+			return ['ok %d %d' % (job.id, self.ahead())]
+		if cmd == 'status':
+			with self.lock:
+				jobs = [self.jobs[int(arg)]] if arg.strip().isdigit() and int(arg) in self.jobs else list(self.jobs.values())
+			return [j.line() for j in jobs] + [self.stats(), 'end']
+		if cmd == 'wait' and arg.strip().isdigit() and int(arg) in self.jobs:
+			job = self.jobs[int(arg)]
+			job.done.wait()
+			return ['done %d %s %.1f' % (job.id, job.state, job.t_done - job.t_in)]
+		return ['err unknown command']
+
+	def client(self, conn):
+		f = conn.makefile('rw')
+		try:
+			for line in f:
+				line = line.rstrip('\r\n')
+				if line:
+					f.write('\n'.join(self.handle(line)) + '\n')
+					f.flush()
+		except (IOError, socket.error):
+			pass
+		conn.close()
+
+	def listen(self, path):
+		if os.path.exists(path):
+			os.unlink(path)
+		s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+		s.bind(path)
+		s.listen(4)
+		while True:
+			conn = s.accept()[0]
+			t = threading.Thread(target=self.client, args=(conn,))
+			t.daemon = True
+			t.start()
+
+
+def firmware_profiles():
+	"""profiles the firmware builds for, PROFILES_FIRMWARE in profiles.h"""
+	src = open(os.path.join(HERE, 'profiles.h')).read()
+	m = re.search(r'#define\s+PROFILES_FIRMWARE\s+"([^"]*)"', src)
+	return m.group(1).split() if m else []
+
+
+def main():
+	ap = argparse.ArgumentParser(description='Flash badges: names into the blinken64 eeprom, from a queue.')
+	ap.add_argument('-s', '--socket', default='/tmp/badged.sock', help='unix socket (default %(default)s)')
+	ap.add_argument('-t', '--template', default=os.path.join(HERE, 'text.orig'), help='text w/ the placeholder (default text.orig)')
+	ap.add_argument('-n', '--placeholder', default='VORNAME', help='replaced by the name (default %(default)s)')
+	ap.add_argument('-p', '--picture', help='eeprom pictures (64x8 pixel pgm), like textconv -p')
+	ap.add_argument('--profile', default='blinken64', help='device profile, see profiles.h (default %(default)s)')
+	ap.add_argument('-a', '--avrdude', default='avrdude -c usbasp -p attiny4313',
+	                help='programmer command w/o -P, -P and -U are appended (default "%(default)s")')
+	ap.add_argument('-P', '--port', action='append', default=[], help='programmer port, once per programmer (default usb)')
+	ap.add_argument('-r', '--retries', type=int, default=1, help='retries per badge (default %(default)s)')
+	ap.add_argument('--stdin', action='store_true', help='read names from stdin too')
+	args = ap.parse_args()
+	if args.profile not in firmware_profiles():
+		ap.error('profile %s: no pin map for it yet, the firmware builds for %s' % (args.profile, ', '.join(firmware_profiles())))
+
+	def log(s):
+		sys.stdout.write(time.strftime('%H:%M:%S ') + s + '\n')
+		sys.stdout.flush()
+
+	template = Template(args.template, args.picture, args.placeholder, args.profile)
+	log('template %s: %d bytes left for the name' % (args.template, template.budget))
+
+	service = Service(template, args.retries, log)
+	for port in args.port or ['usb']:
+		t = threading.Thread(target=service.worker, args=(shlex.split(args.avrdude) + ['-P', port],))
+		t.daemon = True
+		t.start()
+
+	t = threading.Thread(target=service.listen, args=(args.socket,))
+	t.daemon = True
+	t.start()
+
+	try:
+		if args.stdin:
+			for line in sys.stdin:
+				if line.strip():
+					log(' '.join(service.handle('name ' + line.strip())))
+			for job in list(service.jobs.values()):
+				job.done.wait()
+		else:
+			while True:
+				time.sleep(3600)
+	except KeyboardInterrupt:
+		pass
+	log(service.stats())
+
+
+if __name__ == '__main__':
+	main()
@@ -3,15 +3,18 @@
  *
  *  8x8 pixel LED display for text scrolling
  *   - contains a complete ASCII (7 Bit) font with variable width chars
- *   - controllchars (0-31) for speed, wait, spacing, invert and pictures
- *   - 128 char message inkl 8 custom pictures stored in EEPROM
+ *   - controllchars (0-31) for speed, wait, spacing, invert, pictures and fonts
+ *   - 128 char message inkl 8 custom pictures stored in EEPROM (more on the
+ *     larger parts, see profiles.h)
  *   - data input and output via one pin each
  *   - one pushbutton on the input pin
  *   - automatic data-in detection
  *   - reprogramming mode (eeprom rewrite via data in)
+ *   - counters of the link for the host, read via the chain (_TELEMETRY_)
  *
  *
- *  ATTENTION: compile with avr-gcc (GCC) 4.3.4  to get the best results
+ *  make footprint: flash, sram, stack and ISR cycles w/ the avr-gcc at hand,
+ *  per configuration and feature (this was tuned w/ avr-gcc 4.3.4)
  *
  *
  *  Copyright (C) 2011 Manuel Jerger <nom@nomnom.de>
@@ -37,10 +40,17 @@
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 #include <avr/eeprom.h>
+#if defined(_FRAME_CHECK_) || defined(_TELEMETRY_)
+#include <util/crc16.h>
+#endif
 
 //----------------------------------------------------------------------
 
-#include "font.h"
+#include "profiles.h"
+#ifndef FONT
+#define FONT "font.h"           // make subset: font-subset.h
+#endif
+#include FONT
 #include "display.h"
 #include "comm.h"
 
@@ -49,12 +59,20 @@
 
 void delay(uint16_t delay);
 //void delay_ms(uint16_t delay);
+void transmit(uint8_t b);
 
 //----------------------------------------------------------------------
 // some static data
 
 #define EEPROM_BEGIN    0x02
-#define EEPROM_END      0x80
+#define EEPROM_END      EEPROM_SIZE
+
+// eeprom address, one byte as long as the eeprom allows
+#if EEPROM_SIZE > 255
+typedef uint16_t eeaddr_t;
+#else
+typedef uint8_t eeaddr_t;
+#endif
 
 #define MSG_SEP         0x00
 #define END_OF_MEMORY   0x01
@@ -70,6 +88,8 @@ void delay(uint16_t delay);
 
 #define INVERT          0x0A
 #define HALT            0x0B
+#define FONT_X          0x0C    // + font: 0..FONTS-1
+#define PICTURE_X       0x0D    // + slot: pictures 9..PICTURES
 
 #define WAIT1           0x0E
 #define WAIT2           0x0F
@@ -92,6 +112,13 @@ void delay(uint16_t delay);
 #define SPACER2         0x1F
 #define SPACE           0x20
 
+#define FLIP_KEY        0xF0    // + 8 columns: a flipbook frame, see below
+#define FLIP_DELTA      0xF1    // + mask + the columns that change (xor)
+
+#if lastchar >= FLIP_KEY
+#error "the font has chars in the place of the flipbook codes"
+#endif
+
 #define spacing  1              // between chars
 
 const uint16_t waits[8] = { 50, 100, 250, 500, 1000, 1500, 2000, 5000}; // in ms, delay per wait symbol
@@ -144,9 +171,42 @@ volatile uint8_t rxDone=0;   // '1' signals a newly arrived byte
 volatile uint16_t comctr;    // counter for communication timing
 
 // rx bit counter
-volatile int8_t bitpos = -1; // -1=rx idle, 0-7=pos, 8=done
+volatile int8_t bitpos = -1; // -1=rx idle, 0-7=pos, 8=done (9 w/ parity)
 volatile uint8_t bitmask = 0; // so we only have to shift once per iteration
 
+// error detection: even parity per byte, crc + ACK/NAK per PROG frame
+#ifdef _FRAME_CHECK_
+volatile uint8_t rxParity;              // xor of all bits received so far
+volatile uint16_t rxErrors = 0;         // bytes dropped (parity)
+uint16_t frameErrors = 0;               // PROG frames NAKed (crc, length)
+#endif
+
+// auto-baud: the bit threshold is measured from the init sequence in PROG mode
+#ifdef _AUTOBAUD_
+volatile uint8_t com_t_bit = COM_T_BIT;  // threshold for bit decoding
+volatile uint16_t rxSum;                 // sum of the 8 data pulse lengths of the current byte
+volatile uint8_t rxCal;                  // current byte is 0x55 / 0xAA at its own timing
+uint8_t rxLast, rxUp;                    // pulse before: length, longer than the one before it
+#else
+#define com_t_bit COM_T_BIT
+#endif
+
+// telemetry: what went wrong since power on, see comm.h. 16 bit counters,
+// wrapping, counted where it happens (most of them not every ISR call)
+#ifdef _TELEMETRY_
+#if defined(_MASTER_ONLY_) || defined(_SLAVE_ONLY_)
+#error "telemetry needs the input and the output pin"
+#endif
+volatile uint16_t tlm[COM_TLM_COUNTERS];
+#define count(_c) { tlm[_c]++; }
+
+// the query in the columns of a SLAVE, see telemetry()
+enum TLM_STATES {TLM_IDLE, TLM_SCAN, TLM_PASS, TLM_OWN};
+volatile uint8_t tlmState = TLM_IDLE;
+#else
+#define count(_c) {}
+#endif
+
 
 /*
  * ISR TIMER1 Compare Match
@@ -181,6 +241,7 @@ ISR(TIMER1_COMPA_vect) {
 
         // pulse too short -> debounce extends timeout
         if (comctr <= COM_T_DEBOUNCE) {
+            count(COM_TLM_GLITCH);
             comctr = 0;
             bitpos = -1;
             rxBuff = 0;
@@ -194,37 +255,75 @@ ISR(TIMER1_COMPA_vect) {
                 // try to start receiving, lets see whats coming in..
                 bitpos = 0;
                 bitmask = 1;
+              #ifdef _AUTOBAUD_
+                rxSum = 0;
+                rxCal = 1;
+              #endif
+              #ifdef _FRAME_CHECK_
+                rxParity = 0;
+              #endif
 
             }
 
         // rx next bit (or button input)
-        } else if (bitpos < 8) {
+        } else if (bitpos < COM_BITS) {
+          #ifdef _AUTOBAUD_
+            // 0x55 and 0xAA: short and long pulses by turns, whatever the
+            // threshold is. the parity pulse is not part of it
+            if (bitpos < 8) {
+                uint8_t up = comctr > rxLast + (rxLast >> 1);
+                if (bitpos && ((!up && rxLast <= comctr + (comctr >> 1)) || (bitpos > 1 && up == rxUp))) { rxCal = 0; }
+                rxUp = up;
+                rxLast = comctr;
+                rxSum += comctr;
+            }
+          #endif
             // rx 0
-            if (comctr < COM_T_BIT) {
+            if (comctr < com_t_bit) {
                 rxBuff &= ~bitmask;
                 bitpos++;
                 bitmask <<= 1;
 
             // rx 1
-            } else if (comctr < 2*COM_T_BIT){
+            } else if (comctr < 2*com_t_bit){
                 rxBuff |= bitmask;
                 bitpos++;
                 bitmask <<= 1;
+              #ifdef _FRAME_CHECK_
+                rxParity ^= 1;
+              #endif
 
             // too long, maybe the button?
             } else {
                 if (bitpos < 7 && mode == MASTER) {
+                    count(COM_TLM_BUTTON);
                     skipmessage = 1;
                     bitpos = -1;
                 }
+              #ifdef _AUTOBAUD_
+                // sender is slower than we thought: start over with the default
+                if (mode == PROG) {
+                    com_t_bit = COM_T_BIT;
+                    bitpos = -1;
+                }
+              #endif
             }
 
             // byte completed
+          #ifdef _FRAME_CHECK_
+            // ..incl. parity pulse. the line is high again, no stop edge
+            if (bitpos == COM_BITS) {
+                if (rxParity) { rxErrors++; } else { if (rxDone) { count(COM_TLM_OVERRUN); } rxDone = 1; }
+                bitpos = -1;
+            }
+          #else
             if (bitpos == 8) {
+                if (rxDone) { count(COM_TLM_OVERRUN); }
                 rxDone = 1;
             }
+          #endif
              // and the master becomes a slave...
-             if (mode == MASTER && bitpos == 1) { mode = SLAVE; }
+             if (mode == MASTER && bitpos == 1) { mode = SLAVE; count(COM_TLM_SLAVE); }
 
         } else {
             bitpos = -1;
@@ -242,7 +341,10 @@ ISR(TIMER1_COMPA_vect) {
         if (++comctr >= COM_T_TIMEOUT) {
             comctr = 0;
             bitpos = -1;
-            if (mode == SLAVE) { mode = MASTER; }
+            if (mode == SLAVE) { mode = MASTER; count(COM_TLM_TIMEOUT); }
+          #ifdef _TELEMETRY_
+            tlmState = TLM_IDLE;    // the host is gone
+          #endif
         }
 
     }
@@ -284,9 +386,151 @@ ISR(TIMER1_COMPA_vect) {
         }
     }
 
+  #ifdef _TELEMETRY_
+    // the next compare match came while we were busy: a tick is late
+    if (TIFR & (1 << OCF1A)) { count(COM_TLM_LATE); }
+  #endif
+
+}
+
+
+
+
+#ifndef _SLAVE_ONLY_
+/*
+ * transmit one byte: HI-LO start edge, then one pulse per bit, lsb first
+ * (COM_T_LOW for a 0, COM_T_HIGH for a 1), w/ _FRAME_CHECK_ a parity pulse
+ */
+void transmit(uint8_t b) {
+
+    uint8_t mask = 1;
+  #ifdef _FRAME_CHECK_
+    uint8_t parity = 0;
+  #endif
+
+    // HACK : we have to access (write to) ctr_fast_delay here, otherwise the very first call to delay() does sometimes return instantly, seemingly depending on the character loaded some cycles before.
+    //       a delay(1) also works.. very weird
+    ctr_fast_delay = 0;
+
+    //COM_WRITE;
+    COM_OUT_L;
+    while (mask) {
+        if (b & mask) {
+             //ctr_fast_delay = 0; while (ctr_fast_delay < COM_T_HIGH) {}   // this ALSO does not work
+             delay(COM_T_HIGH);
+          #ifdef _FRAME_CHECK_
+             parity ^= 1;
+          #endif
+        } else {
+             // ctr_fast_delay = 0; while (ctr_fast_delay < COM_T_LOW) {}   // this ALSO does not work
+             delay(COM_T_LOW);
+        }
+        COM_WRITE;
+        mask <<= 1;
+    }
+  #ifdef _FRAME_CHECK_
+    delay(parity ? COM_T_HIGH : COM_T_LOW);
+    COM_WRITE;
+  #endif
+    delay(COM_T_BIT/2);
+    COM_OUT_H;
+}
+#endif
+
+
+#ifdef _TELEMETRY_
+#ifdef _FRAME_CHECK_
+ #define TLM_F1 COM_TLM_F_FRAMECHECK
+#else
+ #define TLM_F1 0
+#endif
+#ifdef _AUTOBAUD_
+ #define TLM_F2 COM_TLM_F_AUTOBAUD
+#else
+ #define TLM_F2 0
+#endif
+#ifdef FONT_PACKED
+ #define TLM_F3 COM_TLM_F_PACKED
+#else
+ #define TLM_F3 0
+#endif
+
+uint16_t tlmLast;               // the two columns before
+uint8_t tlmPos, tlmCrc, tlmHigh;
+
+/*
+ * telemetry query (comm.h) in the columns of a SLAVE: after the query the
+ * frames of the nodes before pass, ours takes the place of the fill bytes
+ * after them, one byte per column that comes in. returns the column to
+ * shift in for b
+ */
+uint8_t telemetry(uint8_t b) {
+
+    uint8_t out = b;
+
+    if (tlmState == TLM_SCAN) {
+        if (b == COM_TLM_FRAME) {
+            tlmState = TLM_PASS;
+            tlmPos = COM_TLM_LEN - 1;
+        } else if (b == COM_TLM_FILL) {
+            tlmState = TLM_OWN;
+            tlmPos = 0;
+            tlmCrc = 0;
+        } else {
+            tlmState = TLM_IDLE;    // not for us
+        }
+    } else if (tlmState == TLM_PASS) {
+        if (!--tlmPos) { tlmState = TLM_SCAN; }
+    }
+
+    // marker, flags, counters lsb first, crc
+    if (tlmState == TLM_OWN) {
+        if (tlmPos == 0) {
+            out = COM_TLM_FRAME;
+        } else if (tlmPos == COM_TLM_LEN - 1) {
+            out = tlmCrc;
+            tlmState = TLM_IDLE;
+        } else {
+            if (tlmPos == 1) {
+                out = TLM_F1 | TLM_F2 | TLM_F3;
+              #ifdef _FRAME_CHECK_
+                cli();
+                tlm[COM_TLM_PARITY] = rxErrors;
+                sei();
+              #endif
+            } else if (tlmPos & 1) {
+                out = tlmHigh;
+            } else {
+                uint16_t v;
+                cli();
+                v = tlm[(tlmPos - 2) >> 1];
+                sei();
+                out = v;
+                tlmHigh = v >> 8;
+            }
+            tlmCrc = _crc_ibutton_update(tlmCrc, out);
+        }
+        tlmPos++;
+    }
 
+    if (tlmState == TLM_IDLE && tlmLast == (((uint16_t)COM_TLM_QUERY0 << 8) | COM_TLM_QUERY1) && b == COM_TLM_QUERY2) {
+        tlmState = TLM_SCAN;
+    }
+    tlmLast = (tlmLast << 8) | b;
+    return out;
 }
+#endif
+
 
+#ifdef FONT_PACKED
+// next n bits (<= 8) of the packed font, msb first, see fontconv.c
+static inline uint8_t fontbits (uint16_t *bit, uint8_t n) {
+    uint16_t w = (pgm_read_byte(&fontcode[*bit >> 3]) << 8) | pgm_read_byte(&fontcode[(*bit >> 3) + 1]);
+    w <<= *bit & 7;
+    *bit += n;
+    return w >> (16 - n);
+}
+#endif
 
 
 
@@ -297,8 +541,8 @@ void main(void) {
 
     // HARDWARE INIT
     TCCR1B |= (1 << WGM12);     // timer 1 mode 9: CTC
-    TCCR1B |= (1 << CS10);      // timer 1 no prescaler -> 4 MHz
-    OCR1A  = 199;               // timer 1 20kHz
+    TCCR1B |= (1 << CS10);      // timer 1 no prescaler -> F_CPU
+    OCR1A  = F_CPU/20000 - 1;   // timer 1 20kHz
     TIMSK |= (1 << OCIE1A);     // enable timer 1 compare match interrupt
     ACSR |= (1 << ACD);         // disable analog comparator
 
@@ -331,9 +575,10 @@ void main(void) {
 
     uint8_t i,j;
 
-    uint8_t text_begin = EEPROM_BEGIN;     // position of current displayed msg in eeprom (first bit)
-    uint8_t pos = EEPROM_BEGIN;            // current position in eeprom
+    eeaddr_t text_begin = EEPROM_BEGIN;    // position of current displayed msg in eeprom (first bit)
+    eeaddr_t pos = EEPROM_BEGIN;           // current position in eeprom
     uint8_t speed = 4;                     // framewait default
+    uint8_t curfont = 0;                   // font of the chars, see FONT_X
     
 
     // main loop : do the loop
@@ -349,6 +594,9 @@ void main(void) {
         if (mode == SLAVE) {
             while (!rxDone && mode == SLAVE) { }
             chr[0] = rxBuff;
+          #ifdef _TELEMETRY_
+            if (rxDone) { chr[0] = telemetry(chr[0]); }
+          #endif
             rxDone = 0;
             rows2do = 1;
             width = 1;
@@ -358,22 +606,84 @@ void main(void) {
         // wait for data until eeprom is full, toggle display to signal activity
         } else if (mode == PROG) {
 
-            uint8_t p = 0;
+            eeaddr_t p = 0;
+          #ifdef _FRAME_CHECK_
+            uint8_t frame[COM_FRAME_MAX + 3];   // addr, len, data, crc
+            uint8_t f = 0;
+          #if EEPROM_SIZE > 255
+            eeaddr_t addr = 0;                  // frame[0] is the low byte, frames come in order
+          #endif
+          #endif
 
             // first two bytes must be 0xAA (init sequence), otherwise we 
             // might accidentally tap into the outputstream of another
             // blinken64. then it programs itself with nonsense data -.-
             while (mode == PROG) {
                 
+              #ifdef _FRAME_CHECK_
+                // wait for byte, a gap between bytes aborts the frame
+                ctr_delay_ms = 0;
+                while (!rxDone) { if (ctr_delay_ms > COM_T_FRAME_GAP) { f = 0; } }
+              #else
                 while (!rxDone) { }     // wait for byte
+              #endif
 
                 if ( p < EEPROM_BEGIN) {
+                  #ifdef _AUTOBAUD_
+                    // 0x55 (calibration byte) and 0xAA have four short and four
+                    // long pulses: the mean pulse length is the threshold. noise
+                    // or any other byte before the init sequence leaves it
+                    if (rxCal) { com_t_bit = rxSum >> 3; }
+                  #endif
                     if (rxBuff == 0xAA) { p++; }
+              #ifdef _FRAME_CHECK_
+                // frame: addr, len, data, crc8 -> write + ACK, or NAK
+                } else {
+                    frame[f++] = rxBuff;
+                    if (f > 1 && (frame[1] > COM_FRAME_MAX || f == frame[1] + 3)) {
+                        uint8_t crc = 0, i;
+                        eeaddr_t a;
+                      #ifndef _SLAVE_ONLY_
+                        uint8_t ack = COM_NAK;
+                      #endif
+                        for (i=0; i<f; i++) { crc = _crc_ibutton_update(crc, frame[i]); }
+
+                      #if EEPROM_SIZE > 255
+                        // address wrapped: next 256 byte. taken only w/ the
+                        // frame, a broken one must not move it
+                        a = addr;
+                        if (frame[0] < (uint8_t)a) { a += 0x100; }
+                        a = (a & 0xFF00) | frame[0];
+                      #else
+                        a = frame[0];
+                      #endif
+                        if (!crc && frame[1] <= COM_FRAME_MAX
+                                 && a >= EEPROM_BEGIN && a + frame[1] <= EEPROM_END) {
+                            for (i=0; i<frame[1]; i++) { eeprom_write_byte((uint8_t*)(a+i), frame[i+2]); }
+                          #if EEPROM_SIZE > 255
+                            addr = a;
+                          #endif
+                            display_on = ~display_on;      // activity toggle
+                          #ifndef _SLAVE_ONLY_
+                            ack = COM_ACK;
+                          #endif
+                        } else {
+                            frameErrors++;
+                        }
+                        f = 0;
+                      #ifndef _SLAVE_ONLY_
+                        // back to the programmer, a single display only: a next
+                        // one in PROG waits for 0xAA 0xAA, a MASTER turns SLAVE and shows it
+                        transmit(ack);
+                      #endif
+                    }
+              #else
                 } else if (p < EEPROM_END) {       // no overflow
-                    eeprom_write_byte(p,rxBuff);
+                    eeprom_write_byte((uint8_t*)p,rxBuff);
                     display_on = ~display_on;      // activity toggle
                     p++;
                 
+              #endif
                 }
                 
                 rxDone = 0;
@@ -413,10 +723,27 @@ void main(void) {
             } else if (currchar == INVERT) {
                 inverted = ~inverted;
 
+            // FONT: number in the next byte, fonts the firmware does not have are ignored
+            } else if (currchar == FONT_X) {
+                j = eeprom_read_byte((uint8_t*)pos);
+                pos++;
+                if (j < FONTS) { curfont = j; }
+
             // HALT 1x
             } else if (currchar == HALT) {
                 if (!skipmessage) { pos--; }
 
+          #if PICTURES > 8
+            // EEPROM PICS 9.. : slot in the next byte
+            } else if (currchar == PICTURE_X) {
+                currchar = eeprom_read_byte((uint8_t*)pos) + PICTURE1;
+                pos++;
+                width=8; rows2do=8;
+                for (i=0; i<8;i++) {
+                    chr[i]=eeprom_read_byte((uint8_t*)(EEPROM_END - (currchar-PICTURE1)*8-8+i));
+                }
+          #endif
+
             // WAIT 8x
             } else if (currchar <= WAIT8) {
                 if (!skipmessage) {  
@@ -428,7 +755,7 @@ void main(void) {
             } else if (currchar <= PICTURE8) {
                 width=8; rows2do=8;
                 for (i=0; i<8;i++) {
-                    chr[i]=eeprom_read_byte(128- (currchar-PICTURE1)*8-8+i);
+                    chr[i]=eeprom_read_byte((uint8_t*)(EEPROM_END - (currchar-PICTURE1)*8-8+i));
                 }
 
             // SPACERS 3x (inkl SPACEBAR )
@@ -440,24 +767,68 @@ void main(void) {
             // not the straight-forward way - we need so save space!
             } else if (currchar <= lastchar) {
 
-                // seek to mem position by summing up the widths (which are stored in half-byte format)
-                uint16_t charpos = 0;
-                for (i=0; i < currchar-firstchar+1; i++) {
-                    width = pgm_read_byte(&widths[(i)>>1]);
-
-                    if (!(i & 0x01)) { width >>= 4; }  // even : highest 4 bits
-                    
+                // glyph of the char in the current font. seek from the FONT_BLOCK'th glyph before
+                // on, by summing up the widths (or the shapes: width and escaped columns, the
+                // index into fontshape[]), which are stored in half-byte format: the same
+                // cost for every char in every font
+                uint8_t first = pgm_read_byte(&fontfirst[curfont]);
+                if (currchar >= first && currchar <= pgm_read_byte(&fontlast[curfont])) {
+                    uint16_t g = pgm_read_word(&fontbase[curfont]) + currchar - first;
+                    uint16_t k = g & ~(FONT_BLOCK-1);
+                    uint16_t at = pgm_read_word(&fontblk[g / FONT_BLOCK]);     // column in font[] / bit in fontcode[]
+
+                    for (;;) {
+                      #ifdef FONT_PACKED
+                        width = pgm_read_byte(&shapes[k>>1]);
+                      #else
+                        width = pgm_read_byte(&widths[k>>1]);
+                      #endif
+
+                        if (!(k & 0x01)) { width >>= 4; }  // even : highest 4 bits
+
+                      #ifdef FONT_PACKED
+                        width = pgm_read_byte(&fontshape[width & 0b1111]);
+                      #endif
+
+                        if (k == g) { break; }
+
+                      #ifdef FONT_PACKED
+                        at += (width & 0b1111) * FONT_BITS + (width >> 4) * 8;
+                      #else
+                        at += width & 0b1111;
+                      #endif
+                        k++;
+                    }
                     width &= 0b1111;
-                    
-                    if (i < currchar-firstchar) {
-                        charpos += width;
+
+                  #ifdef FONT_PACKED
+                    // decode char: dictionary index or escaped column
+                    for (i=0; i<width; i++) {
+                        j = fontbits(&at, FONT_BITS);
+                        chr[i] = (j == FONT_ESC) ? fontbits(&at, 8) : pgm_read_byte(&fontdict[j]);
                     }
+                  #else
+                    // copy char
+                    for (i=0; i<width; i++) { chr[i] = pgm_read_byte(&font[at]+i); }
+                  #endif
                 }
-
-                // copy char
-                for (i=0; i<width; i++) { chr[i] = pgm_read_byte(&font[charpos]+i); }
                 rows2do = spacing + width;
 
+            // FLIPBOOK: a whole frame at once, not scrolled in (nothing goes down the
+            // chain). column i of the frame is buff[7-i]; a key frame sets all of them,
+            // a delta one the columns in the mask (xor: the same inverted or not)
+            } else if (currchar == FLIP_KEY || currchar == FLIP_DELTA) {
+                j = 0xFF;
+                if (currchar == FLIP_DELTA) { j = eeprom_read_byte((uint8_t*)pos); pos++; }
+                for (i=0; i<8; i++) {
+                    if (j & (1 << i)) {
+                        uint8_t d = eeprom_read_byte((uint8_t*)pos);
+                        pos++;
+                        if (currchar == FLIP_KEY) { d ^= inverted ^ buff[7-i]; }
+                        if (!skipmessage) { buff[7-i] ^= d; }
+                    }
+                }
+
             } // end big if-elseif block
 
 
@@ -473,29 +844,7 @@ void main(void) {
           #ifndef _SLAVE_ONLY_
 
             // TRANSMISSION - transmit last column (if speed > 0)
-            if (speed) {
-
-                // HACK : we have to access (write to) ctr_fast_delay here, otherwise the very first call to delay() does sometimes return instantly, seemingly depending on the character loaded some cycles before.
-                //       a delay(1) also works.. very weird
-                ctr_fast_delay = 0;
-
-                //COM_WRITE;
-                COM_OUT_L;
-                bitmask=1;
-                while (bitmask) {
-                    if ( (buff[7]) & bitmask) {
-                         //ctr_fast_delay = 0; while (ctr_fast_delay < COM_T_HIGH) {}   // this ALSO does not work
-                         delay(COM_T_HIGH);
-                    } else {
-                         // ctr_fast_delay = 0; while (ctr_fast_delay < COM_T_LOW) {}   // this ALSO does not work
-                         delay(COM_T_LOW);
-                    }
-                    COM_WRITE;
-                    bitmask <<= 1;
-                }
-                delay(COM_T_BIT/2);
-                COM_OUT_H;
-            }
+            if (speed) { transmit(buff[7]); }
 
           #endif
 
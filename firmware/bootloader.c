@@ -0,0 +1,290 @@
+/*
+ *  blinken64 / bootloader.c
+ *
+ *  Small bootloader: rewrites the application flash via the data input pin
+ *   - uses the same pulse coding as the display firmware (see comm.h)
+ *   - CRC16 checked pages, 64 byte each (SPM_PAGESIZE)
+ *   - the input pin is mirrored to the output pin while active, so every
+ *     display in a chain receives (and programs) the same image at once
+ *   - lives at the end of flash (BOOTSTART), no hardware boot section needed
+ *
+ *  Frame format (all bytes pulse coded, like PROG mode):
+ *
+ *      0xAA 0xAA BOOT_SYNC <page> <64 data bytes> <crc lo> <crc hi>
+ *      0xAA 0xAA BOOT_SYNC BOOT_DONE <number of pages sent> <crc lo> <crc hi>
+ *
+ *  The crc (xmodem) covers the page number and the data bytes, or BOOT_DONE
+ *  and the number of pages.
+ *
+ *  The tinies have no boot reset vector: word 0 of every written image is
+ *  replaced by a rjmp to the bootloader. The original reset vector of the
+ *  application is moved to the last word below the bootloader (BOOT_TRAMPOLINE),
+ *  which is what the bootloader jumps to when it is done.
+ *
+ *  The bit threshold is measured from the 0x55 / 0xAA bytes before the first
+ *  BOOT_SYNC (four short, four long pulses by turns, recognized as such at
+ *  any speed), like PROG mode w/ _AUTOBAUD_. Other bytes leave it.
+ *
+ *  Entry: only if the input pin is low at reset (programmer attached, or the
+ *  upstream display is in bootloader mode too). Without a frame within
+ *  BOOT_T_WAIT the application is started - and will go into PROG mode.
+ *
+ *
+ *  Copyright (C) 2011 Manuel Jerger <nom@nomnom.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/boot.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+
+//----------------------------------------------------------------------
+
+#include "comm.h"
+#include "bootloader.h"
+
+//----------------------------------------------------------------------
+
+#ifdef __AVR__
+// built w/ -nostartfiles: no vector table and no crt, the bootloader starts
+// w/ the .init sections at BOOTSTART. These two are all of the crt it needs,
+// the .data / .bss setup of libgcc (.init4) runs between them. The stack
+// pointer is RAMEND after reset
+void init2(void) __attribute__ ((naked, used, section (".init2")));
+void init2(void) { asm volatile ("clr __zero_reg__"); }
+void init9(void) __attribute__ ((naked, used, section (".init9")));
+void init9(void) { asm volatile ("rjmp main"); }
+#endif
+
+// call a word address (tools/mock/bootloader.cpp catches it)
+#ifndef jump
+# define jump(_word)    ((void (*)(void))(_word))()
+#endif
+
+#define BOOT_T_WAIT     (10000)     // ticks (0.5 s) to wait for the first frame
+
+#define BOOT_PAGES      (BOOTSTART / SPM_PAGESIZE)   // pages usable by the application
+
+#define RX_TIMEOUT      (-1)
+
+
+uint8_t page[SPM_PAGESIZE];         // page buffer
+uint8_t written[(BOOT_PAGES+7)/8];  // pages programmed successfully in this session
+uint16_t app_reset = 0xFFFF;        // reset vector of the new image (from page 0)
+
+uint8_t thr = COM_T_BIT;            // threshold for bit decoding
+uint16_t rxsum;                     // sum of all pulse lengths of the last byte
+uint8_t rxcal;                      // last byte was 0x55 / 0xAA at its own timing
+
+
+//----------------------------------------------------------------------
+
+// one 50us tick passed? (same clock as the display ISR, but polled)
+#define tick()      (TIFR & (1 << OCF1A))
+#define tickClear   { TIFR = (1 << OCF1A); }
+
+// mirror input to output, so the next display in chain gets everything too
+#define mirror(_in) { if (_in) { COM_OUT_H; } else { COM_OUT_L; } }
+
+
+/*
+ * receive one byte, like the display ISR does - but polled.
+ * returns RX_TIMEOUT if nothing came in for _timeout ticks
+ */
+int16_t rx(uint16_t _timeout) {
+
+    uint8_t last = COM_READ;
+    uint16_t ctr = 0;           // ticks since last edge
+    int8_t bitpos = -1;
+    uint8_t b = 0;
+    uint16_t prev = 0;          // pulse before
+    uint8_t up = 0;             // ..was longer than the one before it
+
+    for (;;) {
+        uint8_t read = COM_READ;
+        mirror(read);
+
+        if (read != last) {
+            last = read;
+
+            if (ctr <= COM_T_DEBOUNCE) {            // glitch
+                bitpos = -1;
+            } else if (bitpos == -1) {
+                if (!read) { bitpos = 0; b = 0; rxsum = 0; rxcal = 1; }    // HI-LO : start
+            } else {
+                // 0x55 / 0xAA: short and long pulses by turns, whatever thr is
+                uint8_t longer = ctr > prev + (prev >> 1);
+                if (bitpos && ((!longer && prev <= ctr + (ctr >> 1)) || (bitpos > 1 && longer == up))) { rxcal = 0; }
+                up = longer;
+                prev = ctr;
+                rxsum += ctr;
+                if (ctr < thr) {                    // rx 0
+                    bitpos++;
+                } else if (ctr < 2*thr) {           // rx 1
+                    b |= (1 << bitpos);
+                    bitpos++;
+                } else {
+                    bitpos = -1;
+                }
+            }
+
+            if (bitpos == 8) { return b; }
+
+            ctr = 0;
+
+        } else if (tick()) {
+            tickClear;
+            if (++ctr >= 2*thr) { bitpos = -1; }    // byte aborted
+            if (ctr >= _timeout) { return RX_TIMEOUT; }
+        }
+    }
+}
+
+
+// erase one page
+void erase(uint8_t _page) {
+    boot_page_erase((uint16_t)_page * SPM_PAGESIZE);
+    boot_spm_busy_wait();
+}
+
+// erase + write one page from the page buffer
+void program(uint8_t _page) {
+
+    uint16_t addr = (uint16_t)_page * SPM_PAGESIZE;
+    uint8_t i;
+
+    for (i=0; i<SPM_PAGESIZE; i+=2) {
+        boot_page_fill(addr + i, page[i] | (page[i+1] << 8));
+    }
+    erase(_page);
+    boot_page_write(addr);
+    boot_spm_busy_wait();
+}
+
+
+// start the application through the trampoline (if there is any)
+void start(void) {
+
+    if (pgm_read_word(BOOT_TRAMPOLINE) != 0xFFFF) {
+        TCCR1B = 0;
+        tickClear;
+        jump(BOOT_TRAMPOLINE / 2);
+    }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// MAIN
+void main(void) __attribute__ ((noreturn));
+void main(void) {
+
+    initComm;
+
+    // no programmer attached -> just run
+    if (COM_READ) { start(); }
+
+    // timer 1 CTC, 20kHz, like the display (flag is polled, no interrupts)
+    TCCR1B = (1 << WGM12) | (1 << CS10);
+    OCR1A  = 199;
+
+    uint16_t timeout = BOOT_T_WAIT;
+    uint8_t session = 0;
+    uint8_t synced = 0;
+
+    for (;;) {
+
+        // sync: at least two 0xAA, then BOOT_SYNC
+        uint8_t aa = 0;
+        int16_t c;
+        for (;;) {
+            c = rx(timeout);
+            if (c == RX_TIMEOUT) {
+                if (!session) { start(); }  // nothing for us
+                continue;
+            }
+            if (c == BOOT_SYNC && aa >= 2) { break; }
+            if (!synced && rxcal) { thr = rxsum >> 3; }     // auto-baud, not on noise
+            if (c == 0xAA) {
+                aa++;
+            } else {
+                aa = 0;
+            }
+        }
+        synced = 1;
+        timeout = 0xFFFF;       // from now on, we wait for the programmer
+
+        int16_t p = rx(timeout);
+        uint16_t crc = _crc_xmodem_update(0, p);
+
+        // end of image: run it, if every page arrived
+        if (p == BOOT_DONE) {
+            uint8_t n = 0, i;
+            c = rx(timeout);
+            crc = _crc_xmodem_update(crc, c);
+            crc ^= rx(timeout);
+            crc ^= rx(timeout) << 8;
+            for (i=0; i<BOOT_PAGES; i++) {
+                if (written[i>>3] & (1 << (i & 0x07))) { n++; }
+            }
+            if (!crc && n == c) { start(); }
+            continue;
+        }
+
+        uint8_t i;
+        for (i=0; i<SPM_PAGESIZE; i++) {
+            c = rx(timeout);
+            page[i] = c;
+            crc = _crc_xmodem_update(crc, c);
+        }
+        crc ^= rx(timeout);
+        crc ^= rx(timeout) << 8;
+
+        // never overwrite ourselves
+        if (crc || p < 0 || p >= BOOT_PAGES) { continue; }
+
+        // first page of this session: invalidate the trampoline, so a
+        // half written image is never started
+        if (!session) {
+            session = 1;
+            erase(BOOT_PAGES-1);
+        }
+
+        // reset vector : remember the application entry, jump to us instead
+        if (p == 0) {
+            app_reset = page[0] | (page[1] << 8);
+            uint16_t w = RJMP(0, BOOTSTART/2);
+            page[0] = w;
+            page[1] = w >> 8;
+        }
+
+        // last page below the bootloader gets the trampoline to the application
+        if (p == BOOT_PAGES-1) {
+            uint16_t w = 0xFFFF;
+            if ((app_reset & 0xF000) == 0xC000) {    // rjmp k  ->  target k+1
+                w = RJMP(BOOT_TRAMPOLINE/2, (app_reset + 1) & 0x0FFF);
+            }
+            page[SPM_PAGESIZE-2] = w;
+            page[SPM_PAGESIZE-1] = w >> 8;
+        }
+
+        program(p);
+        written[p>>3] |= (1 << (p & 0x07));
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ *  blinken64 / bootloader.h
+ *
+ *  Memory layout and frame bytes of the bootloader, shared with tools/bootconv.
+ *
+ *  Copyright (C) 2011 Manuel Jerger <nom@nomnom.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __BOOTLOADER_H__
+# define __BOOTLOADER_H__
+
+
+#ifndef BOOTSTART
+# define BOOTSTART      (0x0E00)    // byte address, 512 byte for the bootloader
+#endif
+
+#define BOOT_PAGESIZE   (64)        // SPM_PAGESIZE of the attiny4313
+
+// last word of the application area: rjmp to the application reset handler
+#define BOOT_TRAMPOLINE (BOOTSTART - 2)
+
+#define BOOT_SYNC       (0xB0)      // follows the 0xAA 0xAA init sequence
+#define BOOT_DONE       (0xFF)      // page number of the last frame
+
+#define BOOT_PAD        (2)         // idle bytes after each frame (page erase + write)
+
+// rjmp from word address _from to word address _to (wraps around the 4k flash)
+#define RJMP(_from, _to)    (0xC000 | (((_to) - (_from) - 1) & 0x0FFF))
+
+#endif
@@ -34,6 +34,49 @@
 #define COM_T_HIGH      (22)        // length of pulse for transm. a high bit
 #define COM_T_DEBOUNCE  (2)         // debounces keys
 
+// error detection (_FRAME_CHECK_): parity pulse after each byte, PROG data in
+// crc8 (dallas) checked frames, answered by ACK / NAK on the output pin. That
+// is the input of the next display in a chain, the programmer hears it only
+// w/ a single display wired back to it: program one display at a time
+#ifdef _FRAME_CHECK_
+ #define COM_BITS       (9)         // pulses per byte, incl. parity
+#else
+ #define COM_BITS       (8)
+#endif
+#define COM_FRAME_MAX   (16)        // max data bytes per PROG frame
+#define COM_T_FRAME_GAP (50)        // ms w/o data -> frame aborted
+#define COM_ACK         (0x06)
+#define COM_NAK         (0x15)
+
+// telemetry (_TELEMETRY_): counters of the link and the ISR, read w/ a query
+// in the columns of a chain in SLAVE mode. The host sends the three query
+// bytes, then fill bytes (blank columns). Every node lets the query and the
+// frames of the nodes before it pass, its own frame takes the place of the
+// first COM_TLM_LEN fill bytes after them. At the end of the chain, 8 columns
+// per node later: the query, the frames of node 1..n, fill bytes.
+// A frame: COM_TLM_FRAME, flags, the counters (16 bit, lsb first), crc8 (dallas)
+// of the flags and the counters
+#define COM_TLM_QUERY0  (0xA5)
+#define COM_TLM_QUERY1  (0x5A)
+#define COM_TLM_QUERY2  (0xC3)
+#define COM_TLM_FILL    (0x00)
+#define COM_TLM_FRAME   (0x7E)
+
+#define COM_TLM_LATE    (0)         // ISR took longer than a tick
+#define COM_TLM_OVERRUN (1)         // byte done while the one before was not taken (rxDone)
+#define COM_TLM_GLITCH  (2)         // pulses of up to COM_T_DEBOUNCE
+#define COM_TLM_SLAVE   (3)         // MASTER -> SLAVE
+#define COM_TLM_TIMEOUT (4)         // SLAVE -> MASTER, COM_T_TIMEOUT w/o an edge
+#define COM_TLM_BUTTON  (5)         // presses: next message
+#define COM_TLM_PARITY  (6)         // bytes dropped, parity (_FRAME_CHECK_)
+#define COM_TLM_COUNTERS (7)
+#define COM_TLM_LEN     (3 + 2*COM_TLM_COUNTERS)
+
+// flags: how the node was built
+#define COM_TLM_F_FRAMECHECK  (0x01)
+#define COM_TLM_F_AUTOBAUD    (0x02)
+#define COM_TLM_F_PACKED      (0x04)    // FONT_PACKED
+
 
 #if defined (_SLAVE_ONLY)      // use PD6 as input, do not use RES / output
 
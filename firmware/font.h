@@ -1,156 +1,163 @@
-//font.h  -  generated using fonconv; input file was tools/font/font.pgm
+//font.h  -  generated using fonconv; input file was font/font.pgm
 #define firstchar 33
 #define lastchar 134
+#define FONTS 1
+#define FONT_BLOCK 8
+
+const uint8_t fontfirst[] PROGMEM = { 33};
+const uint8_t fontlast[] PROGMEM = { 134};
+const uint16_t fontbase[] PROGMEM = { 0};
+
 const uint8_t font[] PROGMEM = {
 
-// 33	!	11151
+// 33	!	0
 0b01011111,
-// 34	"	11152
+// 34	"	1
 0b00000011,
 0b00000000,
 0b00000011,
-// 35	#	11155
+// 35	#	4
 0b00100100,
 0b01111110,
 0b00100100,
 0b00100100,
 0b01111110,
 0b00100100,
-// 36	$	11161
+// 36	$	10
 0b00101110,
 0b01101011,
 0b00101010,
 0b01101011,
 0b00111010,
-// 37	%	11166
+// 37	%	15
 0b00000110,
 0b01000110,
 0b00110000,
 0b00001100,
 0b01100010,
 0b01100000,
-// 38	&	11172
+// 38	&	21
 0b00110110,
 0b01001001,
 0b01001001,
 0b00110110,
 0b01010000,
-// 39	'	11177
+// 39	'	26
 0b00000100,
 0b00000011,
-// 40	(	11179
+// 40	(	28
 0b00111100,
 0b01000010,
 0b10000001,
-// 41	)	11182
+// 41	)	31
 0b10000001,
 0b01000010,
 0b00111100,
-// 42	*	11185
+// 42	*	34
 0b00001000,
 0b00101010,
 0b00011100,
 0b00011100,
 0b00101010,
 0b00001000,
-// 43	+	11191
+// 43	+	40
 0b00001000,
 0b00001000,
 0b00111110,
 0b00001000,
 0b00001000,
-// 44	,	11196
+// 44	,	45
 0b10000000,
 0b01100000,
-// 45	-	11198
+// 45	-	47
 0b00001000,
 0b00001000,
 0b00001000,
 0b00001000,
-// 46	.	11202
+// 46	.	51
 0b01000000,
-// 47	/	11203
+// 47	/	52
 0b11000000,
 0b00110000,
 0b00001100,
 0b00000011,
-// 48	0	11207
+// 48	0	56
 0b00111110,
 0b01010001,
 0b01001001,
 0b01000101,
 0b00111110,
-// 49	1	11212
+// 49	1	61
 0b01000010,
 0b01111111,
 0b01000000,
-// 50	2	11215
+// 50	2	64
 0b01110001,
 0b01001001,
 0b01001001,
 0b01000110,
-// 51	3	11219
+// 51	3	68
 0b01000001,
 0b01001001,
 0b01001001,
 0b00110110,
-// 52	4	11223
+// 52	4	72
 0b00011000,
 0b00010100,
 0b00010010,
 0b01111111,
 0b00010000,
-// 53	5	11228
+// 53	5	77
 0b01000111,
 0b01000101,
 0b01000101,
 0b00111001,
-// 54	6	11232
+// 54	6	81
 0b00111110,
 0b01001001,
 0b01001001,
 0b00110010,
-// 55	7	11236
+// 55	7	85
 0b00000001,
 0b01100001,
 0b00011001,
 0b00000111,
-// 56	8	11240
+// 56	8	89
 0b00110110,
 0b01001001,
 0b01001001,
 0b00110110,
-// 57	9	11244
+// 57	9	93
 0b00000110,
 0b01001001,
 0b01001001,
 0b00111110,
-// 58	:	11248
+// 58	:	97
 0b01000100,
-// 59	;	11249
+// 59	;	98
 0b10000000,
 0b01001100,
-// 60	<	11251
+// 60	<	100
 0b00001000,
 0b00010100,
 0b00100010,
 0b01000001,
-// 61	=	11255
+// 61	=	104
 0b00010100,
 0b00010100,
 0b00010100,
 0b00010100,
-// 62	>	11259
+// 62	>	108
 0b01000001,
 0b00100010,
 0b00010100,
 0b00001000,
-// 63	?	11263
+// 63	?	112
 0b00000001,
 0b01011001,
 0b00001001,
 0b00000110,
-// 64	@	11267
+// 64	@	116
 0b00111110,
 0b01000001,
 0b01011101,
@@ -158,68 +165,68 @@ const uint8_t font[] PROGMEM = {
 0b01011101,
 0b01010001,
 0b00001110,
-// 65	A	11274
+// 65	A	123
 0b01111110,
 0b00001001,
 0b00001001,
 0b01111110,
-// 66	B	11278
+// 66	B	127
 0b01111111,
 0b01001001,
 0b01001001,
 0b00110110,
-// 67	C	11282
+// 67	C	131
 0b00111110,
 0b01000001,
 0b01000001,
 0b01000001,
-// 68	D	11286
+// 68	D	135
 0b01111111,
 0b01000001,
 0b01000001,
 0b00111110,
-// 69	E	11290
+// 69	E	139
 0b01111111,
 0b01001001,
 0b01001001,
 0b01000001,
-// 70	F	11294
+// 70	F	143
 0b01111111,
 0b00001001,
 0b00001001,
 0b00000001,
-// 71	G	11298
+// 71	G	147
 0b00111110,
 0b01000001,
 0b01000001,
 0b01001001,
 0b00111000,
-// 72	H	11303
+// 72	H	152
 0b01111111,
 0b00001000,
 0b00001000,
 0b01111111,
-// 73	I	11307
+// 73	I	156
 0b01000001,
 0b01111111,
 0b01000001,
-// 74	J	11310
+// 74	J	159
 0b00110001,
 0b01000001,
 0b01000001,
 0b01111111,
-// 75	K	11314
+// 75	K	163
 0b01111111,
 0b00001000,
 0b00010100,
 0b00100010,
 0b01000001,
-// 76	L	11319
+// 76	L	168
 0b01111111,
 0b01000000,
 0b01000000,
 0b01000000,
-// 77	M	11323
+// 77	M	172
 0b01111111,
 0b00000010,
 0b00000100,
@@ -227,58 +234,58 @@ const uint8_t font[] PROGMEM = {
 0b00000100,
 0b00000010,
 0b01111111,
-// 78	N	11330
+// 78	N	179
 0b01111111,
 0b00000100,
 0b00001000,
 0b00010000,
 0b01111111,
-// 79	O	11335
+// 79	O	184
 0b00111110,
 0b01000001,
 0b01000001,
 0b01000001,
 0b00111110,
-// 80	P	11340
+// 80	P	189
 0b01111111,
 0b00001001,
 0b00001001,
 0b00000110,
-// 81	Q	11344
+// 81	Q	193
 0b00111110,
 0b01000001,
 0b01000001,
 0b00100001,
 0b01011110,
-// 82	R	11349
+// 82	R	198
 0b01111111,
 0b00001001,
 0b00001001,
 0b01110110,
-// 83	S	11353
+// 83	S	202
 0b01000110,
 0b01001001,
 0b01001001,
 0b00110001,
-// 84	T	11357
+// 84	T	206
 0b00000001,
 0b00000001,
 0b01111111,
 0b00000001,
 0b00000001,
-// 85	U	11362
+// 85	U	211
 0b00111111,
 0b01000000,
 0b01000000,
 0b01000000,
 0b00111111,
-// 86	V	11367
+// 86	V	216
 0b00001111,
 0b00110000,
 0b01000000,
 0b00110000,
 0b00001111,
-// 87	W	11372
+// 87	W	221
 0b00001111,
 0b00110000,
 0b01000000,
@@ -286,196 +293,196 @@ const uint8_t font[] PROGMEM = {
 0b01000000,
 0b00110000,
 0b00001111,
-// 88	X	11379
+// 88	X	228
 0b01100011,
 0b00010100,
 0b00001000,
 0b00010100,
 0b01100011,
-// 89	Y	11384
+// 89	Y	233
 0b00000111,
 0b00001000,
 0b01110000,
 0b00001000,
 0b00000111,
-// 90	Z	11389
+// 90	Z	238
 0b01100001,
 0b01010001,
 0b01001001,
 0b01000101,
 0b01000011,
-// 91	[	11394
+// 91	[	243
 0b11111111,
 0b10000001,
 0b10000001,
-// 92	\	11397
+// 92	\	246
 0b00000011,
 0b00001100,
 0b00110000,
 0b11000000,
-// 93	]	11401
+// 93	]	250
 0b10000001,
 0b10000001,
 0b11111111,
-// 94	^	11404
+// 94	^	253
 0b00000100,
 0b00000010,
 0b00000001,
 0b00000010,
 0b00000100,
-// 95	_	11409
+// 95	_	258
 0b01000000,
 0b01000000,
 0b01000000,
 0b01000000,
-// 96	`	11413
+// 96	`	262
 0b00000001,
 0b00000010,
 0b00000100,
-// 97	a	11416
+// 97	a	265
 0b00111000,
 0b01000100,
 0b01000100,
 0b01111100,
-// 98	b	11420
+// 98	b	269
 0b01111111,
 0b01000100,
 0b01000100,
 0b00111000,
-// 99	c	11424
+// 99	c	273
 0b00111000,
 0b01000100,
 0b01000100,
 0b01000100,
-// 100	d	11428
+// 100	d	277
 0b00111000,
 0b01000100,
 0b01000100,
 0b01111111,
-// 101	e	11432
+// 101	e	281
 0b00111000,
 0b01010100,
 0b01010100,
 0b01011000,
-// 102	f	11436
+// 102	f	285
 0b00001000,
 0b11111110,
 0b00001001,
 0b00000001,
-// 103	g	11440
+// 103	g	289
 0b00011000,
 0b10100100,
 0b10100100,
 0b01111000,
-// 104	h	11444
+// 104	h	293
 0b01111111,
 0b00000100,
 0b00000100,
 0b01111000,
-// 105	i	11448
+// 105	i	297
 0b01111010,
-// 106	j	11449
+// 106	j	298
 0b10000000,
 0b01111010,
-// 107	k	11451
+// 107	k	300
 0b01111111,
 0b00010000,
 0b00101000,
 0b01000100,
-// 108	l	11455
+// 108	l	304
 0b00111111,
 0b01000000,
 0b01000000,
-// 109	m	11458
+// 109	m	307
 0b01111100,
 0b00000100,
 0b01111100,
 0b00000100,
 0b01111000,
-// 110	n	11463
+// 110	n	312
 0b01111100,
 0b00000100,
 0b00000100,
 0b01111000,
-// 111	o	11467
+// 111	o	316
 0b00111000,
 0b01000100,
 0b01000100,
 0b00111000,
-// 112	p	11471
+// 112	p	320
 0b11111100,
 0b00100100,
 0b00100100,
 0b00011000,
-// 113	q	11475
+// 113	q	324
 0b00011000,
 0b00100100,
 0b00100100,
 0b11111100,
-// 114	r	11479
+// 114	r	328
 0b01111100,
 0b00001000,
 0b00000100,
-// 115	s	11482
+// 115	s	331
 0b01001000,
 0b01010100,
 0b01010100,
 0b00100100,
-// 116	t	11486
+// 116	t	335
 0b00000100,
 0b00111111,
 0b01000100,
 0b01000000,
-// 117	u	11490
+// 117	u	339
 0b00111100,
 0b01000000,
 0b01000000,
 0b00111100,
-// 118	v	11494
+// 118	v	343
 0b00001100,
 0b00110000,
 0b01000000,
 0b00110000,
 0b00001100,
-// 119	w	11499
+// 119	w	348
 0b00111100,
 0b01000000,
 0b00100000,
 0b01000000,
 0b00111100,
-// 120	x	11504
+// 120	x	353
 0b01000100,
 0b00101000,
 0b00010000,
 0b00101000,
 0b01000100,
-// 121	y	11509
+// 121	y	358
 0b00011100,
 0b10100000,
 0b10100000,
 0b01111100,
-// 122	z	11513
+// 122	z	362
 0b01100100,
 0b01010100,
 0b01010100,
 0b01001100,
-// 123	{	11517
+// 123	{	366
 0b00001000,
 0b00111110,
 0b01000001,
-// 124	|	11520
+// 124	|	369
 0b11111111,
-// 125	}	11521
+// 125	}	370
 0b01000001,
 0b00111110,
 0b00001000,
-// 126	~	11524
+// 126	~	373
 0b00011000,
 0b00000100,
 0b00001000,
 0b00010000,
 0b00001100,
-// 127		11529
+// 127		378
 0b00001110,
 0b00011111,
 0b00111111,
@@ -483,42 +490,44 @@ const uint8_t font[] PROGMEM = {
 0b00111111,
 0b00011111,
 0b00001110,
-// 128		11536
+// 128		385
 0b00010100,
 0b00111110,
 0b01010101,
 0b01010101,
 0b01000001,
 0b01000001,
-// 129		11542
+// 129		391
 0b01111001,
 0b00010100,
 0b00010100,
 0b01111001,
-// 130		11546
+// 130		395
 0b00111001,
 0b01000100,
 0b01000100,
 0b00111001,
-// 131		11550
+// 131		399
 0b00111101,
 0b01000000,
 0b01000000,
 0b00111101,
-// 132		11554
+// 132		403
 0b11111111,
 0b00000001,
 0b01001001,
 0b00110110,
-// 133		11558
+// 133		407
 0b00111001,
 0b01000100,
 0b01000100,
 0b01111101,
-// 134		11562
+// 134		411
 0b11111100,
 0b00100000,
 0b00100000,
 0b00011100};
 
-const int8_t widths[] PROGMEM = { 19,101,101,35,54,82,65,69,52,69,68,68,65,36,68,71,68,68,68,84,52,84,117,84,84,69,85,117,85,52,53,67,68,68,68,68,18,67,84,68,67,68,69,85,68,49,53,118,68,68,68,};
+const uint16_t fontblk[] PROGMEM = { 0,31,61,93,123,156,193,233,265,297,324,358,391};
+
+const int8_t widths[] PROGMEM = { 19,101,101,35,54,82,65,69,52,69,68,68,65,36,68,71,68,68,68,84,52,84,117,84,84,69,85,117,85,52,53,67,68,68,68,68,18,67,84,68,67,68,69,85,68,49,53,118,68,68,68};
@@ -0,0 +1,486 @@
+#!/usr/bin/env python3
+# encoding:utf8
+
+#
+# footprint.py : what the firmware costs, per configuration and per feature
+#
+# Builds blinken.c in every configuration (default, master only, slave
+# only, every feature flag, the packed font) w/ the avr-gcc on the path, each
+# in a temporary directory, and reports per build:
+#
+#   - flash, sram and eeprom from the sections of the map file, and flash
+#     per object (blinken.o, the startup code, libgcc)
+#   - flash and sram per function and variable (avr-nm)
+#   - the deepest stack: the call graph of avr-objdump, the frames of
+#     -fstack-usage, main plus the timer ISR on top of it
+#   - the cycles of the ISR, shortest and longest path, against the cycles
+#     of one 50us tick
+#
+# The other configurations are compared w/ the default one: what a feature
+# costs in total, and in which functions.
+#
+#   make footprint
+#   ./footprint.py --profile attiny4313 --only default,framecheck --top 20
+#   ./footprint.py --json footprint.json --keep build
+#
+#  Copyright (C) 2011 Manuel Jerger <nom@nomnom.de>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+import argparse
+import json
+import os
+import re
+import shlex
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# name, flags. the packed font is added if there is one (--packed-font)
+CONFIGS = [
+	('default', []),
+	('master', ['-D_MASTER_ONLY_=1']),
+	('slave', ['-D_SLAVE_ONLY_=1']),
+	('autobaud', ['-D_AUTOBAUD_']),
+	('framecheck', ['-D_FRAME_CHECK_']),
+	('autobaud+framecheck', ['-D_AUTOBAUD_', '-D_FRAME_CHECK_']),
+	('telemetry', ['-D_TELEMETRY_']),
+]
+
+# sram of the parts: size, start
+SRAM = {
+	'attiny2313': (128, 0x60),
+	'attiny4313': (256, 0x60),
+	'attiny84': (512, 0x60),
+	'atmega328p': (2048, 0x100),
+}
+
+TICK_HZ = 20000                         # timer 1, see main()
+IRQ_ENTRY = 4                           # cycles from the interrupt to the vector
+DATA_ADDR = 0x800000                    # sram in the elf
+EEPROM_ADDR = 0x810000
+
+
+def profile(name):
+	"""mcu, eeprom, flash, pictures, clock of a profile in profiles.h"""
+	src = open(os.path.join(HERE, 'profiles.h')).read()
+	m = re.search(r'#define\s+PROFILE_%s\s+\(\s*"(\w+)",\s*(\d+),\s*(\d+),\s*(\d+),\s*(\d+)\s*\)' % re.escape(name), src)
+	if not m:
+		sys.exit('%s: no profile %s in profiles.h' % (sys.argv[0], name))
+	return {'name': name, 'mcu': m.group(1), 'eeprom': int(m.group(2)), 'flash': int(m.group(3)),
+	        'pictures': int(m.group(4)), 'clock': int(m.group(5))}
+
+
+def firmware_profiles():
+	"""profiles the firmware builds for, PROFILES_FIRMWARE in profiles.h"""
+	src = open(os.path.join(HERE, 'profiles.h')).read()
+	m = re.search(r'#define\s+PROFILES_FIRMWARE\s+"([^"]*)"', src)
+	return m.group(1).split() if m else []
+
+
+def run(cmd, cwd=None):
+	try:
+		p = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, cwd=cwd)
+	except OSError as e:
+		return False, str(e)
+	out = p.communicate()[0].decode('utf8', 'replace')
+	return p.returncode == 0, out
+
+
+# -- the map file ---------------------------------------------------------
+
+def readMap(path):
+	"""output sections: name -> size, and the bytes of .text/.data per object"""
+	sections, objects = {}, {}
+	out = None
+	lines = open(path).read().splitlines()
+	for i, line in enumerate(lines):
+		# a long name has the addresses on the next line
+		if re.match(r'^ ?\.[\w.]+$', line) and i + 1 < len(lines):
+			line = line + ' ' + lines[i + 1].strip()
+		m = re.match(r'^(\.[\w.]+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)', line)
+		if m:
+			out = m.group(1)
+			sections[out] = int(m.group(3), 16)
+			continue
+		m = re.match(r'^ (\.[\w.]+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)', line)
+		if m and out in ('.text', '.data') and int(m.group(3), 16):
+			obj = os.path.basename(m.group(4))
+			objects[obj] = objects.get(obj, 0) + int(m.group(3), 16)
+	return sections, objects
+
+
+# -- functions and variables ----------------------------------------------
+
+def readSymbols(nm, elf):
+	"""name -> (kind, bytes): kind flash (code, progmem), data (flash + sram), bss, eeprom"""
+	ok, out = run([nm, '-S', '-n', elf])
+	syms = {}
+	for line in out.splitlines():
+		f = line.split()
+		if len(f) != 4:
+			continue
+		addr, size, kind, name = int(f[0], 16), int(f[1], 16), f[2].lower(), f[3]
+		if addr >= EEPROM_ADDR:
+			kind = 'eeprom'
+		elif addr >= DATA_ADDR:
+			kind = 'data' if kind == 'd' else 'bss'
+		else:
+			kind = 'flash'
+		syms[name] = (kind, size)
+	return syms
+
+
+# -- the code -------------------------------------------------------------
+
+# cycles of the avr (AVRe: the tinies and the megas w/o the 22 bit pc).
+# branches and skips are counted where they go
+CYCLES = {
+	'ld': 2, 'ldd': 2, 'lds': 2, 'st': 2, 'std': 2, 'sts': 2, 'push': 2, 'pop': 2,
+	'lpm': 3, 'elpm': 3, 'adiw': 2, 'sbiw': 2, 'sbi': 2, 'cbi': 2,
+	'mul': 2, 'muls': 2, 'mulsu': 2, 'fmul': 2, 'fmuls': 2, 'fmulsu': 2,
+	'rjmp': 2, 'jmp': 3, 'ijmp': 2, 'rcall': 3, 'call': 4, 'icall': 3, 'ret': 4, 'reti': 4,
+}
+SKIPS = ('cpse', 'sbrc', 'sbrs', 'sbic', 'sbis')
+
+
+class Insn(object):
+
+	def __init__(self, addr, size, op, args, target):
+		self.addr = addr
+		self.size = size
+		self.op = op
+		self.args = args
+		self.target = target                # branch, jump, call
+
+
+class Func(object):
+
+	def __init__(self, name, addr):
+		self.name = name
+		self.addr = addr
+		self.code = []
+		self.at = {}                        # address -> index in code
+
+
+def readCode(objdump, elf):
+	"""name -> Func, from the disassembly"""
+	ok, out = run([objdump, '-d', elf])
+	funcs, f = {}, None
+	for line in out.splitlines():
+		m = re.match(r'^([0-9a-f]+) <(.+)>:$', line)
+		if m:
+			f = Func(m.group(2), int(m.group(1), 16))
+			funcs[f.name] = f
+			continue
+		m = re.match(r'^\s+([0-9a-f]+):\t((?:[0-9a-f]{2} )+)\s*\t(\S+)\s*(.*)$', line)
+		if not m or f is None:
+			continue
+		addr, size, op, args = int(m.group(1), 16), len(m.group(2).split()), m.group(3), m.group(4)
+		target = None
+		t = re.search(r';\s*0x([0-9a-f]+)', args)
+		if t:
+			target = int(t.group(1), 16)
+		elif re.match(r'^\.[+-]\d+', args):
+			target = addr + 2 + int(re.match(r'^\.([+-]\d+)', args).group(1))
+		elif op in ('jmp', 'call') and args.startswith('0x'):
+			target = int(args.split()[0], 16)
+		f.at[addr] = len(f.code)
+		f.code.append(Insn(addr, size, op, args.split(';')[0].strip(), target))
+	return funcs
+
+
+def byAddr(funcs):
+	return dict((f.addr, f) for f in funcs.values())
+
+
+def calls(f, funcs):
+	"""functions f calls (or jumps to, tail calls), None for an indirect call"""
+	entry = byAddr(funcs)
+	out = set()
+	for i in f.code:
+		if i.op in ('icall', 'ijmp', 'eicall', 'eijmp'):
+			out.add(None)
+		elif i.op in ('rcall', 'call', 'rjmp', 'jmp') and i.target is not None:
+			if i.target in entry and entry[i.target] is not f:
+				out.add(entry[i.target].name)
+	return out
+
+
+def pushes(f):
+	return len([i for i in f.code if i.op == 'push'])
+
+
+def readStack(build):
+	"""-fstack-usage: function -> bytes"""
+	frames = {}
+	for name in os.listdir(build):
+		if name.endswith('.su'):
+			for line in open(os.path.join(build, name)):
+				f = line.split('\t')
+				if len(f) >= 2:
+					frames[f[0].split(':')[-1]] = int(f[1])
+	return frames
+
+
+def stack(name, funcs, frames, ret, seen=()):
+	"""deepest stack below a function: (bytes, path, complete)"""
+	f = funcs.get(name)
+	if f is None or name in seen:
+		return 0, [name], name not in seen
+	own = max(frames.get(name, 0), pushes(f))
+	deepest, path, complete = 0, [], True
+	for c in calls(f, funcs):
+		if c is None:
+			complete = False
+			continue
+		n, p, ok = stack(c, funcs, frames, ret, seen + (name,))
+		complete = complete and ok
+		if ret + n > deepest:
+			deepest, path = ret + n, p
+	return own + deepest, [name] + path, complete
+
+
+def cycles(name, funcs, seen=()):
+	"""cycles from entry to ret/reti: (min, max, complete). a loop is counted once"""
+	f = funcs.get(name)
+	if f is None or name in seen or not f.code:
+		return 0, 0, False
+	entry = byAddr(funcs)
+	memo, open_, state = {}, set(), {'complete': True}
+
+	def callee(target):
+		c = entry.get(target)
+		if c is None:
+			state['complete'] = False
+			return 0, 0
+		lo, hi, ok = cycles(c.name, funcs, seen + (name,))
+		state['complete'] = state['complete'] and ok
+		return lo, hi
+
+	def walk(k):
+		if k >= len(f.code):
+			return 0, 0
+		if k in memo:
+			return memo[k]
+		if k in open_:
+			state['complete'] = False       # a loop: once
+			return 0, 0
+		open_.add(k)
+		i = f.code[k]
+		nxt = k + 1
+		if i.op in ('ret', 'reti'):
+			res = (CYCLES[i.op], CYCLES[i.op])
+		elif i.op in ('icall', 'ijmp', 'eicall', 'eijmp'):
+			state['complete'] = False
+			res = walk(nxt) if i.op.endswith('call') else (0, 0)
+			res = (res[0] + CYCLES.get(i.op, 3), res[1] + CYCLES.get(i.op, 3))
+		elif i.op in ('rcall', 'call'):
+			lo, hi = callee(i.target)
+			r = walk(nxt)
+			res = (CYCLES[i.op] + lo + r[0], CYCLES[i.op] + hi + r[1])
+		elif i.op in ('rjmp', 'jmp'):
+			if i.target in f.at:
+				r = walk(f.at[i.target])
+			else:
+				r = callee(i.target)        # tail call
+			res = (CYCLES[i.op] + r[0], CYCLES[i.op] + r[1])
+		elif i.op.startswith('br') and i.target is not None:
+			a = walk(nxt)
+			b = walk(f.at[i.target]) if i.target in f.at else callee(i.target)
+			res = (min(1 + a[0], 2 + b[0]), max(1 + a[1], 2 + b[1]))
+		elif i.op in SKIPS:
+			a = walk(nxt)
+			skipped = f.code[nxt].size // 2 if nxt < len(f.code) else 1
+			b = walk(nxt + 1)
+			res = (min(1 + a[0], 1 + skipped + b[0]), max(1 + a[1], 1 + skipped + b[1]))
+		else:
+			r = walk(nxt)
+			c = CYCLES.get(i.op, 1)
+			res = (c + r[0], c + r[1])
+		open_.discard(k)
+		memo[k] = res
+		return res
+
+	sys.setrecursionlimit(max(sys.getrecursionlimit(), 10 * len(f.code) + 1000))
+	lo, hi = walk(0)
+	return lo, hi, state['complete']
+
+
+# -- one build ------------------------------------------------------------
+
+def build(args, prof, name, flags, font, tmp):
+	"""compile and link one configuration, None if it does not build"""
+	d = os.path.join(tmp, name.replace('+', '_'))
+	os.mkdir(d)
+	obj, elf, map_ = [os.path.join(d, 'blinken' + e) for e in ('.o', '.elf', '.map')]
+	cc = shlex.split(args.cc)
+	cflags = ['-Wall', '-Wstrict-prototypes', '-Os'] + shlex.split(args.opts) + flags + \
+	         ['-DPROFILE=%s' % prof['name'], '-DFONT="%s"' % font, '-mmcu=%s' % prof['mcu']]
+	ok, out = run(cc + cflags + ['-fstack-usage', '-c', os.path.join(HERE, 'blinken.c'), '-o', obj], cwd=d)
+	if ok:
+		ok, out = run(cc + cflags + ['-Wl,-Map=%s' % map_, '-o', elf, obj], cwd=d)
+	if not ok:
+		sys.stderr.write('%s: %s does not build:\n%s\n' % (sys.argv[0], name, out.strip()))
+		return None
+
+	sections, objects = readMap(map_)
+	syms = readSymbols(args.prefix + 'nm', elf)
+	funcs = readCode(args.prefix + 'objdump', elf)
+	frames = readStack(d)
+
+	text, data = sections.get('.text', 0), sections.get('.data', 0)
+	bss = sections.get('.bss', 0) + sections.get('.noinit', 0)
+	res = {
+		'config': name, 'flags': flags, 'font': font,
+		'flash': text + data, 'sram': data + bss, 'eeprom': sections.get('.eeprom', 0),
+		'sections': sections, 'objects': objects,
+		'symbols': dict((s, {'kind': k, 'bytes': n}) for s, (k, n) in syms.items()),
+	}
+
+	# main is called by the startup code, the ISR may come on top of its deepest call
+	ret = 3 if prof['flash'] > 128 * 1024 else 2
+	depth, path, complete = stack('main', funcs, frames, ret)
+	res['stack'] = {'main': ret + depth, 'path': path, 'complete': complete}
+	isrs = sorted(f for f in funcs if re.match(r'^__vector_\d+$', f))
+	for v in isrs:
+		n, p, ok = stack(v, funcs, frames, ret)
+		res['stack'].setdefault('isr', {})[v] = ret + n
+		complete = complete and ok
+	res['stack']['worst'] = res['stack']['main'] + max([0] + list(res['stack'].get('isr', {}).values()))
+	res['stack']['complete'] = complete
+
+	# the vector jumps to the ISR
+	vectors = funcs.get('__vectors')
+	jump = max([CYCLES.get(i.op, 2) for i in vectors.code] if vectors and vectors.code else [2])
+	res['isr'] = {}
+	for v in isrs:
+		lo, hi, ok = cycles(v, funcs)
+		res['isr'][v] = {'min': IRQ_ENTRY + jump + lo, 'max': IRQ_ENTRY + jump + hi, 'complete': ok}
+	return res
+
+
+# -- report ---------------------------------------------------------------
+
+def delta(n):
+	return '%+d' % n if n else ''
+
+
+def report(args, prof, cc, results):
+	base = results[0]
+	ram, ramstart = SRAM.get(prof['mcu'], (0, 0))
+	tick = prof['clock'] // TICK_HZ
+
+	print('%s, profile %s: %s, %d bytes flash, %d sram, %d eeprom, %.0f MHz, %d cycles per tick'
+	      % (cc, prof['name'], prof['mcu'], prof['flash'], ram, prof['eeprom'], prof['clock'] / 1e6, tick))
+
+	print('\n%-22s %7s %6s %6s %6s %6s %6s %6s  %s' % ('config', 'flash', '', 'sram', '', 'eeprom', 'stack', 'free', 'isr cycles, % of a tick'))
+	for r in results:
+		isr = ', '.join('%d..%d %.0f%%%s' % (c['min'], c['max'], 100.0 * c['max'] / tick, '' if c['complete'] else ' (loop/call)')
+		                for c in r['isr'].values())
+		s = r['stack']
+		print('%-22s %7d %6s %6d %6s %6d %6s %6s  %s' % (
+			r['config'], r['flash'], delta(r['flash'] - base['flash']), r['sram'], delta(r['sram'] - base['sram']), r['eeprom'],
+			'%d%s' % (s['worst'], '' if s['complete'] else '?'),
+			ram - r['sram'] - s['worst'] if ram else '', isr))
+		if r['flash'] > prof['flash'] or (ram and r['sram'] + s['worst'] > ram):
+			print('  ! does not fit the %s' % prof['mcu'])
+
+	# the default build in detail
+	print('\n%s: flash per object' % base['config'])
+	for obj, n in sorted(base['objects'].items(), key=lambda o: -o[1]):
+		print('  %7d  %s' % (n, obj))
+
+	print('\n%s: the largest functions and variables' % base['config'])
+	syms = sorted(base['symbols'].items(), key=lambda s: -s[1]['bytes'])
+	for name, s in syms[:args.top]:
+		print('  %7d  %-7s %s' % (s['bytes'], s['kind'], name))
+
+	s = base['stack']
+	print('\n%s: stack %d bytes at most: %s, then the ISR (%s)' % (base['config'], s['worst'], ' > '.join(s['path']),
+	      ', '.join('%s %d' % v for v in sorted(s.get('isr', {}).items()))))
+	if not s['complete']:
+		print('  ! indirect calls or recursion: more is possible')
+
+	# per feature: what changed against the default build
+	for r in results[1:]:
+		print('\n%s (%s): flash %s, sram %s, stack %s' % (r['config'], ' '.join(r['flags']) or r['font'],
+		      delta(r['flash'] - base['flash']) or '0', delta(r['sram'] - base['sram']) or '0',
+		      delta(r['stack']['worst'] - s['worst']) or '0'))
+		names = set(r['symbols']) | set(base['symbols'])
+		diff = []
+		for name in names:
+			a = base['symbols'].get(name, {'bytes': 0})
+			b = r['symbols'].get(name, {'bytes': 0})
+			if a['bytes'] != b['bytes']:
+				diff.append((b['bytes'] - a['bytes'], name, b.get('kind', a.get('kind'))))
+		for n, name, kind in sorted(diff, key=lambda d: -abs(d[0]))[:args.top]:
+			print('  %+7d  %-7s %s' % (n, kind, name))
+
+
+def main():
+	ap = argparse.ArgumentParser(description='Flash, sram, eeprom, stack and ISR cycles of every firmware configuration.')
+	ap.add_argument('--cc', default='avr-gcc', help='compiler (default %(default)s)')
+	ap.add_argument('--prefix', default='avr-', help='of nm and objdump (default %(default)s)')
+	ap.add_argument('--opts', default='-ffreestanding -fno-inline-small-functions -fno-move-loop-invariants -Wl,--relax',
+	                help='compiler and linker options, as in the Makefile')
+	ap.add_argument('--profile', default='blinken64', help='device profile, see profiles.h (default %(default)s)')
+	ap.add_argument('--font', default='font.h', help='font header (default %(default)s)')
+	ap.add_argument('--packed-font', help='the same font w/ the dictionary (fontconv --packed): one more configuration')
+	ap.add_argument('--only', help='configurations, comma separated (default: all)')
+	ap.add_argument('--top', type=int, default=12, help='functions per list (default %(default)s)')
+	ap.add_argument('--json', help='everything as json into this file')
+	ap.add_argument('--keep', metavar='DIR', help='keep the builds (map, elf, .su) in DIR')
+	args = ap.parse_args()
+	if args.profile not in firmware_profiles():
+		ap.error('profile %s: no pin map for it yet, the firmware builds for %s' % (args.profile, ', '.join(firmware_profiles())))
+
+	prof = profile(args.profile)
+	configs = [(n, f, args.font) for n, f in CONFIGS]
+	if args.packed_font:
+		configs.append(('packedfont', [], args.packed_font))
+	if args.only:
+		only = args.only.split(',')
+		configs = [c for c in configs if c[0] in only or c[0] == 'default']
+
+	ok, version = run(shlex.split(args.cc) + ['--version'])
+	if not ok:
+		sys.exit('%s: no %s' % (sys.argv[0], args.cc))
+
+	tmp = tempfile.mkdtemp(prefix='footprint')
+	results = []
+	for name, flags, font in configs:
+		r = build(args, prof, name, flags, font, tmp)
+		if r is None and name == 'default':
+			sys.exit(1)
+		if r:
+			results.append(r)
+
+	report(args, prof, version.splitlines()[0], results)
+	if args.json:
+		json.dump({'profile': prof, 'compiler': version.splitlines()[0], 'builds': results},
+		          open(args.json, 'w'), indent=1, sort_keys=True)
+	if args.keep:
+		shutil.rmtree(args.keep, True)
+		shutil.copytree(tmp, args.keep)
+	shutil.rmtree(tmp, True)
+	sys.exit(0 if len(results) == len(configs) else 1)
+
+
+if __name__ == '__main__':
+	main()
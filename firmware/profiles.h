@@ -0,0 +1,108 @@
+/*
+ *  blinken64 / profiles.h
+ *
+ *  Device profiles: eeprom, flash, picture slots and clock of the parts
+ *  blinken64 can run on. Shared by the firmware (built for PROFILE, see the
+ *  Makefile) and the tools (--profile <name>).
+ *
+ *  Copyright (C) 2011 Manuel Jerger <nom@nomnom.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __PROFILES_H__
+# define __PROFILES_H__
+
+
+// eeprom: bytes used for messages and pictures (pictures at the end)
+// pictures: eeprom picture slots, 8 columns each. more than 8 need the
+//           two byte PICTURE_X code (textconv \P9, \PA..\PG)
+//
+//                          mcu            eeprom  flash  pictures  clock
+#define PROFILE_blinken64   ("attiny4313",    128,  4096,     8,  4000000)   // the badge, eeprom layout of the attiny2313 boards
+#define PROFILE_attiny4313  ("attiny4313",    256,  4096,    16,  4000000)   // same board, whole eeprom
+#define PROFILE_attiny84    ("attiny84",      512,  8192,    16,  8000000)
+#define PROFILE_atmega328p  ("atmega328p",   1024, 32768,    16,  8000000)
+
+#define PROFILES(P)     P(blinken64) P(attiny4313) P(attiny84) P(atmega328p)
+
+// the firmware builds only for these, they have a pin map in display.h and
+// comm.h. The others size the eeprom image of the tools (--profile) for now.
+// Read by the Makefile, badged.py, provision.py and footprint.py
+#define PROFILES_FIRMWARE   "blinken64 attiny4313"
+
+#define PROFILE_DEFAULT blinken64
+#define PROFILE_MAXEEPROM   (1024)
+#define PROFILE_MAXPICTURES (16)
+
+
+// fields of a profile
+#define _P_MCU(m,e,f,p,c)       m
+#define _P_EEPROM(m,e,f,p,c)    e
+#define _P_FLASH(m,e,f,p,c)     f
+#define _P_PICTURES(m,e,f,p,c)  p
+#define _P_CLOCK(m,e,f,p,c)     c
+#define _P_FIELD(_f, _p)        _f _p
+#define _P_CAT(_a, _b)          _a ## _b
+#define _P_GET(_f, _name)       _P_FIELD(_f, _P_CAT(PROFILE_, _name))
+
+
+#ifdef __AVR__
+
+// firmware: constants of the profile it is built for
+# ifndef PROFILE
+#  define PROFILE PROFILE_DEFAULT
+# endif
+
+# define EEPROM_SIZE    _P_GET(_P_EEPROM, PROFILE)
+# define FLASH_SIZE     _P_GET(_P_FLASH, PROFILE)
+# define PICTURES       _P_GET(_P_PICTURES, PROFILE)
+# ifndef F_CPU
+#  define F_CPU         _P_GET(_P_CLOCK, PROFILE)
+# endif
+
+# if EEPROM_SIZE > E2END + 1
+#  error "profile has more eeprom than the part"
+# endif
+# if !defined(PORTA) || !defined(PORTD)
+#  error "no pin map for this part yet, see display.h and comm.h"
+# endif
+
+// timer 1 interrupt mask and flags of the larger parts
+# ifndef TIMSK
+#  define TIMSK TIMSK1
+# endif
+# ifndef TIFR
+#  define TIFR  TIFR1
+# endif
+
+#else
+
+// tools: all profiles, by name
+struct profile {
+    const char *name, *mcu;
+    int eeprom, flash, pictures;
+    long clock;
+};
+
+# define _P_ARGS(m,e,f,p,c)     m, e, f, p, c
+# define _P_ROW2(_s, _p)        { _s, _P_ARGS _p },
+# define _P_ROW(_name)          _P_ROW2(#_name, _P_CAT(PROFILE_, _name))
+
+static const struct profile profiles[] = { PROFILES(_P_ROW) { 0, 0, 0, 0, 0, 0 } };
+
+#endif
+
+#endif
@@ -0,0 +1,254 @@
+#!/usr/bin/env python3
+# encoding:utf8
+
+#
+# provision.py : provision a batch of blinken64 chips on several programmers
+#
+# Replaces flash.sh (one chip per keypress, 'make fuse flash textconvert
+# clear_eeprom eeflash'): every programmer runs the stages fuse, flash,
+# eeprom and verify on its chip, all programmers at the same time. A failed
+# stage is retried, a unit that still fails is reported and skipped. Every
+# unit gets a line in the log (json) w/ programmer, stage timings and tries.
+#
+#   ./provision.py -n 200 -P usb:001:004 -P usb:001:005 --hex blinken.hex
+#   ./provision.py -n 20 --simulate 4 --sim-fail 0.05        (no hardware)
+#
+# --prompt waits for <enter> (or the programmer number) before every unit,
+# so there is time to change the chip.
+#
+#  Copyright (C) 2011 Manuel Jerger <nom@nomnom.de>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+import argparse
+import json
+import os
+import re
+import shlex
+import shutil
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+try:
+	import queue
+except ImportError:
+	import Queue as queue
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+TEXTCONV = os.path.join(HERE, '..', 'tools', 'textconv')
+MOCK = os.path.join(HERE, '..', 'tools', 'mock', 'avrdude')
+
+STAGES = ('fuse', 'flash', 'eeprom', 'verify')
+
+
+class Programmer(object):
+	"""one avrdude programmer, runs the stages of one unit after the other"""
+
+	def __init__(self, nr, cmd, env=None):
+		self.nr = nr
+		self.cmd = cmd
+		self.env = env
+		self.prompt = threading.Event()
+
+	def run(self, ops):
+		args = []
+		for op in ops:
+			args += ['-U', op]
+		p = subprocess.Popen(self.cmd + args, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, env=self.env)
+		out = p.communicate()[0].decode('utf8', 'replace').strip()
+		return p.returncode == 0, out.splitlines()[-1] if out else ''
+
+
+class Batch(object):
+
+	def __init__(self, args, ops, log):
+		self.args = args
+		self.ops = ops              # stage -> avrdude -U operations
+		self.log = log
+		self.units = queue.Queue()
+		self.lock = threading.Lock()
+		self.results = []
+		self.t_start = time.time()
+
+	def unit(self, prog, nr):
+		res = {'unit': nr, 'programmer': prog.nr, 'start': time.strftime('%Y-%m-%d %H:%M:%S'),
+		       'stages': {}, 'tries': {}, 'ok': True}
+		t0 = time.time()
+		for stage in STAGES:
+			if not self.ops[stage]:
+				continue
+			t = time.time()
+			for tries in range(1, self.args.retries + 2):
+				ok, msg = prog.run(self.ops[stage])
+				if ok:
+					break
+			res['stages'][stage] = round(time.time() - t, 3)
+			res['tries'][stage] = tries
+			if not ok:
+				res['ok'] = False
+				res['failed'] = stage
+				res['error'] = msg
+				break
+		res['time'] = round(time.time() - t0, 3)
+		return res
+
+	def worker(self, prog):
+		while True:
+			try:
+				nr = self.units.get_nowait()
+			except queue.Empty:
+				return
+			if self.args.prompt:
+				prog.prompt.wait()
+				prog.prompt.clear()
+			res = self.unit(prog, nr)
+			with self.lock:
+				self.results.append(res)
+				self.log.write(json.dumps(res, sort_keys=True) + '\n')
+				self.log.flush()
+			state = 'ok' if res['ok'] else 'FAILED in %s: %s' % (res['failed'], res['error'])
+			sys.stdout.write('unit %3d  programmer %d  %5.1fs  %s\n' % (nr, prog.nr, res['time'], state))
+			sys.stdout.flush()
+			if res['ok'] and self.args.label:
+				label(self.args.label, res)
+
+	def summary(self):
+		t = time.time() - self.t_start
+		ok = [r for r in self.results if r['ok']]
+		retried = len([r for r in self.results if max(r['tries'].values() or [1]) > 1])
+		print('\n%d units in %.1fs, %d ok, %d failed, %d needed retries, %.0f units/hour'
+		      % (len(self.results), t, len(ok), len(self.results) - len(ok), retried,
+		         len(ok) * 3600.0 / t if t else 0))
+		for stage in STAGES:
+			times = [r['stages'][stage] for r in ok if stage in r['stages']]
+			if times:
+				print('  %-7s mean %5.2fs  max %5.2fs' % (stage, sum(times) / len(times), max(times)))
+		return len(ok) == len(self.results)
+
+
+def label(printer, res):
+	# same label as flash.sh
+	text = ('Blinken64 Firmware Info\nDate:  %s\nUnit:  %d\n' % (time.strftime('%Y-%m-%d-%H-%M-%S'), res['unit']))
+	p = subprocess.Popen(['lpr', '-o', 'DocCutType=1PartialCutDoc', '-P', printer], stdin=subprocess.PIPE)
+	p.communicate(text.encode('utf8'))
+
+
+def firmware_profiles():
+	"""profiles the firmware builds for, PROFILES_FIRMWARE in profiles.h"""
+	src = open(os.path.join(HERE, 'profiles.h')).read()
+	m = re.search(r'#define\s+PROFILES_FIRMWARE\s+"([^"]*)"', src)
+	return m.group(1).split() if m else []
+
+
+def main():
+	ap = argparse.ArgumentParser(description='Provision blinken64 chips on several programmers at once.')
+	ap.add_argument('-n', '--units', type=int, default=1, help='units to provision (default %(default)s)')
+	ap.add_argument('-P', '--port', action='append', default=[], help='programmer port, once per programmer')
+	ap.add_argument('-a', '--avrdude', default='avrdude -c usbasp -p attiny4313', help='avrdude w/o -P (default "%(default)s")')
+	ap.add_argument('--hex', default=os.path.join(HERE, 'blinken.hex'), help='firmware (default blinken.hex)')
+	ap.add_argument('--text', default=os.path.join(HERE, 'text.txt'), help='eeprom text (default text.txt)')
+	ap.add_argument('--picture', help='eeprom pictures (64x8 pixel pgm), like textconv -p')
+	ap.add_argument('--profile', default='blinken64', help='device profile, see profiles.h (default %(default)s)')
+	ap.add_argument('--fuses', default='lfuse:w:0xE4:m hfuse:w:0x9D:m', help='fuse operations (default "%(default)s")')
+	ap.add_argument('-r', '--retries', type=int, default=2, help='retries per stage (default %(default)s)')
+	ap.add_argument('-l', '--log', default='provision.log', help='per unit log, json lines (default %(default)s)')
+	ap.add_argument('--label', metavar='PRINTER', help='print a label for every good unit (lpr)')
+	ap.add_argument('--prompt', action='store_true', help='wait for <enter> / programmer number before each unit')
+	ap.add_argument('--simulate', type=int, metavar='N', help='use N simulated programmers (tools/mock/avrdude)')
+	ap.add_argument('--sim-speed', type=float, default=1.0, help='time factor of the simulation (default %(default)s)')
+	ap.add_argument('--sim-fail', type=float, default=0.0, help='failure rate per avrdude run (default %(default)s)')
+	args = ap.parse_args()
+	if args.profile not in firmware_profiles():
+		ap.error('profile %s: no pin map for it yet, the firmware builds for %s' % (args.profile, ', '.join(firmware_profiles())))
+
+	tmp = tempfile.mkdtemp(prefix='provision')
+	progs = []
+	if args.simulate:
+		for i in range(args.simulate):
+			env = dict(os.environ)
+			env['AVRDUDE_MOCK_DIR'] = os.path.join(tmp, 'prog%d' % (i + 1))
+			env['AVRDUDE_MOCK_SPEED'] = str(args.sim_speed)
+			env['AVRDUDE_MOCK_FAIL'] = str(args.sim_fail)
+			os.mkdir(env['AVRDUDE_MOCK_DIR'])
+			progs.append(Programmer(i + 1, [MOCK], env))
+	else:
+		base = shlex.split(args.avrdude)
+		for i, port in enumerate(args.port or ['usb']):
+			progs.append(Programmer(i + 1, base + ['-P', port]))
+
+	# eeprom image: converted once for the whole batch
+	if not os.path.exists(TEXTCONV):
+		subprocess.check_call(['make', '-C', os.path.join(HERE, '..', 'tools'), 'textconv'])
+	eeprom = os.path.join(tmp, 'eeprom.bin')
+	cmd = [TEXTCONV, '-i', args.text, '-o', eeprom, '--ee', '--profile', args.profile]
+	if args.picture:
+		cmd += ['-p', args.picture]
+	subprocess.check_call(cmd, stdout=open(os.devnull, 'w'))
+
+	if os.path.exists(args.hex):
+		flash = ['flash:w:%s:i' % args.hex]
+	elif args.simulate:
+		# no firmware built: something of the usual size
+		image = os.path.join(tmp, 'blinken.bin')
+		open(image, 'wb').write(os.urandom(2000))
+		flash = ['flash:w:%s:r' % image]
+	else:
+		sys.exit('%s: %s not found, run make first' % (sys.argv[0], args.hex))
+	ops = {
+		'fuse': [op for op in args.fuses.split() if op != '-U'],
+		'flash': flash,
+		'eeprom': ['eeprom:w:%s:r' % eeprom],
+		'verify': [op.replace(':w:', ':v:') for op in flash] + ['eeprom:v:%s:r' % eeprom],
+	}
+
+	log = open(args.log, 'a')
+	batch = Batch(args, ops, log)
+	for nr in range(1, args.units + 1):
+		batch.units.put(nr)
+
+	threads = []
+	for prog in progs:
+		t = threading.Thread(target=batch.worker, args=(prog,))
+		t.daemon = True
+		t.start()
+		threads.append(t)
+
+	print('%d units on %d programmer(s), log in %s' % (args.units, len(progs), args.log))
+	try:
+		if args.prompt:
+			# <enter>: every programmer may start, <n>: programmer n may start
+			while any(t.is_alive() for t in threads):
+				line = sys.stdin.readline()
+				if not line:
+					break
+				for prog in progs:
+					if not line.strip() or line.strip() == str(prog.nr):
+						prog.prompt.set()
+		for t in threads:
+			while t.is_alive():
+				t.join(0.5)
+	except KeyboardInterrupt:
+		pass
+	log.close()
+	shutil.rmtree(tmp, True)
+
+	sys.exit(0 if batch.summary() else 1)
+
+
+if __name__ == '__main__':
+	main()
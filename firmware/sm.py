@@ -35,7 +35,21 @@ import logging as log
 import os
 import time
 
+BADGED = '/tmp/badged.sock'
+
 def do_smth_external():
+		# badged.py running: it does the substitution and flashing, from a queue
+		if os.path.exists(BADGED):
+			import socket
+			s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+			try:
+				s.connect(BADGED)
+				s.sendall('name %s\n' % get_text().strip().replace('\n', ' '))
+				log.warn(s.recv(200).strip())
+				s.close()
+				return
+			except socket.error:
+				log.warn('badged not running, falling back to make')
 		infile = open('text.orig').read()
 		out = open('text.txt', 'w')
 		replacements = {'VORNAME':get_text().strip()}
@@ -0,0 +1,706 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "../firmware/comm.h"
+#include "libblinken.h"
+
+#define AUTHORS "Manuel Jerger"
+#define VERSION "0.1"
+
+#define TRUE ~(uint)0
+#define FALSE (uint)0
+
+
+/*
+ * blinkenaudio : the pulse link as sound, for the audio jack of the
+ * audio_connect board: a badge is programmed from anything that plays a wav.
+ *
+ * Encoder (default): an eeprom image (textconv output) -> the PROG sequence
+ * of the programmer bridge (blinkenprog.pde): the line low while the badge is
+ * switched on (lead), then high, the calibration byte 0x55, the init sequence
+ * 0xAA 0xAA and the data, every byte a start edge, a pulse per bit
+ * (COM_T_LOW / COM_T_HIGH ticks) and the stop edge, with the gap of the
+ * bridge before it. Displays built w/ _FRAME_CHECK_ get crc checked frames
+ * and the parity pulse (--framecheck), nobody can answer them here, so the
+ * frames can be sent more than once (-n, every one again right after it):
+ * one that was broken the first time is written the next. W/o frames the eeprom is written as it comes,
+ * once. --stream: column bytes (blinkenvideo output) for
+ * a chain in SLAVE mode instead, the line high while there are none.
+ *
+ * Line high is the positive half wave (--invert for a board that inverts).
+ * The speed is the tick of the transmitter (-s, like key A of the bridge:
+ * below 50 us only for displays w/ _AUTOBAUD_). The coupling capacitors of
+ * the audio path are a high pass, the level of a long pulse droops to the
+ * middle. --coupling Hz pre-distorts the signal w/ the inverse of that high
+ * pass (the level plus the integral of it, leaking slowly so it stays
+ * bounded), the whole thing is scaled down to fit.
+ *
+ * Decoder (--decode): the wav as the badge sees it: the high pass of
+ * --coupling, a comparator w/ hysteresis (the schmitt trigger of the pin),
+ * sampled by the ISR every 50 us and decoded like blinken.c does (incl.
+ * _AUTOBAUD_ w/ --autobaud, the parity pulse and the frames w/ --framecheck).
+ * The badge is switched on at the start of the wav, it goes into PROG mode
+ * if the line is low after the boot delay (--stream: it is on already, a
+ * SLAVE). Writes what ended up in the
+ * eeprom from address 2 on (the format of textconv), or the columns w/
+ * --stream; loopback: make audioloop.
+ */
+
+#define EEPROM_BEGIN    (2)             // see blinken.c
+#define RX_TICK_US      (BL_TICK_US)    // ISR of the badge
+#define GAP_US          (2000)          // bytegap of blinkenprog.pde at 50 us
+#define HOLD_US         (20000)         // bytedelay: high before the calibration byte
+#define FRAME_GAP_US    (COM_T_FRAME_GAP * 1000 + 10000)    // after a frame: the ACK, and a broken one is aborted
+#define IDLE_US         (10000)         // --stream: high while no column comes in
+#define LEAK            (4)             // --coupling: integral leaks w/ LEAK times the time constant
+
+#define MAXSAMPLES      (1L << 28)
+
+
+char *program_name = "blinkenaudio";
+
+char *input, *output;
+
+int quiet = TRUE, decode = FALSE, stream = FALSE, framecheck = FALSE, autobaud = FALSE;
+int raw = FALSE, invert = FALSE;
+long rate = 48000;          // samples per second
+double tick = 50;           // us per tick of the transmitter
+double amplitude = 0.8;
+double coupling = 0;        // Hz, corner of the high pass of the audio path, 0: none
+double lead = 1000;         // ms low before the data (PROG: the badge is switched on in it)
+int passes = 1;
+
+const struct bl_profile *prof;
+
+FILE *out;
+long samples = 0;           // written
+double now_us = 0;          // end of what is written
+double integ = 0;           // --coupling: integral, step after a long level
+double rearm = 0;
+double path = 0, last = 0;  // the high pass: output, last input
+
+void encodeImage (void);
+void encodeStream (void);
+int decodeWav (void);
+void info(char *);
+
+
+////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+
+    program_name = argv[0];
+    prof = bl_profile(NULL);
+
+    // while args left..
+    int a = 1; int last_a = 1;
+    do {
+        last_a = a;
+        // two args
+        if (a+1 < argc) {
+
+            // image, columns, wav
+            if (!strcmp (argv[a], "-i")) {
+                input = argv[a+1];
+                a += 2;
+
+            } else if (!strcmp (argv[a], "-o")) {
+                output = argv[a+1];
+                a += 2;
+
+            // sample rate
+            } else if (!strcmp (argv[a], "-r")) {
+                rate = atol(argv[a+1]);
+                a += 2;
+
+            // tick of the transmitter
+            } else if (!strcmp (argv[a], "-s")) {
+                tick = atof(argv[a+1]);
+                a += 2;
+
+            } else if (!strcmp (argv[a], "-a")) {
+                amplitude = atof(argv[a+1]);
+                a += 2;
+
+            // high pass of the audio path
+            } else if (!strcmp (argv[a], "--coupling")) {
+                coupling = atof(argv[a+1]);
+                a += 2;
+
+            } else if (!strcmp (argv[a], "-l")) {
+                lead = atof(argv[a+1]);
+                a += 2;
+
+            // the image more than once
+            } else if (!strcmp (argv[a], "-n")) {
+                passes = atoi(argv[a+1]);
+                a += 2;
+
+            // device profile: eeprom size
+            } else if (!strcmp (argv[a], "--profile")) {
+                prof = bl_profile(argv[a+1]);
+                if (prof == NULL) {
+                    fprintf (stderr, "%s: unknown profile %s, see textconv --help\n", program_name, argv[a+1]);
+                    exit (EXIT_FAILURE);
+                }
+                a += 2;
+            }
+        }
+
+        // one arg (a may have changed)
+        if (a < argc) {
+
+            if (!strcmp (argv[a], "--decode")) {
+                decode = TRUE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--stream")) {
+                stream = TRUE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--framecheck")) {
+                framecheck = TRUE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--autobaud")) {
+                autobaud = TRUE;
+                a++;
+
+            // pcm w/o wav header
+            } else if (!strcmp (argv[a], "--raw")) {
+                raw = TRUE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--invert")) {
+                invert = TRUE;
+                a++;
+
+            // verbose
+            } else if (!strcmp (argv[a], "--verbose")) {
+                quiet = FALSE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--help")) {
+                fprintf (stdout, "\nThe pulse link as sound: program a badge from the audio jack, and the decoder for it.\n");
+                fprintf (stdout, "\nUsage: %s [-i image] [-o out.wav] [-s us] [--coupling Hz] [--framecheck] [-n passes] [-l ms] [--profile name]\n", program_name);
+                fprintf (stdout, "       %s --stream [-i columns] [-o out.wav] [-s us] [--coupling Hz]\n", program_name);
+                fprintf (stdout, "       %s --decode [-i in.wav] [-o image] [--stream] [--coupling Hz] [--framecheck] [--autobaud]\n", program_name);
+                fprintf (stdout, "\n    -i file          eeprom image (textconv), columns (--stream) or wav (--decode), default stdin");
+                fprintf (stdout, "\n    -o file          wav, image or columns (--decode), default stdout");
+                fprintf (stdout, "\n    -r rate          samples per second (default %ld)", rate);
+                fprintf (stdout, "\n    -s us            tick of the transmitter (default %g, less only for displays w/ _AUTOBAUD_)", tick);
+                fprintf (stdout, "\n    -a amplitude     of the wav, 0..1 (default %g)", amplitude);
+                fprintf (stdout, "\n   --coupling Hz     corner of the high pass of the audio path: pre-emphasis, and in the decoder (default off)");
+                fprintf (stdout, "\n   --framecheck      displays w/ _FRAME_CHECK_: parity, crc checked frames");
+                fprintf (stdout, "\n    -n passes        --framecheck: send the frames this often (default %d)", passes);
+                fprintf (stdout, "\n    -l ms            line low before the data, switch the badge on in it (default %g)", lead);
+                fprintf (stdout, "\n   --profile name    device profile, for the eeprom size (default %s)", bl_profile(NULL)->name);
+                fprintf (stdout, "\n   --stream          columns for a chain in SLAVE mode, not an eeprom image");
+                fprintf (stdout, "\n   --raw             pcm (16 bit, mono) w/o the wav header");
+                fprintf (stdout, "\n   --invert          line high is the negative half wave");
+                fprintf (stdout, "\n   --decode          wav -> what the badge gets");
+                fprintf (stdout, "\n   --autobaud        decoder: display w/ _AUTOBAUD_");
+                fprintf (stdout, "\n   --verbose         print log on stderr\n\n");
+
+                exit (EXIT_SUCCESS);
+            }
+        }
+
+    } while ( (a < argc) && (a != last_a) );
+
+    if (rate < 8000 || tick <= 0 || amplitude <= 0 || amplitude > 1 || passes < 1) {
+        fprintf (stderr, "%s: bad rate, speed, amplitude or passes, see --help\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+    if (passes > 1 && !framecheck) {
+        fprintf (stderr, "%s: more than one pass only w/ --framecheck, w/o frames the eeprom would be overwritten\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+
+    if (decode) {
+        exit (decodeWav() ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    out = output ? fopen(output, "wb") : stdout;
+    if (out == NULL) {
+        fprintf (stderr, "%s: can not write %s\n", program_name, output);
+        exit (EXIT_FAILURE);
+    }
+
+    if (stream) {
+        encodeStream();
+    } else {
+        encodeImage();
+    }
+    exit (EXIT_SUCCESS);
+}
+
+
+void info (char * str) {
+    if (!quiet) {
+        fprintf(stderr,"\n%s",str);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// wav
+
+void put32 (uint8_t *p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+void put16 (uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+
+
+// 16 bit mono pcm. sizes are fixed up at the end if the file can seek, a
+// stream has the largest ones
+void wavHeader (uint32_t bytes) {
+    uint8_t h[44];
+    if (raw) { return; }
+    memcpy(h, "RIFF", 4);
+    put32(h + 4, bytes == 0xFFFFFFFF ? bytes : bytes + 36);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put32(h + 16, 16);
+    put16(h + 20, 1);               // pcm
+    put16(h + 22, 1);               // mono
+    put32(h + 24, rate);
+    put32(h + 28, rate * 2);
+    put16(h + 32, 2);
+    put16(h + 34, 16);
+    memcpy(h + 36, "data", 4);
+    put32(h + 40, bytes);
+    fwrite(h, 1, sizeof(h), out);
+}
+
+
+void wavEnd () {
+    fflush(out);
+    if (!raw && fseek(out, 0, SEEK_SET) == 0) { wavHeader(samples * 2); }
+    if (out != stdout) { fclose(out); }
+}
+
+
+/*
+ * the line at level (1: high) for us. samples from the end of the last one
+ * to the end of this one, so the edges do not drift. w/ --coupling: x + w *
+ * integral of x, the inverse of the high pass (1 - 1/(1 + w/s)), the
+ * integral leaks w/ LEAK time constants. After a long level (the gaps) the
+ * high pass has pulled even that to the middle: the path is modelled, and
+ * at the end of a level that drooped by half, a step brings it back before
+ * the next edge (it leaks the same way). Scaled by the largest value.
+ */
+void level (int high, double us) {
+    double w = 2 * M_PI * coupling, dt = 1.0 / rate, scale = amplitude / (2 + LEAK);
+    double a = 1 / (1 + w * dt), x = (high ? 1 : -1) * (invert ? -1 : 1);
+    long end = llround((now_us + us) * rate / 1e6);
+    uint8_t b[2];
+
+    if (!coupling) { scale = amplitude; }
+
+    for (; samples < end; samples++) {
+        double s = x;
+        if (coupling) {
+            integ += (x - integ * w / LEAK) * dt;
+            rearm -= rearm * w / LEAK * dt;
+            if (samples == end - 1 && fabs(x - path) > 0.5) { rearm += (x - path) / a; }
+            s += w * integ + rearm;
+            path = a * (path + s - last);
+            last = s;
+            if (fabs(s) > 2 + LEAK) { s = s < 0 ? -2 - LEAK : 2 + LEAK; }
+        }
+        put16(b, (int16_t)lrint(s * scale * 32767));
+        fwrite(b, 1, 2, out);
+    }
+    now_us += us;
+}
+
+
+// a byte like transmit() / the bridge: gap (high), start edge, a pulse per bit, parity or stop
+void sendByte (uint8_t c) {
+    int i, lvl = 0, parity = 0;
+
+    level(1, GAP_US * tick / 50);
+    for (i=0; i<8; i++) {
+        int one = c & (1 << i);
+        level(lvl, (one ? COM_T_HIGH : COM_T_LOW) * tick);
+        lvl = !lvl;
+        parity ^= one ? 1 : 0;
+    }
+    if (framecheck) {
+        level(lvl, (parity ? COM_T_HIGH : COM_T_LOW) * tick);
+    } else {
+        level(lvl, COM_T_BIT/2 * tick);
+    }
+}
+
+
+// same as _crc_ibutton_update() of avr-libc
+uint8_t crc8 (uint8_t crc, uint8_t data) {
+    int i;
+    crc ^= data;
+    for (i = 0; i < 8; i++) {
+        crc = (crc & 1) ? (crc >> 1) ^ 0x8C : (crc >> 1);
+    }
+    return crc;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+void encodeImage () {
+
+    uint8_t image[BL_MAXEEPROM];
+    int len, i, n, p, addr;
+
+    len = bl_read_image(input ? input : "/dev/stdin", image, sizeof(image));
+    if (len <= 0) {
+        fprintf (stderr, "%s: can not read the image %s\n", program_name, input ? input : "from stdin");
+        exit (EXIT_FAILURE);
+    }
+
+    // w/ the dummy bytes (--ee): written from address 2 anyway
+    if (len >= prof->eeprom) {
+        len = prof->eeprom - EEPROM_BEGIN;
+        memmove(image, image + EEPROM_BEGIN, len);
+    }
+
+    wavHeader(0xFFFFFFFF);
+
+    // low: the badge starts in PROG mode. then the bridge's PROG sequence
+    level(0, lead * 1000);
+    level(1, HOLD_US);
+    sendByte(0x55);
+    sendByte(0xAA);
+    sendByte(0xAA);
+
+    if (!framecheck) {
+        for (i=0; i<len; i++) { sendByte(image[i]); }
+
+    // frames: addr (low byte), len, data, crc. the display answers every one.
+    // a frame again right after it: same address, the firmware does not count on
+    } else {
+        for (addr = 0; addr < len; addr += n) {
+            n = len - addr < COM_FRAME_MAX ? len - addr : COM_FRAME_MAX;
+            for (p=0; p<passes; p++) {
+                uint8_t crc = 0;
+                sendByte(addr + EEPROM_BEGIN);  crc = crc8(crc, addr + EEPROM_BEGIN);
+                sendByte(n);                    crc = crc8(crc, n);
+                for (i=0; i<n; i++) { sendByte(image[addr + i]); crc = crc8(crc, image[addr + i]); }
+                sendByte(crc);
+                level(1, FRAME_GAP_US);
+            }
+        }
+    }
+    // the bridge holds the line, then it goes low: the badge stays in PROG mode
+    level(1, HOLD_US);
+    level(0, 100000);
+
+    wavEnd();
+
+    if (!quiet) {
+        fprintf (stderr, "%d bytes, %d passes, %.2f s of sound, %.0f bytes/s\n", len, passes,
+                 now_us / 1e6, len * passes / ((now_us - lead * 1000) / 1e6));
+    }
+}
+
+
+// columns as they come in, high while there are none (a pipe: the wav goes on in real time)
+void encodeStream () {
+
+    FILE *in = input ? fopen(input, "rb") : stdin;
+    struct stat st;
+    int live, c;
+    long cols = 0;
+
+    if (in == NULL) {
+        fprintf (stderr, "%s: can not read %s\n", program_name, input);
+        exit (EXIT_FAILURE);
+    }
+    live = fstat(fileno(in), &st) == 0 && !S_ISREG(st.st_mode);
+
+    wavHeader(0xFFFFFFFF);
+    level(1, HOLD_US);
+
+    for (;;) {
+        if (live) {
+            struct pollfd p = { fileno(in), POLLIN, 0 };
+            fflush(out);
+            if (poll(&p, 1, IDLE_US / 1000) == 0) {
+                level(1, IDLE_US);
+                continue;
+            }
+        }
+        if ((c = getc(in)) == EOF) { break; }
+        sendByte(c);
+        cols++;
+    }
+    level(1, HOLD_US);
+
+    wavEnd();
+    if (in != stdin) { fclose(in); }
+
+    if (!quiet) {
+        fprintf (stderr, "%ld columns, %.2f s of sound, %.0f columns/s\n", cols, now_us / 1e6,
+                 cols / (now_us / 1e6));
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// decoder
+
+// receiver state, same names as in blinken.c
+struct rx {
+    uint8_t lastRead;
+    uint8_t rxBuff;
+    uint16_t comctr;
+    int8_t bitpos;
+    uint8_t bitmask;
+    uint8_t rxParity;
+    uint16_t rxSum;
+    uint8_t rxCal, rxLast, rxUp;
+    uint8_t thr;            // com_t_bit
+};
+
+
+// one ISR call, like blinken.c (and linktest). 1: byte complete, -1: parity error
+int isr (struct rx *r, uint8_t read) {
+
+    int done = 0, bits = framecheck ? 9 : 8;
+
+    if (r->lastRead != read) {
+
+        if (r->comctr <= COM_T_DEBOUNCE) {
+            r->comctr = 0;
+            r->bitpos = -1;
+            r->rxBuff = 0;
+        }
+
+        if (r->bitpos == -1) {
+            if (!read) {
+                r->bitpos = 0;
+                r->bitmask = 1;
+                r->rxParity = 0;
+                r->rxSum = 0;
+                r->rxCal = 1;
+            }
+        } else if (r->bitpos < bits) {
+            // 0x55 / 0xAA: short and long pulses by turns, w/o the parity pulse
+            if (r->bitpos < 8) {
+                uint8_t up = r->comctr > r->rxLast + (r->rxLast >> 1);
+                if (r->bitpos && ((!up && r->rxLast <= r->comctr + (r->comctr >> 1)) || (r->bitpos > 1 && up == r->rxUp))) { r->rxCal = 0; }
+                r->rxUp = up;
+                r->rxLast = r->comctr;
+                r->rxSum += r->comctr;
+            }
+            if (r->comctr < r->thr) {
+                r->rxBuff &= ~r->bitmask;
+                r->bitpos++;
+                r->bitmask <<= 1;
+            } else if (r->comctr < 2*r->thr) {
+                r->rxBuff |= r->bitmask;
+                r->bitpos++;
+                r->bitmask <<= 1;
+                r->rxParity ^= 1;
+            } else if (autobaud) {
+                r->thr = COM_T_BIT;
+                r->bitpos = -1;
+            }
+
+            if (r->bitpos == bits) {
+                if (framecheck) {
+                    done = r->rxParity ? -1 : 1;
+                    r->bitpos = -1;
+                } else {
+                    done = 1;
+                }
+            }
+        } else {
+            r->bitpos = -1;
+        }
+
+        r->lastRead = read;
+        r->comctr = 0;
+
+    } else {
+        if (++r->comctr >= COM_T_TIMEOUT) {
+            r->comctr = 0;
+            r->bitpos = -1;
+        }
+    }
+
+    return done;
+}
+
+
+// wav (pcm 8/16 bit, the first channel) or --raw -> samples as -1..1. NULL on error
+float *readWav (long *n) {
+
+    FILE *f = input ? fopen(input, "rb") : stdin;
+    uint8_t h[12], ch[8], *data = NULL;
+    long size = 0, len = 0;
+    int bits = 16, chans = 1, fmt = 1;
+    float *s;
+    long i;
+
+    if (f == NULL) { return NULL; }
+
+    if (!raw) {
+        if (fread(h, 1, 12, f) != 12 || memcmp(h, "RIFF", 4) || memcmp(h + 8, "WAVE", 4)) { return NULL; }
+        // chunks until the data, the rest of it is read below
+        while (fread(ch, 1, 8, f) == 8) {
+            size = ch[4] | ch[5] << 8 | ch[6] << 16 | (long)ch[7] << 24;
+            if (!memcmp(ch, "fmt ", 4)) {
+                uint8_t fm[40];
+                if (size < 16 || size > 40 || fread(fm, 1, size, f) != (size_t)size) { return NULL; }
+                fmt = fm[0] | fm[1] << 8;
+                chans = fm[2] | fm[3] << 8;
+                rate = fm[4] | fm[5] << 8 | fm[6] << 16 | (long)fm[7] << 24;
+                bits = fm[14] | fm[15] << 8;
+            } else if (!memcmp(ch, "data", 4)) {
+                break;
+            } else {
+                fseek(f, size + (size & 1), SEEK_CUR);
+            }
+        }
+        if (fmt != 1 || (bits != 8 && bits != 16) || chans < 1 || rate < 8000) { return NULL; }
+    }
+
+    // up to the end, the size of a streamed wav is not known
+    for (size = 1 << 20; ; size *= 2) {
+        data = realloc(data, size);
+        len += fread(data + len, 1, size - len, f);
+        if (len < size || size >= MAXSAMPLES) { break; }
+    }
+    if (f != stdin) { fclose(f); }
+
+    *n = len / (bits / 8) / chans;
+    s = malloc(*n * sizeof(float) + 1);
+    for (i=0; i<*n; i++) {
+        long at = i * chans * (bits / 8);
+        s[i] = bits == 8 ? (data[at] - 128) / 128.0 : (int16_t)(data[at] | data[at+1] << 8) / 32768.0;
+    }
+    free(data);
+    return s;
+}
+
+
+/*
+ * the audio path (high pass), the comparator, the ISR every 50 us, the main
+ * loop of the firmware: PROG mode if the line is low after the boot delay,
+ * otherwise SLAVE (columns) once bytes come in
+ */
+int decodeWav () {
+
+    struct rx r = { 1, 0, 0, -1, 0, 0, 0, 0, 0, 0, COM_T_BIT };
+    uint8_t ee[BL_MAXEEPROM], frame[COM_FRAME_MAX + 3];
+    float *s;
+    long n, i, t, ticks, last = -1;
+    long bytes = 0, parity = 0, frames = 0, badframes = 0, cols = 0;
+    double hp = 0, prev = 0, peak = 0, a, hyst;
+    int line = 1, prog = -1, p = 0, f = 0, top = 0, addr = 0, d, res;
+    FILE *o;
+
+    s = readWav(&n);
+    if (s == NULL) {
+        fprintf (stderr, "%s: can not read the wav %s\n", program_name, input ? input : "from stdin");
+        return -1;
+    }
+    o = output ? fopen(output, "wb") : stdout;
+    if (o == NULL) {
+        fprintf (stderr, "%s: can not write %s\n", program_name, output);
+        return -1;
+    }
+
+    // the high pass of the path, then the comparator: a quarter of the peak around the middle
+    a = coupling ? 1 / (1 + 2 * M_PI * coupling / rate) : 1;
+    for (i=0; i<n; i++) {
+        double x = s[i] * (invert ? -1 : 1);
+        hp = coupling ? a * (hp + x - prev) : x;
+        prev = x;
+        s[i] = hp;
+        if (fabs(hp) > peak) { peak = fabs(hp); }
+    }
+    hyst = peak / 4;
+    memset(ee, 0xFF, sizeof(ee));
+
+    ticks = (long)(n * 1e6 / rate / RX_TICK_US);
+    for (t=0; t<ticks; t++) {
+        long at = (long)(t * RX_TICK_US * rate / 1e6);
+        if (s[at] > hyst) { line = 1; } else if (s[at] < -hyst) { line = 0; }
+
+        // delay(15000) after power on, then the line is looked at once.
+        // --stream: the badge was on before, a SLAVE
+        if (t == BL_BOOT_TICKS && !stream) { prog = !line; }
+        if (stream) { prog = 0; }
+
+        res = isr(&r, line);
+        if (prog < 0) { continue; }
+        if (res < 0) { parity++; continue; }
+        if (res == 0) { continue; }
+
+        d = r.rxBuff;
+        bytes++;
+
+        if (!prog) {
+            fputc(d, o);
+            cols++;
+
+        // calibration and init sequence
+        } else if (p < EEPROM_BEGIN) {
+            if (autobaud && r.rxCal) { r.thr = r.rxSum >> 3; }
+            if (d == 0xAA) { p++; }
+
+        } else if (!framecheck) {
+            if (p < prof->eeprom) { ee[p++] = d; }
+            if (p > top) { top = p; }
+
+        // addr, len, data, crc8; a gap aborts the frame
+        } else {
+            if (last >= 0 && (t - last) * RX_TICK_US > COM_T_FRAME_GAP * 1000) { f = 0; }
+            frame[f++] = d;
+            if (f > 1 && (frame[1] > COM_FRAME_MAX || f == frame[1] + 3)) {
+                uint8_t crc = 0;
+                for (i=0; i<f; i++) { crc = crc8(crc, frame[i]); }
+                if (prof->eeprom > 255) {
+                    if (frame[0] < (uint8_t)addr) { addr += 0x100; }
+                    addr = (addr & 0xFF00) | frame[0];
+                } else {
+                    addr = frame[0];
+                }
+                if (!crc && frame[1] <= COM_FRAME_MAX && addr >= EEPROM_BEGIN && addr + frame[1] <= prof->eeprom) {
+                    memcpy(ee + addr, frame + 2, frame[1]);
+                    if (addr + frame[1] > top) { top = addr + frame[1]; }
+                    frames++;
+                } else {
+                    badframes++;
+                }
+                f = 0;
+            }
+        }
+        last = t;
+    }
+
+    if (prog > 0 && top > EEPROM_BEGIN) { fwrite(ee + EEPROM_BEGIN, 1, top - EEPROM_BEGIN, o); }
+    if (o != stdout) { fclose(o); }
+    free(s);
+
+    fprintf (stderr, "%.2f s, %s, %ld bytes, %ld parity errors", (double)n / rate,
+             prog < 0 ? "too short for the boot" : prog ? "PROG mode" : "SLAVE mode", bytes, parity);
+    if (prog > 0) {
+        fprintf (stderr, ", %d bytes to the eeprom", top > EEPROM_BEGIN ? top - EEPROM_BEGIN : 0);
+        if (framecheck) { fprintf (stderr, " (%ld frames, %ld broken)", frames, badframes); }
+    } else if (prog == 0) {
+        fprintf (stderr, ", %ld columns", cols);
+    }
+    fprintf (stderr, "\n");
+
+    return prog < 0 || (prog > 0 && p < EEPROM_BEGIN);
+}
@@ -0,0 +1,643 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "libblinken.h"
+#include "../firmware/comm.h"
+
+#define AUTHORS "Manuel Jerger"
+#define VERSION "0.1"
+
+#define TRUE ~(uint)0
+#define FALSE (uint)0
+
+
+/*
+ * blinkend : live text for a chain of blinken64 displays in SLAVE mode.
+ *
+ * Messages come in on a unix socket and/or a named pipe, one per line:
+ *
+ *      text <cleartext>        rendered w/ the firmware font, same escapes as
+ *                              textconv (\S \W \I \D \P, pictures from -p)
+ *      pic <file.pgm>          pgm/pbm, the top 8 rows, any width
+ *      cols <hex> <hex> ..     raw columns, bit 0 is the top row
+ *      stat                    queue and link state (socket only)
+ *
+ * The socket answers "ok <id>" when a message is queued, "done <id> <ms> <ms>"
+ * when its last column went out (latency of the first and the last column)
+ * and "err <reason>" otherwise.
+ *
+ * Columns are written to the programmer bridge (blinkenprog.pde, STREAM mode)
+ * at the speed of the message, the last message is repeated until the next
+ * one arrives (like MASTER mode does). While the queue is full no input is
+ * read, so writers block; the serial port is only written when it takes data
+ * (CTS on the bridge, tty buffer).
+ *
+ * A SLAVE w/o a column for COM_T_TIMEOUT goes back to MASTER and shows its
+ * eeprom: a wait (\W) longer than HOLDMAX repeats the column before it every
+ * HOLDMAX ms, the text moves on by one column then.
+ */
+
+#define MAXCOLS         (4096)      // columns per message
+#define MAXCLIENTS      (16)
+#define MAXLINE         (1024)
+#define MAXQUEUE        (64)
+#define HOLDMAX         (COM_T_TIMEOUT / 20 - 250)     // ms, below the SLAVE timeout (50 us ticks)
+
+#define spacing  1              // between chars
+
+const uint16_t waits[8] = { 50, 100, 250, 500, 1000, 1500, 2000, 5000}; // in ms, delay per wait symbol
+const uint8_t delays[8] = { 0, 5, 20, 32, 64, 96, 128, 255};            // in ms, delay per column
+
+
+char *program_name = "blinkend";
+
+char *device = "/dev/ttyUSB0", *sockpath, *fifopath, *picture;
+
+int quiet = TRUE, usepty = FALSE, once = FALSE;
+int queuemax = 16;          // messages waiting
+int gap = 8;                // blank columns after each message
+double rate = 100;          // max columns per second (link capacity)
+
+struct bl_pictures pics;    // pictures for \P, like textconv -p
+int havepics = FALSE;
+
+// one rendered message
+struct msg {
+    int id;
+    int client;             // fd to answer, -1: none
+    int len, pos;
+    uint8_t cols[MAXCOLS];
+    uint16_t hold[MAXCOLS]; // ms after the column
+    uint16_t step;          // ms per column at the end (for the gap)
+    double t_in, t_first;   // ms
+    int repeats;
+};
+
+struct msg *queue[MAXQUEUE];
+int qhead = 0, qlen = 0;
+struct msg *cur = NULL;     // on the wire
+int nextid = 1;
+
+// clients
+int lsock = -1, fifo = -1, ser = -1;
+int clients[MAXCLIENTS];
+char cbuf[MAXCLIENTS][MAXLINE];
+int clen[MAXCLIENTS];
+char fbuf[MAXLINE];
+int flen = 0;
+
+// statistics
+long sent = 0, done = 0;
+double latsum = 0, latmax = 0;
+
+volatile sig_atomic_t stop = 0;
+
+////////////////////////////////////////////////////////////////////////
+
+
+double now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+
+void reply (int fd, char *str) {
+    if (fd >= 0) {
+        if (write(fd, str, strlen(str)) < 0) { }    // client gone, never mind
+    }
+}
+
+
+// append one column
+void col (struct msg *m, uint8_t c, uint16_t hold) {
+    if (m->len < MAXCOLS) {
+        m->cols[m->len] = c;
+        m->hold[m->len] = hold;
+        m->len++;
+    }
+}
+
+
+// hold the last column ms longer, in steps of at most HOLDMAX
+void hold (struct msg *m, long ms) {
+    while (m->len && ms > 0) {
+        long h = HOLDMAX - m->hold[m->len-1];
+        if (h <= 0) {
+            if (m->len == MAXCOLS) { return; }
+            col(m, m->cols[m->len-1], 0);
+            continue;
+        }
+        if (h > ms) { h = ms; }
+        m->hold[m->len-1] += h;
+        ms -= h;
+    }
+}
+
+
+/*
+ * render cleartext like textconv + the MASTER loop of the firmware would:
+ * every char is followed by one empty column, every column held for the
+ * delay of the current speed
+ */
+int renderText (struct msg *m, char *s) {
+
+    int in[MAXLINE], n = bl_utf8(s, strlen(s), in, MAXLINE, NULL), i, j;
+    int speed = 4, inverted = 0, font = 0;
+    uint8_t chr[8];
+
+    for (i=0; i<n; i++) {
+        int c = in[i], width = 0, rows2do = 0;
+
+        // escapes, see textconv
+        if (c == '\\' && i+1 < n && in[i+1] != '\\') {
+            int cmd = in[++i], num = 0;
+            if (cmd != 'I' && cmd != 'H') {
+                if (i+1 >= n || in[i+1] < '1' || in[i+1] > '9') { return -1; }
+                num = in[++i] - '0';
+            }
+            switch (cmd) {
+                case 'I' :           c = INVERT; break;
+                case 'H' :           c = HALT; break;
+                case 'S' : case 's' : c = SPEED1 + num - 1;   if (num > 8) { return -1; } break;
+                case 'W' : case 'w' : c = WAIT1 + num - 1;    if (num > 8) { return -1; } break;
+                case 'P' : case 'p' : c = PICTURE1 + num - 1; if (num > 8 || !havepics) { return -1; } break;
+                case 'D' : case 'd' : c = SPACER1 + num - 1;  if (num > 2) { return -1; } break;
+                case 'F' : case 'f' : c = FONT_X;             if (num <= bl_fonts()) { font = num - 1; } break;
+                default : return -1;
+            }
+        } else if (c == '\\') {
+            i++;
+        } else if (c < SPACE) {
+            continue;
+        }
+
+        if (c <= SPEED8 && c >= SPEED1) {
+            speed = c - SPEED1;
+            m->step = delays[speed];
+        } else if (c == INVERT) {
+            inverted = ~inverted;
+        } else if (c == HALT) {
+            break;
+        } else if (c == FONT_X) {
+            continue;
+        } else if (c >= WAIT1 && c <= WAIT8) {
+            hold(m, waits[c - WAIT1]);
+        } else if (c >= PICTURE1 && c <= PICTURE8) {
+            width = 8; rows2do = 8;
+            memcpy(chr, pics.cols + (c-PICTURE1)*8, 8);
+        } else if (c >= SPACER1 && c <= SPACE) {
+            rows2do = c - 29;
+        } else if ((width = bl_font_glyph(font, c, chr)) > 0) {
+            rows2do = spacing + width;
+        }
+
+        for (j=0; j<rows2do; j++) {
+            col(m, (j < width ? chr[j] : 0) ^ inverted, delays[speed]);
+        }
+    }
+    return m->len;
+}
+
+
+/*
+ * read a pgm/pbm, the top 8 rows, one column per pixel (up to MAXCOLS).
+ * bright pixels are on, like textconv
+ */
+int readPgm (char *file, struct msg *m) {
+    struct bl_pnm img;
+    int x;
+
+    if (bl_pnm_read(file, &img) < 0) { return -1; }
+    if (img.height < 8) { bl_pnm_free(&img); return -1; }
+
+    m->len = img.width < MAXCOLS ? img.width : MAXCOLS;
+    bl_pnm_columns(&img, 0, 0, m->len, m->cols);
+    for (x=0; x<m->len; x++) { m->hold[x] = 0; }
+    bl_pnm_free(&img);
+    return m->len;
+}
+
+
+// parse one input line into a message, queue it. returns the id, or -1
+int submit (char *line, int client) {
+
+    struct msg *m;
+    char *arg = strchr(line, ' ');
+    int r = -1, i;
+
+    if (qlen >= queuemax) { reply(client, "err queue full\n"); return -1; }
+
+    if (arg) { *arg++ = 0; } else { arg = ""; }
+
+    m = calloc(1, sizeof(struct msg));
+    m->client = client;
+    m->t_in = now();
+    m->step = delays[4];
+
+    if (!strcmp(line, "text")) {
+        r = renderText(m, arg);
+    } else if (!strcmp(line, "pic")) {
+        r = readPgm(arg, m);
+        for (i=0; i<m->len; i++) { m->hold[i] = m->step; }
+    } else if (!strcmp(line, "cols")) {
+        char *e;
+        for (;;) {
+            long v = strtol(arg, &e, 16);
+            if (e == arg) { break; }
+            col(m, v, m->step);
+            arg = e;
+        }
+        r = *arg ? -1 : m->len;
+    }
+
+    if (r <= 0) {
+        reply(client, "err bad message\n");
+        free(m);
+        return -1;
+    }
+
+    for (i=0; i<gap; i++) { col(m, 0, m->step); }
+
+    m->id = nextid++;
+    queue[(qhead + qlen++) % MAXQUEUE] = m;
+
+    char s[32];
+    snprintf(s, sizeof(s), "ok %d\n", m->id);
+    reply(client, s);
+    return m->id;
+}
+
+
+// handle complete lines in buf, returns the bytes left; stops at a full
+// queue, the rest waits in buf (back-pressure, like the unread socket)
+int lines (char *buf, int len, int client) {
+    char *nl;
+    int used = 0;
+
+    while (qlen < queuemax && (nl = memchr(buf + used, '\n', len - used)) != NULL) {
+        *nl = 0;
+        char *line = buf + used;
+        used = nl - buf + 1;
+        if (nl > line && nl[-1] == '\r') { nl[-1] = 0; }
+        if (!*line) { continue; }
+
+        if (!strcmp(line, "stat")) {
+            char s[160];
+            snprintf(s, sizeof(s), "queue %d/%d, current %d, %ld columns sent, %ld messages done, latency mean %.1f ms max %.1f ms\n",
+                     qlen, queuemax, cur ? cur->id : 0, sent, done, done ? latsum / done : 0, latmax);
+            reply(client, s);
+        } else {
+            submit(line, client);
+        }
+    }
+    memmove(buf, buf + used, len - used);
+    return len - used;
+}
+
+
+// a client went away: its messages still go out, but nobody gets an answer
+void forget (int fd) {
+    int i;
+    for (i=0; i<qlen; i++) {
+        if (queue[(qhead + i) % MAXQUEUE]->client == fd) { queue[(qhead + i) % MAXQUEUE]->client = -1; }
+    }
+    if (cur && cur->client == fd) { cur->client = -1; }
+}
+
+
+// current message complete: report, take the next one (or repeat)
+void finished () {
+
+    if (!cur->repeats) {
+        double t = now(), lat = cur->t_first - cur->t_in;
+        char s[64];
+
+        done++;
+        latsum += lat;
+        if (lat > latmax) { latmax = lat; }
+        snprintf(s, sizeof(s), "done %d %.1f %.1f\n", cur->id, lat, t - cur->t_in);
+        reply(cur->client, s);
+        if (!quiet) {
+            fprintf(stdout, "msg %d: %d columns, first column after %.1f ms, last after %.1f ms\n",
+                    cur->id, cur->len, lat, t - cur->t_in);
+        }
+    }
+
+    if (qlen) {
+        free(cur);
+        cur = queue[qhead];
+        qhead = (qhead + 1) % MAXQUEUE;
+        qlen--;
+    } else if (once) {
+        free(cur);
+        cur = NULL;
+    } else {
+        cur->repeats++;
+    }
+    if (cur) { cur->pos = 0; }
+}
+
+
+void openSerial () {
+
+    struct termios t;
+
+    if (usepty) {
+        ser = posix_openpt(O_RDWR | O_NOCTTY);
+        if (ser < 0 || grantpt(ser) || unlockpt(ser)) {
+            fprintf(stderr, "%s: can not create pty\n", program_name);
+            exit(EXIT_FAILURE);
+        }
+        device = ptsname(ser);
+        // keep the slave open, so nothing is lost while no reader is attached
+        int slave = open(device, O_RDWR | O_NOCTTY);
+        if (slave >= 0 && !tcgetattr(slave, &t)) {
+            cfmakeraw(&t);
+            tcsetattr(slave, TCSANOW, &t);
+        }
+        fprintf(stdout, "%s: pty stand-in for the bridge is %s\n", program_name, device);
+        fflush(stdout);
+    } else {
+        ser = open(device, O_RDWR | O_NOCTTY);
+        if (ser < 0) {
+            fprintf(stderr, "%s: can not open %s\n", program_name, device);
+            exit(EXIT_FAILURE);
+        }
+        // 115200 8N1, raw, hardware flow control (CTS of blinkenprog.pde)
+        if (!tcgetattr(ser, &t)) {
+            cfmakeraw(&t);
+            cfsetispeed(&t, B115200);
+            cfsetospeed(&t, B115200);
+            t.c_cflag |= CRTSCTS | CLOCAL | CREAD;
+            tcsetattr(ser, TCSANOW, &t);
+        }
+    }
+    fcntl(ser, F_SETFL, fcntl(ser, F_GETFL) | O_NONBLOCK);
+}
+
+
+void openInputs () {
+
+    if (sockpath) {
+        struct sockaddr_un a;
+        memset(&a, 0, sizeof(a));
+        a.sun_family = AF_UNIX;
+        strncpy(a.sun_path, sockpath, sizeof(a.sun_path) - 1);
+        unlink(sockpath);
+        lsock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (lsock < 0 || bind(lsock, (struct sockaddr *)&a, sizeof(a)) || listen(lsock, 4)) {
+            fprintf(stderr, "%s: can not listen on %s\n", program_name, sockpath);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (fifopath) {
+        mkfifo(fifopath, 0666);
+        // rdwr: no EOF when the last writer closes
+        fifo = open(fifopath, O_RDWR | O_NONBLOCK);
+        if (fifo < 0) {
+            fprintf(stderr, "%s: can not open %s\n", program_name, fifopath);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+
+void quit (int sig) { (void)sig; stop = 1; }
+
+
+
+////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+
+    program_name = argv[0];
+
+    // while args left..
+    int a = 1; int last_a = 1;
+    do {
+        last_a = a;
+        // two args
+        if (a+1 < argc) {
+
+            // serial port of the bridge
+            if (!strcmp (argv[a], "-d")) {
+                device = argv[a+1];
+                a += 2;
+
+            // unix socket
+            } else if (!strcmp (argv[a], "-s")) {
+                sockpath = argv[a+1];
+                a += 2;
+
+            // named pipe
+            } else if (!strcmp (argv[a], "-f")) {
+                fifopath = argv[a+1];
+                a += 2;
+
+            // eeprom pictures (64x8 pixel pgm), like textconv
+            } else if (!strcmp (argv[a], "-p")) {
+                picture = argv[a+1];
+                a += 2;
+
+            // queue length
+            } else if (!strcmp (argv[a], "-q")) {
+                queuemax = atoi(argv[a+1]);
+                a += 2;
+
+            // empty columns between messages
+            } else if (!strcmp (argv[a], "-g")) {
+                gap = atoi(argv[a+1]);
+                a += 2;
+
+            // max column rate
+            } else if (!strcmp (argv[a], "-r")) {
+                rate = atof(argv[a+1]);
+                a += 2;
+            }
+        }
+
+        // one arg (a may have changed)
+        if (a < argc) {
+
+            // create a pty instead of opening the serial port
+            if (!strcmp (argv[a], "--pty")) {
+                usepty = TRUE;
+                a++;
+
+            // show every message once, then let the chain fall back to MASTER
+            } else if (!strcmp (argv[a], "--once")) {
+                once = TRUE;
+                a++;
+
+            // verbose
+            } else if (!strcmp (argv[a], "--verbose")) {
+                quiet = FALSE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--help")) {
+                fprintf (stdout, "\nStream text, pictures and columns to a chain of blinken64 displays in SLAVE mode.\n");
+                fprintf (stdout, "\nUsage: %s [-d device | --pty] [-s socket] [-f fifo] [-p picture] [-q n] [-g n] [-r n] [--once] [--verbose]\n", program_name);
+                fprintf (stdout, "\n    -d device        serial port of blinkenprog in STREAM mode (default %s)", device);
+                fprintf (stdout, "\n    -s socket        accept messages on this unix socket");
+                fprintf (stdout, "\n    -f fifo          accept messages on this named pipe");
+                fprintf (stdout, "\n    -p picture       pictures for \\P1..\\P8 (64x8 pixel pgm), like textconv");
+                fprintf (stdout, "\n    -q n             max messages waiting (default %d)", queuemax);
+                fprintf (stdout, "\n    -g n             empty columns after each message (default %d)", gap);
+                fprintf (stdout, "\n    -r n             max columns per second, below the link capacity (default %.0f)", rate);
+                fprintf (stdout, "\n   --pty             write to a new pty instead of a serial port (testing)");
+                fprintf (stdout, "\n   --once            do not repeat the last message");
+                fprintf (stdout, "\n   --verbose         print a line per message w/ its latency\n");
+                fprintf (stdout, "\nMessages, one per line: 'text <cleartext>', 'pic <file.pgm>', 'cols <hex> ..', 'stat'\n\n");
+
+                exit (EXIT_SUCCESS);
+            }
+        }
+
+    } while ( (a < argc) && (a != last_a) );
+
+    if (!sockpath && !fifopath) {
+        fprintf (stderr, "%s: need -s and/or -f, see --help\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+    if (queuemax < 1 || queuemax > MAXQUEUE) { queuemax = MAXQUEUE; }
+    if (rate <= 0) { rate = 100; }
+    if (rate * HOLDMAX < 1000) { rate = 1000.0 / HOLDMAX; }     // a column at least every HOLDMAX
+
+    if (picture) {
+        if (bl_read_pictures(picture, &pics) < 0) {
+            fprintf (stderr, "%s: %s is no 8 pixel high pgm/pbm\n", program_name, picture);
+            exit (EXIT_FAILURE);
+        }
+        havepics = TRUE;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, quit);
+    signal(SIGTERM, quit);
+
+    openSerial();
+    openInputs();
+
+    int i;
+    for (i=0; i<MAXCLIENTS; i++) { clients[i] = -1; }
+
+    double due = now();             // next column
+    int blocked = FALSE;            // serial did not take the last column
+
+    while (!stop) {
+
+        struct pollfd p[MAXCLIENTS + 3];
+        int np = 0, full;
+        int tmo = -1;
+
+        // nothing on the wire: start the next message
+        if (!cur && qlen) {
+            cur = queue[qhead];
+            qhead = (qhead + 1) % MAXQUEUE;
+            qlen--;
+            cur->pos = 0;
+        }
+
+        // lines read before the queue ran full
+        full = qlen >= queuemax;
+        for (i=0; i<MAXCLIENTS && !full; i++) {
+            if (clients[i] >= 0 && clen[i]) { clen[i] = lines(cbuf[i], clen[i], clients[i]); full = qlen >= queuemax; }
+        }
+        if (flen && !full) { flen = lines(fbuf, flen, -1); full = qlen >= queuemax; }
+
+        // back-pressure: no input while the queue is full
+        if (lsock >= 0 && !full) { p[np].fd = lsock; p[np++].events = POLLIN; }
+        if (fifo >= 0 && !full)  { p[np].fd = fifo;  p[np++].events = POLLIN; }
+        for (i=0; i<MAXCLIENTS; i++) {
+            if (clients[i] >= 0 && !full) { p[np].fd = clients[i]; p[np++].events = POLLIN; }
+        }
+        if (cur) {
+            if (blocked) {
+                p[np].fd = ser; p[np++].events = POLLOUT;
+            } else {
+                tmo = due - now();
+                if (tmo < 0) { tmo = 0; }
+            }
+        }
+
+        if (poll(p, np, tmo) < 0) { continue; }
+
+        // inputs
+        for (i=0; i<np; i++) {
+            if (!(p[i].revents & (POLLIN | POLLHUP | POLLERR))) { continue; }
+
+            if (p[i].fd == lsock) {
+                int c = accept(lsock, NULL, NULL), k;
+                for (k=0; k<MAXCLIENTS && clients[k] >= 0; k++) {}
+                if (k == MAXCLIENTS) { reply(c, "err too many clients\n"); close(c); continue; }
+                clients[k] = c;
+                clen[k] = 0;
+
+            } else if (p[i].fd == fifo) {
+                int n = read(fifo, fbuf + flen, sizeof(fbuf) - flen - 1);
+                if (n > 0) { flen = lines(fbuf, flen + n, -1); }
+                if (flen == sizeof(fbuf) - 1 && !memchr(fbuf, '\n', flen)) { flen = 0; }     // overlong line
+
+            } else if (p[i].fd != ser) {
+                int k;
+                for (k=0; k<MAXCLIENTS && clients[k] != p[i].fd; k++) {}
+                if (k == MAXCLIENTS) { continue; }
+                int n = read(clients[k], cbuf[k] + clen[k], MAXLINE - clen[k] - 1);
+                if (n <= 0) {
+                    forget(clients[k]);
+                    close(clients[k]);
+                    clients[k] = -1;
+                    continue;
+                }
+                clen[k] = lines(cbuf[k], clen[k] + n, clients[k]);
+                if (clen[k] == MAXLINE - 1 && !memchr(cbuf[k], '\n', clen[k])) { reply(clients[k], "err line too long\n"); clen[k] = 0; }
+            }
+        }
+
+        // next column
+        if (cur && now() >= due) {
+            uint8_t c = cur->cols[cur->pos];
+            int n = write(ser, &c, 1);
+
+            if (n == 1) {
+                blocked = FALSE;
+                if (!cur->pos && !cur->repeats) { cur->t_first = now(); }
+                sent++;
+                due = now() + cur->hold[cur->pos];
+                if (cur->hold[cur->pos] < 1000 / rate) { due = now() + 1000 / rate; }
+                if (++cur->pos == cur->len) { finished(); }
+            } else if (n < 0 && errno == EAGAIN) {
+                blocked = TRUE;     // bridge busy, wait until the port takes data
+            } else {
+                fprintf (stderr, "%s: write to %s failed\n", program_name, device);
+                break;
+            }
+        }
+    }
+
+    if (done) {
+        fprintf (stdout, "%ld messages, %ld columns, latency to the first column: mean %.1f ms, max %.1f ms\n",
+                 done, sent, latsum / done, latmax);
+    }
+    if (sockpath) { unlink(sockpath); }
+
+    exit (EXIT_SUCCESS);
+}
+
@@ -0,0 +1,702 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
+
+#include "libblinken.h"
+
+#define AUTHORS "Manuel Jerger"
+#define VERSION "0.1"
+
+#define TRUE ~(uint)0
+#define FALSE (uint)0
+
+
+/*
+ * blinkenplay : plays an eeprom image on the PC, as fast as it can compute
+ * it. The MASTER loop of the firmware runs on the player of libblinken, with
+ * the timing of the badge (ISR ticks, 2ms "ms" counter, transmit() between
+ * the columns), so a whole playlist of hours renders in milliseconds.
+ *
+ * The frames go to
+ *
+ *      --gif file      animated gif, frame delays in 1/100 s (frames shorter
+ *                      than 20ms are merged into the next one, like browsers
+ *                      would show them anyway)
+ *      --pgm dir       one P5 pgm per frame + dir/frames.txt (file, time, hold)
+ *      --trace file    "<t_us> <hold_us> <msg> <buff[7]..buff[0] hex>" per frame
+ *      --golden file   a --trace of the same image: same frames at the same
+ *                      time? prints one line w/ the deviation and the render
+ *                      speed (frames/s, ns and cpu cycles per eeprom byte
+ *                      read, time on the badge per byte) instead of the
+ *                      summary, exits w/ 1 on a difference (make bench)
+ *      --ansi          the display on the terminal, in real time (-x: faster)
+ *      --shm name      the virtual display (shared memory ring, see
+ *                      libblinken.h and blinkenview), in real time too
+ *
+ * and a summary of the messages to stdout.
+ */
+
+#define MAXFRAMES       (1 << 20)   // frames kept for the outputs
+#define MAXMSG          (256)
+
+
+char *program_name = "blinkenplay";
+
+char *input, *textfile, *picture;
+char *gifout, *pgmdir, *traceout, *shmname, *golden;
+
+int quiet = TRUE, useansi = FALSE;
+int loops = 1;              // passes per message
+double hold = 2;            // s on a HALT
+double limit = 600;         // s of playlist at most (messages that loop forever)
+double factor = 1;          // --ansi/--shm: speed, 0: no waiting
+int scale = 8;              // pixels per led
+double tolerance = 0;       // us a frame may be off the golden trace
+
+const struct bl_profile *prof;
+struct bl_player pl, pl0;   // pl0: before the first frame
+
+struct bl_frame *frames;
+int nframes;
+int64_t end;                // tick the playlist ends
+
+void readImage (void);
+void readText (void);
+void play (void);
+void summary (double);
+int bench (void);
+void writeTrace (void);
+void writePgm (void);
+void writeGif (void);
+void show (void);
+
+void info(char *);
+
+
+////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+
+    program_name = argv[0];
+    prof = bl_profile(NULL);
+
+    // while args left..
+    int a = 1; int last_a = 1, i;
+    do {
+        last_a = a;
+        // two args
+        if (a+1 < argc) {
+
+            // eeprom image (textconv output)
+            if (!strcmp (argv[a], "-i")) {
+                input = argv[a+1];
+                a += 2;
+
+            // cleartext, converted like textconv does
+            } else if (!strcmp (argv[a], "-t")) {
+                textfile = argv[a+1];
+                a += 2;
+
+            // eeprom pictures for -t
+            } else if (!strcmp (argv[a], "-p")) {
+                picture = argv[a+1];
+                a += 2;
+
+            // passes per message
+            } else if (!strcmp (argv[a], "-n")) {
+                loops = atoi(argv[a+1]);
+                a += 2;
+
+            // halt: time until the button is pressed
+            } else if (!strcmp (argv[a], "-H")) {
+                hold = atof(argv[a+1]);
+                a += 2;
+
+            // max playlist length
+            } else if (!strcmp (argv[a], "-T")) {
+                limit = atof(argv[a+1]);
+                a += 2;
+
+            // ansi/shm: speed
+            } else if (!strcmp (argv[a], "-x")) {
+                factor = atof(argv[a+1]);
+                a += 2;
+
+            // gif/pgm: pixels per led
+            } else if (!strcmp (argv[a], "-s")) {
+                scale = atoi(argv[a+1]);
+                a += 2;
+
+            } else if (!strcmp (argv[a], "--gif")) {
+                gifout = argv[a+1];
+                a += 2;
+
+            } else if (!strcmp (argv[a], "--pgm")) {
+                pgmdir = argv[a+1];
+                a += 2;
+
+            } else if (!strcmp (argv[a], "--trace")) {
+                traceout = argv[a+1];
+                a += 2;
+
+            // compare w/ a trace
+            } else if (!strcmp (argv[a], "--golden")) {
+                golden = argv[a+1];
+                a += 2;
+
+            } else if (!strcmp (argv[a], "--tolerance")) {
+                tolerance = atof(argv[a+1]);
+                a += 2;
+
+            // virtual display
+            } else if (!strcmp (argv[a], "--shm")) {
+                shmname = argv[a+1];
+                a += 2;
+
+            // device profile
+            } else if (!strcmp (argv[a], "--profile")) {
+                prof = bl_profile(argv[a+1]);
+                if (prof == NULL) {
+                    fprintf (stderr, "%s: unknown profile %s, see --help\n", program_name, argv[a+1]);
+                    exit (EXIT_FAILURE);
+                }
+                a += 2;
+            }
+
+        }
+
+        // one arg (a may have changed)
+        if (a < argc) {
+
+            if (!strcmp (argv[a], "--ansi")) {
+                useansi = TRUE;
+                a++;
+
+            // verbose
+            } else if (!strcmp (argv[a], "--verbose")) {
+                quiet = FALSE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--help")) {
+                fprintf (stdout, "\nPlay a blinken64 eeprom image on the PC, fast forward.\n");
+                fprintf (stdout, "\nUsage: %s (-i image | -t text [-p picture]) [--profile name] [-n loops] [-H s] [-T s]\n", program_name);
+                fprintf (stdout, "                  [--gif file] [--pgm dir] [--trace file] [-s scale] [--ansi] [--shm name] [-x factor]\n");
+                fprintf (stdout, "                  [--golden trace [--tolerance us]]\n");
+                fprintf (stdout, "\n    -i image         eeprom image from textconv (binary or --hex, w/ or w/o --ee)");
+                fprintf (stdout, "\n    -t text          cleartext, converted like textconv does");
+                fprintf (stdout, "\n    -p picture       eeprom pictures for -t (8 pixel high pgm)");
+                fprintf (stdout, "\n   --profile name    device profile (default %s):", bl_profile(NULL)->name);
+                for (i=0; bl_profile_list(i); i++) {
+                    const struct bl_profile *p = bl_profile_list(i);
+                    fprintf (stdout, "\n                       %-12s %4d byte eeprom, %2d pictures", p->name, p->eeprom, p->pictures);
+                }
+                fprintf (stdout, "\n    -n loops         passes per message before the button is pressed (default %d, 0: never)", loops);
+                fprintf (stdout, "\n    -H s             button pressed this long after a halt (default %g, 0: never)", hold);
+                fprintf (stdout, "\n    -T s             stop after s seconds of playlist (default %g)", limit);
+                fprintf (stdout, "\n   --gif file        animated gif");
+                fprintf (stdout, "\n   --pgm dir         one pgm per frame, list in dir/frames.txt");
+                fprintf (stdout, "\n   --trace file      frame times and display contents, one line per frame");
+                fprintf (stdout, "\n    -s scale         gif/pgm: pixels per led (default %d)", scale);
+                fprintf (stdout, "\n   --golden trace    compare w/ a --trace, one line of deviation and speed instead of the summary");
+                fprintf (stdout, "\n   --tolerance us    --golden: max time deviation of a frame (default %g)", tolerance);
+                fprintf (stdout, "\n   --ansi            show it on the terminal, in real time");
+                fprintf (stdout, "\n   --shm name        publish the frames on the virtual display name, in real time");
+                fprintf (stdout, "\n    -x factor        --ansi/--shm: faster (default %g, 0: as fast as possible)", factor);
+                fprintf (stdout, "\n   --verbose         print log on stdout\n\n");
+
+                exit (EXIT_SUCCESS);
+            }
+        }
+
+    } while ( (a < argc) && (a != last_a) );
+
+    if ((input == NULL) == (textfile == NULL)) {
+        fprintf (stderr, "%s: need an image (-i) or a text (-t), see --help\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+    if (scale < 1) { scale = 1; }
+
+    if (input != NULL) {
+        readImage();
+    } else {
+        readText();
+    }
+    pl.loops = loops;
+    pl.hold = hold * 1000000 / BL_TICK_US;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    play();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (golden != NULL) {
+        if (bench()) { exit (EXIT_FAILURE); }
+    } else {
+        summary((t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    }
+
+    if (traceout != NULL) { writeTrace(); }
+    if (pgmdir != NULL) { writePgm(); }
+    if (gifout != NULL) { writeGif(); }
+    if (useansi || shmname != NULL) { show(); }
+
+    exit (EXIT_SUCCESS);
+}
+
+
+void info (char * str) {
+    if (!quiet) {
+        fprintf(stdout,"\n%s",str);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+void readImage () {
+
+    uint8_t img[BL_MAXEEPROM];
+    int n;
+
+    info ("reading eeprom image");
+
+    n = bl_read_image(input, img, sizeof(img));
+    if (n < 0) {
+        fprintf (stderr, "%s: can not open %s\n", program_name, input);
+        exit (EXIT_FAILURE);
+    }
+    if (n > prof->eeprom) {
+        fprintf (stderr, "%s: %s is larger than the eeprom of %s, see --profile\n", program_name, input, prof->name);
+        exit (EXIT_FAILURE);
+    }
+    bl_player_init(&pl, img, n, prof);
+}
+
+
+void readText () {
+
+    static char text[BL_MAXINPUT];
+    static struct bl_pictures pics;
+    static struct bl_image img;
+    FILE *f;
+    int len;
+
+    info ("converting text");
+
+    if (picture != NULL && bl_read_pictures(picture, &pics) < 0) {
+        fprintf (stderr, "%s: %s is no pgm/pbm of at least 8 rows\n", program_name, picture);
+        exit (EXIT_FAILURE);
+    }
+
+    f = fopen(textfile, "r");
+    if (f == NULL) {
+        fprintf (stderr, "%s: can not open %s\n", program_name, textfile);
+        exit (EXIT_FAILURE);
+    }
+    len = fread(text, 1, sizeof(text), f);
+    fclose(f);
+
+    if (bl_convert(text, len, &pics, prof, BL_EE, &img)) {
+        fprintf (stderr, "%s: %s does not fit in the eeprom of %s\n", program_name, textfile, prof->name);
+        exit (EXIT_FAILURE);
+    }
+    bl_player_init(&pl, img.data, img.size, prof);
+}
+
+
+// all frames up to the end of the playlist (or the limit)
+void play () {
+
+    int64_t last = BL_BOOT_TICKS + limit * 1000000 / BL_TICK_US;
+
+    info ("playing");
+    pl0 = pl;
+
+    frames = malloc(MAXFRAMES * sizeof(*frames));
+    if (frames == NULL) {
+        fprintf (stderr, "%s: out of memory\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+
+    while (nframes < MAXFRAMES && bl_player_next(&pl, &frames[nframes])) {
+        if (frames[nframes].tick > last) { pl.tick = last; break; }
+        nframes++;
+    }
+    end = pl.tick;
+    if (!pl.done) {
+        fprintf (stderr, "%s: playlist cut after %.1f s / %d frames\n", program_name,
+                 (double)(end - BL_BOOT_TICKS) * BL_TICK_US / 1e6, nframes);
+    }
+}
+
+
+// s since power on
+double sec (int64_t tick) { return (double)tick * BL_TICK_US / 1e6; }
+
+// how long frame i is shown
+int64_t holdOf (int i) { return (i+1 < nframes ? frames[i+1].tick : end) - frames[i].tick; }
+
+
+void summary (double took) {
+
+    int first[MAXMSG], count[MAXMSG], i, m, nmsg = 0;
+
+    for (i=0; i<nframes; i++) {
+        m = frames[i].msg;
+        if (m >= MAXMSG) { continue; }
+        while (nmsg <= m) { count[nmsg] = 0; first[nmsg++] = i; }
+        count[m]++;
+    }
+
+    fprintf (stdout, "%s, %d frames, %d messages\n", prof->name, nframes, nmsg);
+    for (m=0; m<nmsg; m++) {
+        if (count[m] == 0) {
+            fprintf (stdout, "  msg %3d  no columns\n", m);
+            continue;
+        }
+        i = first[m] + count[m] - 1;
+        fprintf (stdout, "  msg %3d  %6d columns  at %8.3f s  for %8.3f s\n", m, count[m],
+                 sec(frames[first[m]].tick), sec(frames[i].tick + holdOf(i) - frames[first[m]].tick));
+    }
+    fprintf (stdout, "playlist %.3f s (after %.3f s boot), rendered in %.3f ms, %.0fx real time\n",
+             sec(end - BL_BOOT_TICKS), sec(BL_BOOT_TICKS), took * 1000,
+             took > 0 ? sec(end - BL_BOOT_TICKS) / took : 0);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// make bench
+
+#define BENCH_NS        (200000000)     // render for at least that long
+
+uint64_t cycles () {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+
+/*
+ * frames against the golden trace: same count, same display and message,
+ * time within the tolerance. then the playlist again and again from the
+ * start, for the render speed. returns the number of frames that differ
+ */
+int bench () {
+
+    struct bl_player p;
+    struct bl_frame fr;
+    struct timespec t0, t1;
+    char line[256], hex[17], own[17], *name;
+    long long t, h, dev, devmax = 0, devsum = 0;
+    long rendered = 0, chars = 0;
+    int64_t last = BL_BOOT_TICKS + limit * 1000000 / BL_TICK_US;
+    int msg, i = 0, j, bad = 0, first = -1, len;
+    double ns;
+    uint64_t c0, c1;
+    FILE *f;
+
+    f = fopen(golden, "r");
+    if (f == NULL) {
+        fprintf (stderr, "%s: can not open %s\n", program_name, golden);
+        exit (EXIT_FAILURE);
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "%lld %lld %d %16s", &t, &h, &msg, hex) != 4) { continue; }
+        if (i < nframes) {
+            for (j=0; j<8; j++) { sprintf(own + 2*j, "%02x", frames[i].buff[7-j]); }
+            dev = t - (long long)frames[i].tick * BL_TICK_US;
+            if (dev < 0) { dev = -dev; }
+            devsum += dev;
+            if (dev > devmax) { devmax = dev; }
+            if (strcmp(own, hex) || msg != frames[i].msg || dev > tolerance) {
+                if (first < 0) { first = i; }
+                bad++;
+            }
+        }
+        i++;
+    }
+    fclose(f);
+    if (i != nframes) {
+        if (first < 0) { first = i < nframes ? i : nframes; }
+        bad += i > nframes ? i - nframes : nframes - i;
+    }
+
+    // render speed: w/o the outputs, just the player
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    c0 = cycles();
+    do {
+        p = pl0;
+        while (bl_player_next(&p, &fr) && fr.tick <= last) { rendered++; }
+        chars += p.chars;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    } while (ns < BENCH_NS);
+    c1 = cycles();
+
+    // name of the trace w/o directory and extension
+    name = strrchr(golden, '/') ? strrchr(golden, '/') + 1 : golden;
+    len = strchr(name, '.') ? strchr(name, '.') - name : (int)strlen(name);
+
+    fprintf (stdout, "%-14.*s %7d  %-4s %9.1f %9lld %11.0f %9.1f %9.0f %9.2f\n", len, name,
+             nframes, bad ? "FAIL" : "ok", nframes ? (double)devsum / nframes : 0, devmax,
+             rendered / ns * 1e9, ns / chars, (double)(c1 - c0) / chars,
+             pl.chars ? sec(end - BL_BOOT_TICKS) * 1000 / pl.chars : 0);
+
+    if (bad) {
+        fprintf (stderr, "%s: %s: %d frames differ, the first is frame %d\n", program_name, golden, bad, first);
+    }
+    return bad;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+FILE *create (char *file) {
+    FILE *f = fopen(file, "w");
+    if (f == NULL) {
+        fprintf (stderr, "%s: can not write %s\n", program_name, file);
+        exit (EXIT_FAILURE);
+    }
+    return f;
+}
+
+
+void writeTrace () {
+
+    FILE *f = create(traceout);
+    int i, j;
+
+    info ("writing trace");
+
+    for (i=0; i<nframes; i++) {
+        fprintf (f, "%lld %lld %d ", (long long)frames[i].tick * BL_TICK_US,
+                 (long long)holdOf(i) * BL_TICK_US, frames[i].msg);
+        for (j=7; j>=0; j--) { fprintf (f, "%02x", frames[i].buff[j]); }
+        fprintf (f, "\n");
+    }
+    fclose(f);
+}
+
+
+// leds as scale x scale cells w/ a gap: 0 background, 1 led off, 2 led on
+void raster (struct bl_frame *fr, uint8_t *pix) {
+    int w = 8 * scale, x, y, gap = scale > 2;
+
+    for (y=0; y<w; y++) {
+        for (x=0; x<w; x++) {
+            int col = 7 - x / scale, row = y / scale;
+            if (gap && (x % scale == scale-1 || y % scale == scale-1)) {
+                pix[y*w + x] = 0;
+            } else {
+                pix[y*w + x] = (fr->buff[col] >> row) & 1 ? 2 : 1;
+            }
+        }
+    }
+}
+
+
+void writePgm () {
+
+    static const uint8_t grey[3] = { 0, 40, 255 };
+    int w = 8 * scale, i, p;
+    uint8_t *pix = malloc(w * w);
+    char name[4096];
+    FILE *f, *l;
+
+    info ("writing pgm frames");
+
+    mkdir(pgmdir, 0777);
+    snprintf(name, sizeof(name), "%s/frames.txt", pgmdir);
+    l = create(name);
+
+    for (i=0; i<nframes; i++) {
+        snprintf(name, sizeof(name), "%s/%06d.pgm", pgmdir, i);
+        f = create(name);
+        raster(&frames[i], pix);
+        fprintf (f, "P5\n%d %d\n255\n", w, w);
+        for (p=0; p<w*w; p++) { fputc(grey[pix[p]], f); }
+        fclose(f);
+        fprintf (l, "%06d.pgm %.3f %.3f\n", i, sec(frames[i].tick) * 1000, sec(holdOf(i)) * 1000);
+    }
+    fclose(l);
+    free(pix);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// gif: 4 colours, lzw w/ variable code size (GIF89a spec, appendix F)
+
+struct lzw {
+    FILE *f;
+    uint8_t block[256];
+    int nblock;
+    uint32_t bits;
+    int nbits;
+};
+
+void putByte (struct lzw *z, uint8_t b) {
+    z->block[++z->nblock] = b;
+    if (z->nblock == 255) {
+        z->block[0] = 255;
+        fwrite(z->block, 1, 256, z->f);
+        z->nblock = 0;
+    }
+}
+
+void putCode (struct lzw *z, int code, int size) {
+    z->bits |= (uint32_t)code << z->nbits;
+    z->nbits += size;
+    while (z->nbits >= 8) {
+        putByte(z, z->bits & 0xff);
+        z->bits >>= 8;
+        z->nbits -= 8;
+    }
+}
+
+
+void lzwFrame (FILE *f, uint8_t *pix, int n) {
+
+    static int16_t next[4096][4];    // code of prefix + pixel, 0: none
+    struct lzw z = { .f = f };
+    int clear = 4, eoi = 5, nkeys, size, key, codes, i;
+
+    fputc(2, f);                    // min code size
+
+    memset(next, 0, sizeof(next));
+    nkeys = clear + 2; size = 3; codes = 0;
+    putCode(&z, clear, size);
+
+    key = pix[0];
+    for (i=1; i<n; i++) {
+        if (next[key][pix[i]]) {
+            key = next[key][pix[i]];
+            continue;
+        }
+        putCode(&z, key, size);
+        codes++;
+        if (nkeys < 4096) {
+            if (nkeys == (1 << size)) { size++; }
+            next[key][pix[i]] = nkeys++;
+        } else {
+            putCode(&z, clear, size);
+            memset(next, 0, sizeof(next));
+            nkeys = clear + 2; size = 3; codes = 0;
+        }
+        key = pix[i];
+    }
+    putCode(&z, key, size);
+    // the decoder adds an entry for the last code too
+    if (codes && nkeys == (1 << size) && size < 12) { size++; }
+    putCode(&z, eoi, size);
+    if (z.nbits) { putByte(&z, z.bits); }
+    if (z.nblock) {
+        z.block[0] = z.nblock;
+        fwrite(z.block, 1, z.nblock + 1, f);
+    }
+    fputc(0, f);                    // block terminator
+}
+
+
+void gifFrame (FILE *f, uint8_t *pix, int w, int cs) {
+    // graphic control extension: delay
+    uint8_t gce[8] = { 0x21, 0xf9, 4, 0, cs & 0xff, cs >> 8, 0, 0 };
+    // image descriptor: whole screen, global palette
+    uint8_t desc[10] = { 0x2c, 0, 0, 0, 0, w & 0xff, w >> 8, w & 0xff, w >> 8, 0 };
+
+    fwrite(gce, 1, sizeof(gce), f);
+    fwrite(desc, 1, sizeof(desc), f);
+    lzwFrame(f, pix, w * w);
+}
+
+
+void writeGif () {
+
+    int w = 8 * scale, i, t;
+    int64_t start;
+    uint8_t *pix = malloc(w * w);
+    FILE *f = create(gifout);
+
+    // header, screen of w x w w/ a global palette of 4
+    uint8_t head[13] = { 'G','I','F','8','9','a', w & 0xff, w >> 8, w & 0xff, w >> 8, 0xf1, 0, 0 };
+    uint8_t palette[12] = { 0x10,0x10,0x10,  0x40,0x08,0x08,  0xff,0x20,0x10,  0,0,0 };
+    // loop forever
+    uint8_t loop[19] = { 0x21, 0xff, 11, 'N','E','T','S','C','A','P','E','2','.','0', 3, 1, 0, 0, 0 };
+
+    info ("writing gif");
+
+    fwrite(head, 1, sizeof(head), f);
+    fwrite(palette, 1, sizeof(palette), f);
+    fwrite(loop, 1, sizeof(loop), f);
+
+    // in 1/100 s, from the first frame. a frame is shown until the next one
+    // that is at least 2/100 s later, those in between are dropped
+    for (i=0; i<nframes; i=t) {
+        start = frames[i].tick / 200;
+        for (t=i+1; t<nframes && frames[t].tick / 200 - start < 2; t++) { }
+        raster(&frames[t-1], pix);
+        gifFrame(f, pix, w, (t < nframes ? frames[t].tick : end) / 200 - start);
+    }
+
+    fputc(0x3b, f);
+    fclose(f);
+    free(pix);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+// the frames at the time they are due: on the terminal and/or the virtual display
+void show () {
+
+    struct bl_display *d = NULL;
+    struct timespec ts;
+    int i, x, y;
+
+    if (shmname != NULL) {
+        d = bl_display_create(shmname, 8, 256);
+        if (d == NULL) {
+            fprintf (stderr, "%s: can not create the virtual display %s: %s\n", program_name, shmname, strerror(errno));
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    for (i=0; i<nframes; i++) {
+        if (d != NULL) {
+            bl_display_publish(d, frames[i].buff, frames[i].tick, frames[i].msg);
+        }
+
+        if (useansi) {
+            for (y=0; y<8; y++) {
+                for (x=7; x>=0; x--) {
+                    fputs ((frames[i].buff[x] >> y) & 1 ? "\033[1;31mO\033[0m " : "\033[2m.\033[0m ", stdout);
+                }
+                fputs ("\n", stdout);
+            }
+            fprintf (stdout, "msg %d  %.3f s\n", frames[i].msg, sec(frames[i].tick));
+            fflush(stdout);
+        }
+
+        if (factor > 0) {
+            double s = sec(holdOf(i)) / factor;
+            ts.tv_sec = s;
+            ts.tv_nsec = (s - ts.tv_sec) * 1e9;
+            nanosleep(&ts, NULL);
+        }
+        if (useansi && i+1 < nframes) { fputs ("\033[9A", stdout); }
+    }
+
+    bl_display_close(d);
+}
@@ -1,4 +1,25 @@
-#define outPin   10
+/*
+ * blinkenprog : serial -> blinken64 programmer and streaming bridge (arduino)
+ *
+ *  - serial input goes into a ring buffer, ctsPin tells the host to pause
+ *    while it is almost full (hardware flow control, e.g. FTDI cable w/ CTS)
+ *  - pulses come from timer 1: outPin is OC1B and toggled by the hardware on
+ *    compare match, the ISR only sets up the next edge -> no jitter
+ *  - PROG mode (default): the line is low while idle, so displays start in
+ *    PROG mode. every burst starts w/ the calibration byte and the init sequence
+ *  - STREAM mode (key B held at reset): the line is high while idle, every byte
+ *    is a column for a chain of displays in SLAVE mode. the bytes that come
+ *    out at the end of the chain (wired to inPin) go back to the host: the
+ *    telemetry frames of the nodes, see blinkentlm
+ *  - key A held at reset: PROG mode w/ frames for a single display built w/
+ *    _FRAME_CHECK_, its output wired to inPin (ACK/NAK)
+ *
+ *  builds w/ the mock core in tools/mock on a PC, see 'make blinkenprog-host'
+ */
+
+#define outPin   10   // OC1B, fixed
+#define inPin    11   // display output: framecheck (ACK/NAK), end of the chain (STREAM)
+#define ctsPin   12   // low: host may send
 #define ledAPin   4
 #define ledBPin   5
 #define keyAPin   2
@@ -6,24 +27,50 @@
 #define keyA (!digitalRead(keyAPin))
 #define keyB (!digitalRead(keyBPin))
 
-#define bytedelay   20  // ms idle between bytes
+#define baudrate    115200
+#define bytedelay   20    // ms idle before the init sequence
+#define bytegap     2000  // us idle between bytes, >= 2 * COM_T_BIT -> receivers resync
+#define holdtime    5000  // ms w/o data until the line goes low again (PROG mode)
 
 boolean dosend = false;
 
 boolean debug = false;
 
+boolean streaming = false;
+
+// displays built w/ _FRAME_CHECK_ (key A held at reset): parity per byte,
+// data in crc checked frames, each one answered by ACK/NAK on inPin, resent
+// on failure. The answer comes from the display's output: only one display
+// on the line, its output wired to inPin
+boolean framecheck = false;
+
+#define framemax    16    // COM_FRAME_MAX
+#define framegap    60    // ms, > COM_T_FRAME_GAP -> display drops partial frame
+#define maxtries    5
+#define ACK         0x06
+#define NAK         0x15
+#define displaybit  800   // us, COM_T_BIT of the display's transmitter
+#define eepromBegin 2
+
 long baseTiming = 50;  // 50 us cycle time of ISR1 in the slave
 
+// base timings selectable w/ key A (key B: back to default). Faster than the
+// default only works with displays built w/ _AUTOBAUD_, they measure the
+// timing from the calibration byte and the init sequence.
+// 25 is the fastest step linktest passes (bit error rate 4e-3), at 20 about
+// two of three bytes get lost
+long speeds[] = { 50, 35, 25 };
+#define numspeeds 3
+int speedsel = 0;
+
 boolean pinstate = 1;
 
 void out (boolean val) {
-  digitalWrite(outPin, val); 
+  digitalWrite(outPin, val);
   digitalWrite(ledBPin, val);
   pinstate = val;
 }
 
-void toggle () { out(!pinstate); }
-
 
 
 // timing values in us
@@ -34,6 +81,10 @@ long refbit_high;
 // -/+ delta for setting refbit_low/high
 #define refbit_delta 0.3f
 
+// same in timer ticks (prescaler 8 @ 16 MHz -> 0.5 us)
+#define ticksPerUs  2
+unsigned int t_low, t_high, t_stop, t_gap;
+
 
 // sets up timing values based on val (in us);
 void updaterefbit (long val) {
@@ -41,7 +92,14 @@ void updaterefbit (long val) {
  refbit = 16*val;
  refbit_low = (long)((float)refbit*(1.0f-refbit_delta));
  refbit_high = (long)((float)refbit*(1.0f+refbit_delta));
- 
+
+ noInterrupts();
+ t_low  = refbit_low * ticksPerUs;
+ t_high = refbit_high * ticksPerUs;
+ t_stop = refbit/2 * ticksPerUs;
+ t_gap  = bytegap * ticksPerUs;
+ interrupts();
+
  if (debug) {
    Serial.println("timings:");
    Serial.print("refbit/H/L/byte = ");
@@ -56,74 +114,280 @@ void updaterefbit (long val) {
 }
 
 
+
+////////////////////////////////////////////////////////////////////////
+// ring buffer: filled from serial by pump(), emptied by the timer ISR
+
+#define ringsize    256   // byte indices wrap around by themselves
+#define ringstop    160   // used bytes -> CTS off
+#define ringgo      64    // used bytes -> CTS on again
+
+volatile byte ring[ringsize];
+volatile byte ringHead = 0;     // next write (loop)
+volatile byte ringTail = 0;     // next read (ISR)
+#define ringUsed ((byte)(ringHead - ringTail))
+
+// current byte as pulse lengths in timer ticks: gap, 8 bits, parity or stop
+volatile unsigned int pulses[10];
+volatile byte pulseIdx = 0;
+volatile boolean txBusy = false;
+
+
+void makePulses(byte b) {
+  boolean parity = 0;
+  pulses[0] = t_gap;
+  for (byte i = 0; i < 8; i++) {
+    if (b & (1 << i)) { pulses[i+1] = t_high; parity = !parity; }
+    else              { pulses[i+1] = t_low; }
+  }
+  if (framecheck) { pulses[9] = parity ? t_high : t_low; }  // even parity, ends high
+  else            { pulses[9] = t_stop; }                   // stop edge, back to high
+}
+
+
+// OC1B just toggled: schedule the next edge, or the next byte
+ISR(TIMER1_COMPB_vect) {
+  if (pulseIdx < 10) {
+    OCR1B += pulses[pulseIdx++];
+  } else if (ringHead != ringTail) {
+    makePulses(ring[ringTail++]);
+    OCR1B += pulses[0];
+    pulseIdx = 1;
+  } else {
+    TCCR1A = 0;                     // pin back to PORTB (high)
+    TIMSK1 &= ~(1 << OCIE1B);
+    txBusy = false;
+  }
+}
+
+
+// start the timer on the ring, if it is idle. the line must be high, the
+// OC1B latch is high too (setup, every byte ends high) -> no glitch
+void kick() {
+  if (txBusy || ringHead == ringTail) { return; }
+  noInterrupts();
+  makePulses(ring[ringTail++]);
+  pulseIdx = 1;
+  TCCR1A = (1 << COM1B0);                   // toggle on match
+  OCR1B = TCNT1 + pulses[0];
+  TIFR1 = (1 << OCF1B);
+  TIMSK1 |= (1 << OCIE1B);
+  txBusy = true;
+  interrupts();
+}
+
+
+// serial -> ring, flow control. returns the number of bytes taken
+int pump() {
+  int n = 0;
+  while (ringUsed < ringsize - 1 && Serial.available() > 0) {
+    ring[ringHead] = Serial.read();
+    ringHead++;
+    n++;
+  }
+  if (ringUsed >= ringstop)   { digitalWrite(ctsPin, HIGH); }
+  else if (ringUsed < ringgo) { digitalWrite(ctsPin, LOW); }
+  if (n) { kick(); }
+  return n;
+}
+
+
+// send one byte (and everything queued before), wait until it is out
+void sendByte(byte b) {
+  while (ringUsed >= ringsize - 1) { delayMicroseconds(10); }
+  ring[ringHead] = b;
+  ringHead++;
+  kick();
+  while (txBusy) { delayMicroseconds(10); }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+
+
 void setup() {
-  pinMode(outPin, OUTPUT); 
+  pinMode(outPin, OUTPUT);
+  pinMode(inPin, INPUT);
+  digitalWrite(inPin, HIGH);
+  pinMode(ctsPin, OUTPUT);
+  digitalWrite(ctsPin, HIGH);
   pinMode(ledAPin, OUTPUT);
   digitalWrite(ledAPin, HIGH);
   pinMode(ledBPin, OUTPUT);
-  pinMode(keyAPin, INPUT); 
+  pinMode(keyAPin, INPUT);
   digitalWrite(keyAPin, HIGH);
-  pinMode(keyBPin, INPUT); 
+  pinMode(keyBPin, INPUT);
   digitalWrite(keyBPin, HIGH);
-  
-  Serial.begin(9600);
-  
-  updaterefbit (50);
-  if (debug) { Serial.println("ready"); }
-  out (LOW);
+
+  // timer 1: normal mode, prescaler 8 (the core sets it up for pwm).
+  // set the OC1B latch high once, before the pin is driven
+  TCCR1A = (1 << COM1B1) | (1 << COM1B0);
+  TCCR1C = (1 << FOC1B);
+  TCCR1A = 0;
+  TCCR1B = (1 << CS11);
+
+  Serial.begin(baudrate);
+
+  updaterefbit (speeds[speedsel]);
+
+  streaming = keyB;
+  framecheck = keyA && !streaming;
+  while (keyA || keyB) {}
+  if (debug) { Serial.println(streaming ? "ready (stream)" : framecheck ? "ready (framecheck)" : "ready"); }
+  out (streaming ? HIGH : LOW);
 }
 
 
 
-// send one byte, beginning with a high signal
-void sendByte(char b) {
-            
-    toggle();
-    int bitnr=0;    
-    while (bitnr < 8) {
-      if (b & (1<<bitnr)) {                  // 1
-        delayMicroseconds(refbit_high);
-      } else {                               // 0
-        delayMicroseconds(refbit_low);
+// receive one byte from the display, -1 on timeout or parity error. A byte
+// takes up to 10 ms: in STREAM the serial input goes on into the ring meanwhile
+int receiveByte(unsigned long timeout) {
+
+    unsigned long t = millis();
+    while (digitalRead(inPin)) {
+      if (millis() - t > timeout) { return -1; }
+      if (streaming) { pump(); }
+    }
+
+    int b = 0;
+    int bits = framecheck ? 9 : 8;
+    boolean level = LOW;
+    boolean parity = 0;
+    unsigned long edge = micros();
+    for (int bitnr = 0; bitnr < bits; bitnr++) {
+      while (digitalRead(inPin) == level) {
+        if (micros() - edge > 4*displaybit) { return -1; }
+        if (streaming) { pump(); }
+      }
+      unsigned long now = micros();
+      if (now - edge >= displaybit) {
+        b |= (1 << bitnr);
+        parity = !parity;
       }
-      toggle();
-      bitnr++;
+      edge = now;
+      level = !level;
     }
 
-    delayMicroseconds(refbit/2);
-    toggle();   
+    if (framecheck && parity) { return -1; }
+    return b & 0xFF;
+}
+
+
+// same as _crc_ibutton_update() of avr-libc
+byte crc8(byte crc, byte data) {
+    crc ^= data;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0x8C : (crc >> 1);
+    }
+    return crc;
+}
+
+
+// send serial input as frames: addr, len, data, crc8. resend until ACKed
+void sendFrames() {
+
+    byte frame[framemax];
+    int addr = eepromBegin;
+    int retries = 0, failed = 0;
+
+    for (;;) {
+      // collect up to framemax bytes
+      int n = 0;
+      unsigned long t = millis();
+      digitalWrite(ctsPin, LOW);
+      while (n < framemax && millis() - t < bytedelay) {
+        if (Serial.available() > 0) { frame[n++] = Serial.read(); t = millis(); }
+      }
+      digitalWrite(ctsPin, HIGH);
+      if (n == 0) { break; }
+
+      int tries = 0, ack;
+      do {
+        if (tries) { retries++; delay(framegap); }
+        byte crc = 0;
+        sendByte(addr); crc = crc8(crc, addr);
+        sendByte(n);    crc = crc8(crc, n);
+        for (int i = 0; i < n; i++) { sendByte(frame[i]); crc = crc8(crc, frame[i]); }
+        sendByte(crc);
+        ack = receiveByte(100);
+        digitalWrite(ledAPin, ack != ACK);
+      } while (ack != ACK && ++tries < maxtries);
+
+      if (ack != ACK) { failed++; }
+      addr += n;
+    }
+
+    Serial.print("frames resent: ");
+    Serial.print(retries, DEC);
+    Serial.print(", failed: ");
+    Serial.println(failed, DEC);
+}
+
+
+// key A: next speed, key B: default speed
+void selectspeed() {
+  if (keyA) {
+    speedsel = (speedsel + 1) % numspeeds;
+  } else if (keyB) {
+    speedsel = 0;
+  } else {
+    return;
+  }
+  updaterefbit(speeds[speedsel]);
+  digitalWrite(ledBPin, HIGH);
+  while (keyA || keyB) {}
+  delay(50);
+  digitalWrite(ledBPin, LOW);
 }
-  
 
 
 void loop() {
 
+  // STREAM: just keep the chain busy, pass on what comes out at its end.
+  // the timer keeps sending from the ring meanwhile
+  if (streaming) {
+    if (!pump() && !txBusy) { selectspeed(); }
+    if (!digitalRead(inPin)) {
+      int b = receiveByte(0);
+      if (b >= 0) { Serial.write(b); }
+      // w/o parity the byte ends low, up to the stop edge
+      unsigned long t = micros();
+      while (!digitalRead(inPin) && micros() - t < 2*displaybit) { pump(); }
+    }
+    digitalWrite(ledAPin, txBusy);
+    return;
+  }
+
   Serial.flush();
- 
-  // wait for serial input
-  while (Serial.available() == 0) {}
+
+  // wait for serial input, then hold the host back until the init sequence is out
+  digitalWrite(ctsPin, LOW);
+  while (Serial.available() == 0) { selectspeed(); }
+  digitalWrite(ctsPin, HIGH);
   out (HIGH);
   delay(bytedelay);
 
-  // init sequence  
+  // calibration byte (4 short, 4 long pulses, never decodes as 0xAA)
+  sendByte(0x55);
+
+  // init sequence
   sendByte(0xAA);
-  delay(bytedelay);
   sendByte(0xAA);
-  delay(bytedelay);
 
-  char c; 
-  while (Serial.available() > 0) { 
-    c = Serial.read();
-    digitalWrite(ledAPin, c == 0x00);
-    sendByte(c);
-    if (debug) { Serial.print(c); }
-    digitalWrite(ledAPin,pinstate);
-    delay(bytedelay);
+  if (framecheck) {
+    sendFrames();
+  } else {
+    // until there was nothing to send for holdtime
+    unsigned long last = millis();
+    while (millis() - last < holdtime) {
+      if (pump() || txBusy) { last = millis(); }
+      digitalWrite(ledAPin, txBusy);
+    }
   }
-  
-  delay(5000);
+
+  if (framecheck) { delay(holdtime); }
   out (LOW);
   digitalWrite(ledAPin,LOW);
- 
-}
 
+}
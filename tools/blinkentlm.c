@@ -0,0 +1,617 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "../firmware/comm.h"
+
+#define AUTHORS "Manuel Jerger"
+#define VERSION "0.1"
+
+#define TRUE ~(uint)0
+#define FALSE (uint)0
+
+
+/*
+ * blinkentlm : the counters of a chain of blinken64 displays built w/
+ * _TELEMETRY_ (late ISRs, receiver overruns, glitches, mode changes, button
+ * presses, parity errors), read over the data pin while the chain is running
+ * in SLAVE mode.
+ *
+ * The chain is a shift register of 8 columns per node, nothing can come back
+ * on its own. So the query goes in as columns: the three query bytes of
+ * comm.h, then fill bytes. Every node puts its frame in the place of the
+ * first fill bytes after the frames of the nodes before it, and what comes
+ * out at the end of the chain (8 columns per node later) is the query, the
+ * frames of node 1..n and fill bytes again. The host has to keep sending
+ * fill bytes until the last frame is out, there are as many as there are
+ * columns going in.
+ *
+ * -d: through blinkenprog.pde in STREAM mode, the end of the chain wired to
+ * its inPin (blinkend must not have the port at the same time). The lead
+ * fill bytes before the query push the columns of the last message out (and
+ * get node 1 out of a WAIT), the query is sent again (-R) if the frames did
+ * not make it. --query writes the bytes to send instead, for anything else
+ * that can feed a chain (blinkenaudio --stream), -i reads the bytes that came
+ * out at its end. --simulate: a chain of nodes on the PC, the shift registers
+ * and telemetry() of blinken.c w/ counters made up, --sim-errors flips bits
+ * on the links between them; make tlmloop.
+ *
+ * The nodes in the chain also follow from the delay of the query (-d and
+ * --simulate: the bytes going out and the ones coming back are in step), a
+ * node w/o _TELEMETRY_ only shifts and shows up there, not in the frames.
+ */
+
+#define MAXNODES        (256)
+#define LEAD            (16)        // fill bytes before the query
+#define TIMEOUT_MS      (2000)      // nothing comes back after the last byte
+
+// what parse() found
+enum RESULT {TLM_NOQUERY, TLM_MORE, TLM_DONE, TLM_GARBLED};
+
+struct node {
+    int crcok;
+    uint8_t flags;
+    uint16_t counter[COM_TLM_COUNTERS];
+};
+
+const char *counterNames[COM_TLM_COUNTERS] = {"late", "overrun", "glitch", "slave", "timeout", "button", "parity"};
+
+
+char *program_name = "blinkentlm";
+
+char *device, *input, *output;
+
+int quiet = TRUE, csv = FALSE, queryOnly = FALSE;
+int maxnodes = 64;          // -N: bytes for this many nodes
+int lead = LEAD;
+int retries = 3;
+int timeoutMs = TIMEOUT_MS;
+int simulate = 0;           // nodes, 0: none
+double simErrors = 0;       // bit errors per byte and link
+unsigned int seed = 1;
+
+struct node nodes[MAXNODES];
+int found, queryAt;         // frames, offset of the query in what came back
+
+int queryBytes (uint8_t *buf);
+int broken (void);
+int parse (const uint8_t *d, int n);
+int readChain (uint8_t *rx, int max);
+int simChain (uint8_t *rx, int max);
+void printNodes (int result, int delay);
+void info(char *);
+
+
+////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+
+    program_name = argv[0];
+
+    // while args left..
+    int a = 1; int last_a = 1;
+    do {
+        last_a = a;
+        // two args
+        if (a+1 < argc) {
+
+            // serial port of the bridge
+            if (!strcmp (argv[a], "-d")) {
+                device = argv[a+1];
+                a += 2;
+
+            // bytes from the end of the chain
+            } else if (!strcmp (argv[a], "-i")) {
+                input = argv[a+1];
+                a += 2;
+
+            } else if (!strcmp (argv[a], "-o")) {
+                output = argv[a+1];
+                a += 2;
+
+            // most nodes there can be
+            } else if (!strcmp (argv[a], "-N")) {
+                maxnodes = atoi(argv[a+1]);
+                a += 2;
+
+            } else if (!strcmp (argv[a], "-l")) {
+                lead = atoi(argv[a+1]);
+                a += 2;
+
+            } else if (!strcmp (argv[a], "-R")) {
+                retries = atoi(argv[a+1]);
+                a += 2;
+
+            } else if (!strcmp (argv[a], "-t")) {
+                timeoutMs = atoi(argv[a+1]);
+                a += 2;
+
+            } else if (!strcmp (argv[a], "--simulate")) {
+                simulate = atoi(argv[a+1]);
+                a += 2;
+
+            } else if (!strcmp (argv[a], "--sim-errors")) {
+                simErrors = atof(argv[a+1]);
+                a += 2;
+
+            } else if (!strcmp (argv[a], "--seed")) {
+                seed = atoi(argv[a+1]);
+                a += 2;
+            }
+        }
+
+        // one arg (a may have changed)
+        if (a < argc) {
+
+            if (!strcmp (argv[a], "--query")) {
+                queryOnly = TRUE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--csv")) {
+                csv = TRUE;
+                a++;
+
+            // verbose
+            } else if (!strcmp (argv[a], "--verbose")) {
+                quiet = FALSE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--help")) {
+                fprintf (stdout, "\nCounters of a chain of blinken64 displays w/ _TELEMETRY_, read over the data pin.\n");
+                fprintf (stdout, "\nUsage: %s -d device [-N nodes] [-l lead] [-R retries] [-t ms] [--csv]\n", program_name);
+                fprintf (stdout, "       %s --query [-N nodes] [-l lead] [-o file]\n", program_name);
+                fprintf (stdout, "       %s -i file [--csv]\n", program_name);
+                fprintf (stdout, "       %s --simulate nodes [--sim-errors p] [--seed n] [-R retries] [--csv]\n", program_name);
+                fprintf (stdout, "\n    -d device        serial port of blinkenprog in STREAM mode, end of the chain on its inPin");
+                fprintf (stdout, "\n    -N nodes         most nodes in the chain, fill bytes for them (default %d, max %d)", maxnodes, MAXNODES);
+                fprintf (stdout, "\n    -l lead          fill bytes before the query (default %d)", lead);
+                fprintf (stdout, "\n    -R retries       query again if frames are missing or broken (default %d)", retries);
+                fprintf (stdout, "\n    -t ms            nothing back from the chain for this long: give up (default %d)", timeoutMs);
+                fprintf (stdout, "\n   --query           write the bytes to send (to -o, default stdout), e.g. for blinkenaudio --stream");
+                fprintf (stdout, "\n    -i file          bytes that came out at the end of the chain, - for stdin");
+                fprintf (stdout, "\n   --simulate nodes  a chain on the PC, w/ telemetry() of blinken.c");
+                fprintf (stdout, "\n   --sim-errors p    bit errors per byte on every link of the simulated chain (default 0)");
+                fprintf (stdout, "\n   --seed n          of the made up counters and the errors (default %u)", seed);
+                fprintf (stdout, "\n   --csv             time,node,crc ok,flags,late,overrun,glitch,slave,timeout,button,parity");
+                fprintf (stdout, "\n   --verbose         print log on stderr\n\n");
+
+                exit (EXIT_SUCCESS);
+            }
+        }
+
+    } while ( (a < argc) && (a != last_a) );
+
+    if (maxnodes < 1 || maxnodes > MAXNODES || lead < 0 || retries < 0 || timeoutMs <= 0 ||
+        simulate < 0 || simulate > MAXNODES || simErrors < 0 || simErrors > 1) {
+        fprintf (stderr, "%s: bad nodes, lead, retries, timeout or error rate, see --help\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+    if (!!device + !!input + !!queryOnly + !!simulate != 1) {
+        fprintf (stderr, "%s: one of -d, -i, --query or --simulate, see --help\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+    if (simulate > maxnodes) { maxnodes = simulate; }
+
+    uint8_t *tx = malloc(lead + 3 + (maxnodes + 1) * (8 + COM_TLM_LEN) + 8);
+    int ntx = queryBytes(tx);
+
+    if (queryOnly) {
+        FILE *o = output ? fopen(output, "wb") : stdout;
+        if (o == NULL) {
+            fprintf (stderr, "%s: can not write %s\n", program_name, output);
+            exit (EXIT_FAILURE);
+        }
+        fwrite(tx, 1, ntx, o);
+        if (o != stdout) { fclose(o); }
+        exit (EXIT_SUCCESS);
+    }
+
+    int max = ntx + 8 * MAXNODES;
+    uint8_t *rx = malloc(max);
+    int n, result, delay, tries = 0;
+    char msg[128];
+
+    if (input) {
+        FILE *in = strcmp(input, "-") ? fopen(input, "rb") : stdin;
+        if (in == NULL) {
+            fprintf (stderr, "%s: can not read %s\n", program_name, input);
+            exit (EXIT_FAILURE);
+        }
+        n = fread(rx, 1, max, in);
+        if (in != stdin) { fclose(in); }
+        result = parse(rx, n);
+        printNodes(result, -1);
+        exit (result == TLM_DONE && !broken() ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    // the try w/ the most good frames is the one shown
+    struct node *best = malloc(sizeof(nodes));
+    int bestGood = -1, bestFound = 0, bestResult = TLM_NOQUERY, bestDelay = -1;
+
+    srand(seed);
+    do {
+        int good = 0, i;
+
+        n = simulate ? simChain(rx, max) : readChain(rx, max);
+        result = parse(rx, n);
+        for (i=0; i<found && i<MAXNODES; i++) { if (nodes[i].crcok) { good++; } }
+        // in step: the query comes back 8 columns per node after it went in
+        delay = (result != TLM_NOQUERY && queryAt >= lead && !((queryAt - lead) & 7)) ? (queryAt - lead) >> 3 : -1;
+
+        sprintf(msg, "try %d: %d bytes back, %d frames, %d broken%s", tries + 1, n, found, found - good,
+                result == TLM_NOQUERY ? ", no query" : result == TLM_GARBLED ? ", garbled" : result == TLM_MORE ? ", cut off" : "");
+        info(msg);
+        if (good > bestGood || (good == bestGood && result == TLM_DONE)) {
+            memcpy(best, nodes, sizeof(nodes));
+            bestGood = good;
+            bestFound = found;
+            bestResult = result;
+            bestDelay = delay;
+        }
+        if (result == TLM_DONE && good == found) { break; }
+    } while (tries++ < retries);
+
+    info("\n");
+    memcpy(nodes, best, sizeof(nodes));
+    found = bestFound;
+    printNodes(bestResult, bestDelay);
+    free(best);
+    free(tx);
+    free(rx);
+    exit (bestResult == TLM_DONE && !broken() ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
+void info (char * str) {
+    if (!quiet) {
+        fprintf(stderr,"\n%s",str);
+    }
+}
+
+
+double now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+
+// crc8 of the frames, _crc_ibutton_update of avr-libc
+uint8_t crc8 (uint8_t crc, uint8_t data) {
+    int i;
+    crc ^= data;
+    for (i=0; i<8; i++) {
+        crc = (crc & 1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+    }
+    return crc;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// the frames
+
+// lead, query, and fill bytes until the frames of maxnodes are out, and one more
+int queryBytes (uint8_t *buf) {
+    int n = 0, i;
+    for (i=0; i<lead; i++) { buf[n++] = COM_TLM_FILL; }
+    buf[n++] = COM_TLM_QUERY0;
+    buf[n++] = COM_TLM_QUERY1;
+    buf[n++] = COM_TLM_QUERY2;
+    for (i=0; i < maxnodes * (8 + COM_TLM_LEN) + 1; i++) { buf[n++] = COM_TLM_FILL; }
+    return n;
+}
+
+
+/*
+ * what came out at the end of the chain: the columns before, the query, a
+ * frame per node, a fill byte after the last. Frames w/ a broken crc are
+ * kept (the length is fixed, the ones after are fine), a byte that is
+ * neither a frame nor a fill where one has to be is the end of it
+ */
+int parse (const uint8_t *d, int n) {
+
+    int i;
+
+    found = 0;
+    queryAt = -1;
+    for (i=0; i+2 < n; i++) {
+        if (d[i] == COM_TLM_QUERY0 && d[i+1] == COM_TLM_QUERY1 && d[i+2] == COM_TLM_QUERY2) { break; }
+    }
+    if (i+2 >= n) { return TLM_NOQUERY; }
+    queryAt = i;
+
+    for (i += 3; i < n; i += COM_TLM_LEN) {
+        if (d[i] == COM_TLM_FILL) { return TLM_DONE; }
+        if (d[i] != COM_TLM_FRAME) { return TLM_GARBLED; }
+        if (i + COM_TLM_LEN > n) { return TLM_MORE; }
+
+        if (found < MAXNODES) {
+            struct node *nd = &nodes[found];
+            uint8_t crc = 0;
+            int j;
+            for (j=1; j < COM_TLM_LEN - 1; j++) { crc = crc8(crc, d[i+j]); }
+            nd->crcok = crc == d[i + COM_TLM_LEN - 1];
+            nd->flags = d[i+1];
+            for (j=0; j < COM_TLM_COUNTERS; j++) { nd->counter[j] = d[i+2+2*j] | (d[i+3+2*j] << 8); }
+        }
+        found++;
+    }
+    return TLM_MORE;
+}
+
+
+// frames w/ a broken crc
+int broken () {
+    int i, n = 0;
+    for (i=0; i<found && i<MAXNODES; i++) { if (!nodes[i].crcok) { n++; } }
+    return n;
+}
+
+
+void printNodes (int result, int delay) {
+
+    int i, j;
+
+    if (csv) {
+        long t = time(NULL);
+        for (i=0; i<found && i<MAXNODES; i++) {
+            fprintf (stdout, "%ld,%d,%d,%d", t, i + 1, nodes[i].crcok ? 1 : 0, nodes[i].flags);
+            for (j=0; j<COM_TLM_COUNTERS; j++) { fprintf (stdout, ",%u", nodes[i].counter[j]); }
+            fprintf (stdout, "\n");
+        }
+        return;
+    }
+
+    if (result == TLM_NOQUERY) {
+        fprintf (stdout, "the query did not come back: chain in SLAVE mode, end of it on the inPin of the bridge?\n");
+        return;
+    }
+
+    if (result == TLM_DONE && !found) {
+        fprintf (stdout, "the query came back w/o frames: no node w/ _TELEMETRY_ in SLAVE mode\n");
+        return;
+    }
+
+    fprintf (stdout, "node  %-26s", "flags");
+    for (j=0; j<COM_TLM_COUNTERS; j++) { fprintf (stdout, " %8s", counterNames[j]); }
+    fprintf (stdout, "\n");
+
+    for (i=0; i<found && i<MAXNODES; i++) {
+        char flags[32] = "";
+        if (nodes[i].flags & COM_TLM_F_FRAMECHECK) { strcat(flags, "framecheck "); }
+        if (nodes[i].flags & COM_TLM_F_AUTOBAUD) { strcat(flags, "autobaud "); }
+        if (nodes[i].flags & COM_TLM_F_PACKED) { strcat(flags, "packed"); }
+
+        fprintf (stdout, "%4d  %-26s", i + 1, flags[0] ? flags : "-");
+        for (j=0; j<COM_TLM_COUNTERS; j++) {
+            // w/o the parity pulse there are no parity errors to count
+            if (j == COM_TLM_PARITY && !(nodes[i].flags & COM_TLM_F_FRAMECHECK)) {
+                fprintf (stdout, " %8s", "-");
+            } else {
+                fprintf (stdout, " %8u", nodes[i].counter[j]);
+            }
+        }
+        fprintf (stdout, "%s\n", nodes[i].crcok ? "" : "  crc broken");
+    }
+
+    if (result == TLM_GARBLED) {
+        fprintf (stdout, "garbled after node %d\n", found);
+    } else if (result == TLM_MORE) {
+        fprintf (stdout, "cut off after node %d, more than -N nodes?\n", found);
+    }
+    if (result == TLM_DONE && delay >= 0 && delay != found) {
+        fprintf (stdout, "%d nodes in the chain by the delay of the query, %d w/o _TELEMETRY_ or not in SLAVE mode\n",
+                 delay, delay - found);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// the bridge
+
+int ser = -1;
+
+void openSerial () {
+
+    struct termios t;
+
+    ser = open(device, O_RDWR | O_NOCTTY);
+    if (ser < 0) {
+        fprintf(stderr, "%s: can not open %s\n", program_name, device);
+        exit(EXIT_FAILURE);
+    }
+    // 115200 8N1, raw, hardware flow control (CTS of blinkenprog.pde)
+    if (!tcgetattr(ser, &t)) {
+        cfmakeraw(&t);
+        cfsetispeed(&t, B115200);
+        cfsetospeed(&t, B115200);
+        t.c_cflag |= CRTSCTS | CLOCAL | CREAD;
+        tcsetattr(ser, TCSANOW, &t);
+    }
+    fcntl(ser, F_SETFL, fcntl(ser, F_GETFL) | O_NONBLOCK);
+}
+
+
+/*
+ * query through the bridge: send and read at the same time (the bridge
+ * only has a small buffer, the chain takes a column per byte), stop
+ * sending once the frames are back. returns the bytes read
+ */
+int readChain (uint8_t *rx, int max) {
+
+    uint8_t tx[lead + 3 + maxnodes * (8 + COM_TLM_LEN) + 1];
+    int ntx = queryBytes(tx);
+    int sent = 0, got = 0;
+
+    if (ser < 0) { openSerial(); }
+    // what is left of the last try
+    tcflush(ser, TCIOFLUSH);
+
+    double last = now();
+    while (got < max) {
+        int result = parse(rx, got);
+        if (result == TLM_DONE || result == TLM_GARBLED) { break; }
+
+        struct pollfd p = { ser, POLLIN | (sent < ntx ? POLLOUT : 0), 0 };
+        if (poll(&p, 1, 100) < 0 && errno != EINTR) { break; }
+
+        if (p.revents & POLLOUT) {
+            int w = write(ser, tx + sent, ntx - sent);
+            if (w > 0) { sent += w; last = now(); }
+        }
+        if (p.revents & POLLIN) {
+            int r = read(ser, rx + got, max - got);
+            if (r > 0) { got += r; last = now(); }
+        }
+        if (p.revents & (POLLERR | POLLHUP)) {
+            fprintf(stderr, "%s: lost %s\n", program_name, device);
+            break;
+        }
+        if (now() - last > timeoutMs) { break; }
+    }
+    return got;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// the simulated chain
+
+struct simnode {
+    uint8_t buff[8];                // as in blinken.c, buff[7] goes out next
+    uint8_t state, pos, crc, high;  // telemetry()
+    uint16_t last;
+    uint8_t flags;
+    uint16_t tlm[COM_TLM_COUNTERS];
+};
+
+struct simnode *chain;
+
+enum SIM_STATES {SIM_IDLE, SIM_SCAN, SIM_PASS, SIM_OWN};
+
+// telemetry() of blinken.c
+uint8_t simTelemetry (struct simnode *s, uint8_t b) {
+
+    uint8_t out = b;
+
+    if (s->state == SIM_SCAN) {
+        if (b == COM_TLM_FRAME) {
+            s->state = SIM_PASS;
+            s->pos = COM_TLM_LEN - 1;
+        } else if (b == COM_TLM_FILL) {
+            s->state = SIM_OWN;
+            s->pos = 0;
+            s->crc = 0;
+        } else {
+            s->state = SIM_IDLE;
+        }
+    } else if (s->state == SIM_PASS) {
+        if (!--s->pos) { s->state = SIM_SCAN; }
+    }
+
+    if (s->state == SIM_OWN) {
+        if (s->pos == 0) {
+            out = COM_TLM_FRAME;
+        } else if (s->pos == COM_TLM_LEN - 1) {
+            out = s->crc;
+            s->state = SIM_IDLE;
+        } else {
+            if (s->pos == 1) {
+                out = s->flags;
+            } else if (s->pos & 1) {
+                out = s->high;
+            } else {
+                uint16_t v = s->tlm[(s->pos - 2) >> 1];
+                out = v;
+                s->high = v >> 8;
+            }
+            s->crc = crc8(s->crc, out);
+        }
+        s->pos++;
+    }
+
+    if (s->state == SIM_IDLE && s->last == ((COM_TLM_QUERY0 << 8) | COM_TLM_QUERY1) && b == COM_TLM_QUERY2) {
+        s->state = SIM_SCAN;
+    }
+    s->last = (s->last << 8) | b;
+    return out;
+}
+
+
+uint8_t simLink (uint8_t b) {
+    if (simErrors > 0 && rand() < simErrors * RAND_MAX) { b ^= 1 << (rand() & 7); }
+    return b;
+}
+
+
+// the nodes show something before, their counters are made up
+void simInit () {
+
+    int i, j;
+
+    chain = calloc(simulate, sizeof(struct simnode));
+    for (i=0; i<simulate; i++) {
+        struct simnode *s = &chain[i];
+        for (j=0; j<8; j++) { s->buff[j] = rand(); }
+        s->last = rand();
+        s->flags = rand() & (COM_TLM_F_FRAMECHECK | COM_TLM_F_AUTOBAUD | COM_TLM_F_PACKED);
+        s->tlm[COM_TLM_LATE] = rand() % 3;
+        s->tlm[COM_TLM_OVERRUN] = rand() % 5;
+        s->tlm[COM_TLM_GLITCH] = rand() % 100;
+        s->tlm[COM_TLM_SLAVE] = 1 + rand() % 3;
+        s->tlm[COM_TLM_TIMEOUT] = s->tlm[COM_TLM_SLAVE] - 1;
+        s->tlm[COM_TLM_BUTTON] = rand() % 10;
+        s->tlm[COM_TLM_PARITY] = (s->flags & COM_TLM_F_FRAMECHECK) ? rand() % 20 : 0;
+    }
+}
+
+
+// the query bytes through the chain, column by column. returns the bytes at its end
+int simChain (uint8_t *rx, int max) {
+
+    uint8_t tx[lead + 3 + maxnodes * (8 + COM_TLM_LEN) + 1];
+    int ntx = queryBytes(tx);
+    int i, j, k;
+
+    if (!chain) { simInit(); }
+
+    for (i=0; i<ntx && i<max; i++) {
+        uint8_t b = simLink(tx[i]);
+        for (j=0; j<simulate; j++) {
+            struct simnode *s = &chain[j];
+            uint8_t o = s->buff[7];
+            for (k=7; k>0; k--) { s->buff[k] = s->buff[k-1]; }
+            s->buff[0] = simTelemetry(s, b);
+            b = simLink(o);
+        }
+        rx[i] = b;
+    }
+
+    // what came back has to be what the nodes have. w/ bit errors on the
+    // links a node may miss the query, and one broken frame in 256 has a
+    // good crc
+    int result = parse(rx, i), wrong = 0;
+    for (j=0; j<found && j<simulate; j++) {
+        if (nodes[j].crcok && (nodes[j].flags != chain[j].flags ||
+                               memcmp(nodes[j].counter, chain[j].tlm, sizeof(chain[j].tlm)))) { wrong++; }
+    }
+    if (simErrors > 0) {
+        char msg[64];
+        if (wrong) { sprintf(msg, "%d broken frames w/ a good crc", wrong); info(msg); }
+    } else if (wrong || (result == TLM_DONE && found != simulate)) {
+        fprintf (stderr, "%s: simulated chain: %d of %d frames not what the nodes have\n", program_name,
+                 wrong ? wrong : simulate - found, simulate);
+        exit (EXIT_FAILURE);
+    }
+    return i;
+}
@@ -0,0 +1,601 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "../firmware/comm.h"
+#include "libblinken.h"
+
+#define AUTHORS "Manuel Jerger"
+#define VERSION "0.1"
+
+#define TRUE ~(uint)0
+#define FALSE (uint)0
+
+
+/*
+ * blinkenvideo : clips and generated visuals on a chain of displays in
+ * SLAVE mode. Reads greyscale frames, a stream of pgm (or pbm) images on
+ * stdin, e.g.
+ *
+ *      ffmpeg -i clip.mp4 -vf fps=10,format=gray -f image2pipe -vcodec pgm - \
+ *          | blinkenvideo -N 4 -f 10 -o /dev/ttyUSB0
+ *
+ * crops them to the shape of the wall (or stretches them), scales them down
+ * to 8 x 8*N pixels (mean of the pixels under each LED), dithers them and
+ * writes the columns: for the programmer bridge in STREAM mode (one byte per
+ * column, the left one first, so it ends up on the last display of the chain)
+ * or to a virtual display (--shm, see blinkenview).
+ *
+ * Frames are encoded by a pool of threads. They go through a ring of slots,
+ * the reorder buffer: the reader fills the slots in order, any worker takes
+ * the next one read, the writer waits for the oldest one. A slow frame holds
+ * up the writer, not the workers, until the ring is full.
+ *
+ * On a device (or --realtime) frame n is due at n/fps and the columns go out
+ * at the column rate the slaves can keep up with (-c, like blinkend -r). A
+ * frame that is more than one frame late is dropped. At the end the frame
+ * rate the link allows is reported: the wire time of the columns sent, from
+ * the pulse lengths of comm.h and the gap between the bytes of the bridge,
+ * against the frame rate asked for and the rate measured on the device.
+ */
+
+#define MAXDISPLAYS     (256)
+#define MAXWIDTH        (8 * MAXDISPLAYS)
+#define MAXTHREADS      (64)
+#define BRIDGE_GAP_US   (2000)      // bytegap of blinkenprog.pde
+
+// states of a slot of the ring
+#define FREE            0
+#define READ            1           // frame read, not taken by a worker
+#define BUSY            2
+#define DONE            3           // columns ready for the writer
+
+#define DITHER_NONE     0
+#define DITHER_BAYER    1
+#define DITHER_FS       2
+
+
+char *program_name = "blinkenvideo";
+
+char *output, *shmname;
+
+int quiet = TRUE, stretch = FALSE, realtime = FALSE;
+int displays = 4;           // in the chain
+int threads = 0;            // 0: one per cpu
+int ring = 0;               // slots, 0: 2 per thread
+int dither = DITHER_BAYER;
+double fps = 10;            // target frame rate
+double colrate = 100;       // columns per second on the wire (blinkend -r)
+
+int width;                  // 8 * displays
+
+struct slot {
+    struct bl_pnm img;
+    long n;                 // frame number
+    int state;
+    uint8_t cols[MAXWIDTH]; // left column first, bit 0 the top row
+    long ticks;             // wire time of the columns, ISR ticks
+    int maxticks;           // of the longest one
+    int64_t ns;             // encode time
+};
+
+struct slot *slots;
+
+pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t changed = PTHREAD_COND_INITIALIZER;
+long nextjob = 0;           // next frame for a worker
+long nread = -1;            // frames read, once the input is done
+int failed = FALSE;          // input broken
+int writefail = FALSE;
+
+// statistics
+long written = 0, dropped = 0;
+long sumticks = 0;
+int maxticks = 0;
+int64_t encodens = 0;
+int64_t nextcol = 0;        // due on the wire
+int64_t busyns = 0;         // frames going out on the device
+
+int out = -1;               // bridge / file / stdout
+struct bl_display *shm;
+
+void *worker (void *);
+void *writer (void *);
+void readFrames (void);
+void openOutput (void);
+void report (double);
+void info(char *);
+
+
+int64_t now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+void sleepUntil (int64_t t) {
+    struct timespec ts = { t / 1000000000, t % 1000000000 };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) { }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+
+    pthread_t tid[MAXTHREADS], wtid;
+    int64_t t0;
+    int i;
+
+    program_name = argv[0];
+
+    // while args left..
+    int a = 1; int last_a = 1;
+    do {
+        last_a = a;
+        // two args
+        if (a+1 < argc) {
+
+            // displays in the chain
+            if (!strcmp (argv[a], "-N")) {
+                displays = atoi(argv[a+1]);
+                a += 2;
+
+            // frame rate
+            } else if (!strcmp (argv[a], "-f")) {
+                fps = atof(argv[a+1]);
+                a += 2;
+
+            // column rate on the wire
+            } else if (!strcmp (argv[a], "-c")) {
+                colrate = atof(argv[a+1]);
+                a += 2;
+
+            // bridge, file
+            } else if (!strcmp (argv[a], "-o")) {
+                output = argv[a+1];
+                a += 2;
+
+            // virtual display
+            } else if (!strcmp (argv[a], "--shm")) {
+                shmname = argv[a+1];
+                a += 2;
+
+            } else if (!strcmp (argv[a], "-d")) {
+                if (!strcmp (argv[a+1], "none")) {
+                    dither = DITHER_NONE;
+                } else if (!strcmp (argv[a+1], "bayer")) {
+                    dither = DITHER_BAYER;
+                } else if (!strcmp (argv[a+1], "fs")) {
+                    dither = DITHER_FS;
+                } else {
+                    fprintf (stderr, "%s: unknown dither %s, see --help\n", program_name, argv[a+1]);
+                    exit (EXIT_FAILURE);
+                }
+                a += 2;
+
+            } else if (!strcmp (argv[a], "--threads")) {
+                threads = atoi(argv[a+1]);
+                a += 2;
+
+            // reorder buffer
+            } else if (!strcmp (argv[a], "-q")) {
+                ring = atoi(argv[a+1]);
+                a += 2;
+            }
+        }
+
+        // one arg (a may have changed)
+        if (a < argc) {
+
+            if (!strcmp (argv[a], "--stretch")) {
+                stretch = TRUE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--realtime")) {
+                realtime = TRUE;
+                a++;
+
+            // verbose
+            } else if (!strcmp (argv[a], "--verbose")) {
+                quiet = FALSE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--help")) {
+                fprintf (stdout, "\nGreyscale frames (a pgm stream on stdin) -> columns for a chain of blinken64 displays.\n");
+                fprintf (stdout, "\nUsage: %s [-N displays] [-f fps] [-c columns/s] [-o device | --shm name] [-d none|bayer|fs]\n", program_name);
+                fprintf (stdout, "                  [--stretch] [--realtime] [--threads n] [-q slots] [--verbose] < frames.pgm\n");
+                fprintf (stdout, "\n    -N displays      displays in the chain, the frames are 8 x 8*N (default %d)", displays);
+                fprintf (stdout, "\n    -f fps           frame rate (default %g)", fps);
+                fprintf (stdout, "\n    -c columns/s     column rate on the wire, below the link capacity (default %g)", colrate);
+                fprintf (stdout, "\n    -o device        the bridge in STREAM mode, or a file (default: stdout)");
+                fprintf (stdout, "\n   --shm name        publish the wall on the virtual display name instead");
+                fprintf (stdout, "\n    -d dither        none, bayer (ordered, steady from frame to frame) or fs (default bayer)");
+                fprintf (stdout, "\n   --stretch         the whole frame, not the middle part of the shape of the wall");
+                fprintf (stdout, "\n   --realtime        frames at the frame rate (default on a device and w/ --shm)");
+                fprintf (stdout, "\n   --threads n       encoder threads (default: one per cpu)");
+                fprintf (stdout, "\n    -q slots         reorder buffer (default: 2 per thread)");
+                fprintf (stdout, "\n   --verbose         print log on stderr\n\n");
+
+                exit (EXIT_SUCCESS);
+            }
+        }
+
+    } while ( (a < argc) && (a != last_a) );
+
+    if (displays < 1 || displays > MAXDISPLAYS || fps <= 0 || colrate <= 0) {
+        fprintf (stderr, "%s: bad number of displays or rate, see --help\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+    width = 8 * displays;
+    if (threads <= 0) { threads = sysconf(_SC_NPROCESSORS_ONLN); }
+    if (threads > MAXTHREADS) { threads = MAXTHREADS; }
+    if (ring < threads + 1) { ring = ring ? threads + 1 : 2 * threads; }
+    if (ring < 2) { ring = 2; }
+
+    openOutput();
+
+    slots = calloc(ring, sizeof(struct slot));
+
+    t0 = now();
+    for (i=0; i<threads; i++) { pthread_create(&tid[i], NULL, worker, NULL); }
+    pthread_create(&wtid, NULL, writer, NULL);
+
+    readFrames();
+
+    pthread_join(wtid, NULL);
+    for (i=0; i<threads; i++) { pthread_join(tid[i], NULL); }
+
+    report((now() - t0) / 1e9);
+
+    if (shm != NULL) { bl_display_close(shm); }
+    if (out >= 0) { close(out); }
+    for (i=0; i<ring; i++) { bl_pnm_free(&slots[i].img); }
+    free(slots);
+
+    exit (failed || writefail ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+
+void info (char * str) {
+    if (!quiet) {
+        fprintf(stderr,"\n%s",str);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+// the bridge like blinkend opens it (115200, CTS), a file, or stdout
+void openOutput () {
+
+    struct termios t;
+
+    if (shmname != NULL) {
+        shm = bl_display_create(shmname, width, 64);
+        if (shm == NULL) {
+            fprintf (stderr, "%s: can not create the virtual display %s\n", program_name, shmname);
+            exit (EXIT_FAILURE);
+        }
+        realtime = TRUE;
+        return;
+    }
+
+    if (output == NULL) {
+        out = STDOUT_FILENO;
+    } else {
+        out = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_NOCTTY, 0666);
+        if (out < 0) {
+            fprintf (stderr, "%s: can not open %s\n", program_name, output);
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    if (isatty(out) && output != NULL) {
+        if (!tcgetattr(out, &t)) {
+            cfmakeraw(&t);
+            cfsetispeed(&t, B115200);
+            cfsetospeed(&t, B115200);
+            t.c_cflag |= CRTSCTS | CLOCAL | CREAD;
+            tcsetattr(out, TCSANOW, &t);
+        }
+        realtime = TRUE;
+    }
+}
+
+
+// the reader: frames into the ring, in order
+void readFrames () {
+
+    long n;
+    int r;
+
+    for (n=0; ; n++) {
+        struct slot *s = &slots[n % ring];
+
+        pthread_mutex_lock(&lock);
+        while (s->state != FREE) { pthread_cond_wait(&changed, &lock); }
+        pthread_mutex_unlock(&lock);
+
+        // the slot is the reader's until it is READ
+        r = bl_pnm_fread(stdin, &s->img);
+        if (r < 0) {
+            fprintf (stderr, "%s: frame %ld: %s\n", program_name, n, s->img.err);
+            failed = TRUE;
+        }
+
+        pthread_mutex_lock(&lock);
+        if (r <= 0) {
+            nread = n;
+            pthread_cond_broadcast(&changed);
+            pthread_mutex_unlock(&lock);
+            break;
+        }
+        s->n = n;
+        s->state = READ;
+        pthread_cond_broadcast(&changed);
+        pthread_mutex_unlock(&lock);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+static const uint8_t bayer[8][8] = {
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 } };
+
+
+// frame -> 8 x width grey (0..255) -> dithered columns
+void encode (struct slot *s) {
+
+    const struct bl_pnm *img = &s->img;
+    int full = img->maxval > 255 || img->maxval == 1 ? 255 : img->maxval;
+    int cx = 0, cy = 0, cw = img->width, ch = img->height;
+    int x, y, xs, ys, j;
+    static __thread int grey[8][MAXWIDTH + 2], x0[MAXWIDTH + 1];
+
+    // the middle part in the shape of the wall
+    if (!stretch) {
+        if ((long)cw * 8 > (long)ch * width) {
+            cw = (long)ch * width / 8;
+            if (cw < 1) { cw = 1; }
+            cx = (img->width - cw) / 2;
+        } else {
+            ch = (long)cw * 8 / width;
+            if (ch < 1) { ch = 1; }
+            cy = (img->height - ch) / 2;
+        }
+    }
+
+    // mean of the pixels under each LED (at least one of them)
+    for (x=0; x<=width; x++) { x0[x] = cx + (long)x * cw / width; }
+    for (y=0; y<8; y++) {
+        int y0 = cy + y * ch / 8, y1 = cy + (y + 1) * ch / 8;
+        if (y1 <= y0) { y1 = y0 + 1; }
+        for (x=0; x<width; x++) {
+            int x1 = x0[x+1] > x0[x] ? x0[x+1] : x0[x] + 1;
+            long sum = 0;
+            for (ys=y0; ys<y1; ys++) {
+                const uint8_t *p = img->pix + (long)ys * img->width;
+                for (xs=x0[x]; xs<x1; xs++) { sum += p[xs]; }
+            }
+            grey[y][x] = sum * 255 / ((long)(y1 - y0) * (x1 - x0[x]) * full);
+        }
+    }
+
+    memset(s->cols, 0, width);
+    for (y=0; y<8; y++) {
+        for (x=0; x<width; x++) {
+            int g = grey[y][x], on;
+
+            if (dither == DITHER_BAYER) {
+                on = g > 4 * bayer[y][x & 7] + 2;
+            } else {
+                on = g > 127;
+            }
+
+            // error to the right and to the row below
+            if (dither == DITHER_FS) {
+                int e = g - (on ? 255 : 0);
+                if (x+1 < width) { grey[y][x+1] += e * 7 / 16; }
+                if (y < 7) {
+                    if (x > 0) { grey[y+1][x-1] += e * 3 / 16; }
+                    grey[y+1][x] += e * 5 / 16;
+                    if (x+1 < width) { grey[y+1][x+1] += e / 16; }
+                }
+            }
+            if (on) { s->cols[x] |= 1 << y; }
+        }
+    }
+
+    // on the wire: a pulse per bit, the stop edge (transmit() of blinken.c)
+    s->ticks = 0;
+    s->maxticks = 0;
+    for (x=0; x<width; x++) {
+        int t = COM_T_BIT/2;
+        for (j=0; j<8; j++) { t += (s->cols[x] & (1 << j)) ? COM_T_HIGH : COM_T_LOW; }
+        s->ticks += t;
+        if (t > s->maxticks) { s->maxticks = t; }
+    }
+}
+
+
+void *worker (void *arg) {
+
+    (void)arg;
+
+    for (;;) {
+        struct slot *s;
+        int64_t t;
+
+        pthread_mutex_lock(&lock);
+        for (;;) {
+            s = &slots[nextjob % ring];
+            if (s->state == READ && s->n == nextjob) { break; }
+            if (nread >= 0 && nextjob >= nread) { s = NULL; break; }
+            pthread_cond_wait(&changed, &lock);
+        }
+        if (s == NULL) {
+            pthread_mutex_unlock(&lock);
+            return NULL;
+        }
+        s->state = BUSY;
+        nextjob++;
+        pthread_mutex_unlock(&lock);
+
+        t = now();
+        encode(s);
+        s->ns = now() - t;
+
+        pthread_mutex_lock(&lock);
+        s->state = DONE;
+        pthread_cond_broadcast(&changed);
+        pthread_mutex_unlock(&lock);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+int writeAll (const uint8_t *b, int len) {
+    while (len > 0) {
+        int n = write(out, b, len);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n <= 0) { return -1; }
+        b += n;
+        len -= n;
+    }
+    return 0;
+}
+
+
+// the frames in order: columns to the bridge (paced), or the wall to the virtual display
+void output1 (struct slot *s, int64_t due) {
+
+    uint8_t wall[MAXWIDTH];
+    int64_t colns = 1e9 / colrate, t;
+    int x;
+
+    if (shm != NULL) {
+        // display d shows buff[0..7] = the columns 8d+7..8d of the wall from the right
+        for (x=0; x<width; x++) { wall[x] = s->cols[width - 1 - x]; }
+        sleepUntil(due);
+        bl_display_publish(shm, wall, (int64_t)(s->n * 1e6 / fps / BL_TICK_US), s->n);
+        return;
+    }
+
+    if (!realtime) {
+        if (writeAll(s->cols, width) < 0) { writefail = TRUE; }
+        return;
+    }
+
+    // a column at a time, no faster than the slaves take them
+    if (nextcol < due) { nextcol = due; }
+    sleepUntil(nextcol);
+    t = now();
+    for (x=0; x<width && !writefail; x++) {
+        sleepUntil(nextcol);
+        if (writeAll(s->cols + x, 1) < 0) { writefail = TRUE; }
+        nextcol += colns;
+    }
+    // the last column takes its time too, unless the device held the writes back longer
+    busyns += (now() > nextcol ? now() : nextcol) - t;
+}
+
+
+void *writer (void *arg) {
+
+    int64_t t0 = 0, frame = 1e9 / fps;
+    long n;
+
+    (void)arg;
+
+    for (n=0; ; n++) {
+        struct slot *s = &slots[n % ring];
+
+        pthread_mutex_lock(&lock);
+        while (!(s->state == DONE && s->n == n) && !(nread >= 0 && n >= nread)) {
+            pthread_cond_wait(&changed, &lock);
+        }
+        pthread_mutex_unlock(&lock);
+        if (s->state != DONE || s->n != n) { break; }
+
+        if (!t0) { t0 = now(); }
+        encodens += s->ns;
+
+        // late by more than a frame: dropped, the next one is closer to the time
+        if (realtime && now() > t0 + (n + 1) * frame) {
+            dropped++;
+        } else if (!writefail) {
+            output1(s, t0 + n * frame);
+            written++;
+            sumticks += s->ticks;
+            if (s->maxticks > maxticks) { maxticks = s->maxticks; }
+        }
+
+        pthread_mutex_lock(&lock);
+        s->state = FREE;
+        pthread_cond_broadcast(&changed);
+        pthread_mutex_unlock(&lock);
+    }
+    if (writefail && out >= 0 && shm == NULL) {
+        fprintf (stderr, "%s: write to %s failed\n", program_name, output ? output : "stdout");
+    }
+    return NULL;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+/*
+ * what the link allows: a slave sends every column on after it came in, so
+ * the longest column has to be out before the next one is in; the bridge
+ * needs the pulses and its gap for every column
+ */
+void report (double sec) {
+
+    long cols = written * width;
+    double mean = cols ? (double)sumticks * BL_TICK_US / cols + BRIDGE_GAP_US : 0;
+    double worst = maxticks * BL_TICK_US;
+    double capacity = cols ? 1e6 / (mean > worst ? mean : worst) : 0;
+    double maxfps = capacity / width;
+
+    fprintf (stderr, "%ld frames, %ld written, %ld dropped, %d displays (%d columns a frame)\n",
+             nread > 0 ? nread : 0, written, dropped, displays, width);
+    fprintf (stderr, "encoder: %.1f frames/s, %.2f ms per frame, %d threads, %d slots\n",
+             sec > 0 ? (written + dropped) / sec : 0, (written + dropped) ? encodens / 1e6 / (written + dropped) : 0,
+             threads, ring);
+    if (!cols) { return; }
+
+    fprintf (stderr, "link: %.0f us per column (%.0f us the longest one, %d us gap of the bridge) -> %.0f columns/s\n",
+             mean, worst, BRIDGE_GAP_US, capacity);
+    fprintf (stderr, "      %.1f fps at %d displays, %.1f fps asked for: %s\n", maxfps, displays, fps,
+             maxfps >= fps ? "ok" : "too fast for the link");
+    fprintf (stderr, "      at %.1f fps the link carries %d displays\n", fps, (int)(capacity / fps / 8));
+    if (colrate > capacity) {
+        fprintf (stderr, "      -c %.0f is above the link capacity: the slaves lose columns\n", colrate);
+    }
+    if (realtime && shm == NULL && busyns > 0) {
+        fprintf (stderr, "measured: %.0f columns/s taken by %s while the frames went out (-c %.0f)\n",
+                 cols * 1e9 / busyns, output ? output : "stdout", colrate);
+    }
+}
@@ -0,0 +1,270 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "libblinken.h"
+
+#define AUTHORS "Manuel Jerger"
+#define VERSION "0.1"
+
+#define TRUE ~(uint)0
+#define FALSE (uint)0
+
+
+/*
+ * blinkenview : attaches to a virtual display (blinkenplay --shm, the chain
+ * simulator, ...) and shows it on the terminal or records it. It never
+ * slows down the producer: frames it is too late for are counted as lost.
+ *
+ * The trace has the format of blinkenplay --trace, one line per frame:
+ * "<t_us> <hold_us> <msg> <hex>", the hex is the wall as it is seen from
+ * the front, buff[7]..buff[0] of every display, the last one of the chain
+ * first. At the end the number of frames, the lost ones and the latency
+ * (published -> read) go to stderr.
+ */
+
+
+char *program_name = "blinkenview";
+
+char *name, *traceout;
+
+int quiet = TRUE, useansi = FALSE;
+long maxframes = 0;         // stop after, 0: until the producer is gone
+double timeout = 10;        // s to wait for the display to appear
+
+volatile sig_atomic_t stop = 0;
+
+void view (struct bl_display *);
+void info(char *);
+
+
+void onSignal (int sig) { (void)sig; stop = 1; }
+
+
+int64_t now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+void nap (long us) {
+    struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+
+    struct bl_display *d;
+    int64_t t0;
+
+    program_name = argv[0];
+
+    // while args left..
+    int a = 1; int last_a = 1;
+    do {
+        last_a = a;
+        // two args
+        if (a+1 < argc) {
+
+            // record frames
+            if (!strcmp (argv[a], "--trace")) {
+                traceout = argv[a+1];
+                a += 2;
+
+            // number of frames
+            } else if (!strcmp (argv[a], "-n")) {
+                maxframes = atol(argv[a+1]);
+                a += 2;
+
+            // wait for the producer
+            } else if (!strcmp (argv[a], "-w")) {
+                timeout = atof(argv[a+1]);
+                a += 2;
+            }
+        }
+
+        // one arg (a may have changed)
+        if (a < argc) {
+
+            if (!strcmp (argv[a], "--ansi")) {
+                useansi = TRUE;
+                a++;
+
+            // verbose
+            } else if (!strcmp (argv[a], "--verbose")) {
+                quiet = FALSE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--help")) {
+                fprintf (stdout, "\nShow or record a blinken64 virtual display.\n");
+                fprintf (stdout, "\nUsage: %s [--ansi] [--trace file] [-n frames] [-w s] [--verbose] name\n", program_name);
+                fprintf (stdout, "\n    name             the virtual display (blinkenplay --shm name)");
+                fprintf (stdout, "\n   --ansi            show it on the terminal (default w/o --trace)");
+                fprintf (stdout, "\n   --trace file      record the frames, blinkenplay --trace format");
+                fprintf (stdout, "\n    -n frames        stop after n frames (default: when the producer is gone)");
+                fprintf (stdout, "\n    -w s             wait for the display to appear (default %g)", timeout);
+                fprintf (stdout, "\n   --verbose         print log on stderr\n\n");
+
+                exit (EXIT_SUCCESS);
+
+            // the display
+            } else if (argv[a][0] != '-' && name == NULL) {
+                name = argv[a];
+                a++;
+            }
+        }
+
+    } while ( (a < argc) && (a != last_a) );
+
+    if (name == NULL) {
+        fprintf (stderr, "%s: which display? see --help\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+    if (traceout == NULL) { useansi = TRUE; }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    // the producer may not be there yet
+    t0 = now();
+    while ((d = bl_display_open(name)) == NULL) {
+        if (stop || now() - t0 > timeout * 1e9) {
+            fprintf (stderr, "%s: no virtual display %s\n", program_name, name);
+            exit (EXIT_FAILURE);
+        }
+        nap(1000);
+    }
+    info ("attached");
+
+    view(d);
+
+    bl_display_close(d);
+    exit (EXIT_SUCCESS);
+}
+
+
+void info (char * str) {
+    if (!quiet) {
+        fprintf(stderr,"\n%s",str);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+// the wall from the front: last display of the chain first, buff[7] left
+void hexWall (FILE *f, const struct bl_shm_slot *s, int width) {
+    int n = width / 8, d, j;
+    for (d=n-1; d>=0; d--) {
+        for (j=7; j>=0; j--) { fprintf (f, "%02x", s->cols[8*d + j]); }
+    }
+}
+
+
+void ansiWall (const struct bl_shm_slot *s, int width, int tick_us) {
+    int n = width / 8, d, j, y;
+    for (y=0; y<8; y++) {
+        for (d=n-1; d>=0; d--) {
+            for (j=7; j>=0; j--) {
+                fputs ((s->cols[8*d + j] >> y) & 1 ? "\033[1;31mO\033[0m" : "\033[2m.\033[0m", stdout);
+            }
+            fputs (" ", stdout);
+        }
+        fputs ("\n", stdout);
+    }
+    fprintf (stdout, "msg %d  %.3f s\n\033[9A", s->msg, (double)s->tick * tick_us / 1e6);
+    fflush(stdout);
+}
+
+
+/*
+ * from the oldest frame still in the ring on. a frame that was overwritten
+ * before it could be read is lost, reading goes on w/ the oldest one left
+ */
+void view (struct bl_display *d) {
+
+    int width = d->h->width, slots = d->h->slots, tick_us = d->h->tick_us;
+    struct bl_shm_slot *s = malloc(d->h->slotsize), *prev = malloc(d->h->slotsize);
+    uint64_t next, head;
+    long frames = 0, lost = 0;
+    int64_t latency = 0, maxlatency = 0, t;
+    int have = 0, r;
+    FILE *f = NULL;
+
+    if (traceout != NULL) {
+        f = fopen(traceout, "w");
+        if (f == NULL) {
+            fprintf (stderr, "%s: can not write %s\n", program_name, traceout);
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    head = bl_display_head(d);
+    next = head > (uint64_t)slots ? head - slots : 0;
+
+    while (!stop && (maxframes == 0 || frames < maxframes)) {
+
+        r = bl_display_read(d, next, s);
+
+        if (r == 0) {
+            if (__atomic_load_n(&d->h->closed, __ATOMIC_ACQUIRE) && next >= bl_display_head(d)) { break; }
+            nap(500);
+            continue;
+        }
+
+        if (r < 0) {
+            head = bl_display_head(d);
+            uint64_t oldest = head > (uint64_t)slots ? head - slots + 1 : next + 1;
+            if (oldest <= next) { oldest = next + 1; }
+            lost += oldest - next;
+            next = oldest;
+            continue;
+        }
+
+        t = now() - s->ns;
+        latency += t;
+        if (t > maxlatency) { maxlatency = t; }
+        frames++;
+        next++;
+
+        // a trace line needs the next frame for the hold time
+        if (f != NULL && have) {
+            fprintf (f, "%lld %lld %d ", (long long)prev->tick * tick_us,
+                     (long long)(s->tick - prev->tick) * tick_us, prev->msg);
+            hexWall(f, prev, width);
+            fprintf (f, "\n");
+        }
+        memcpy(prev, s, d->h->slotsize);
+        have = 1;
+
+        if (useansi) { ansiWall(s, width, tick_us); }
+    }
+
+    if (f != NULL) {
+        if (have) {
+            fprintf (f, "%lld 0 %d ", (long long)prev->tick * tick_us, prev->msg);
+            hexWall(f, prev, width);
+            fprintf (f, "\n");
+        }
+        fclose(f);
+    }
+    if (useansi) { fputs ("\033[9B\n", stdout); }
+
+    fprintf (stderr, "%ld frames, %ld lost, latency %.1f us avg, %.1f us max\n", frames, lost,
+             frames ? latency / 1e3 / frames : 0, maxlatency / 1e3);
+
+    free(s);
+    free(prev);
+}
@@ -0,0 +1,756 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "../firmware/comm.h"
+#include "libblinken.h"
+
+#define AUTHORS "Manuel Jerger"
+#define VERSION "0.1"
+
+#define TRUE ~(uint)0
+#define FALSE (uint)0
+
+
+/*
+ * blinkenwall : a chain of blinken64 displays on the PC, at the level of
+ * the single pin link. Node 0 is the master playing an eeprom image (the
+ * player of libblinken), every other node runs the receiving ISR and the
+ * SLAVE part of the main loop of blinken.c on a clock of its own: it takes
+ * the byte when rxDone is set, transmit()s its buff[7] to the next node and
+ * shifts. Every edge on a wire is moved by up to +/-jitter, every node gets
+ * a random clock deviation of up to +/-skew. Like the badge it knows only
+ * what the wire tells it: bytes that are overwritten before the main loop
+ * takes them, bits that are read wrong and slaves that time out back into
+ * MASTER mode all show up.
+ *
+ * Reported: throughput of the chain, latency per hop (start of the byte
+ * upstream -> column shown), the lag of the wall (column on the master ->
+ * column on the last display), errors per hop. The own eeprom of the slaves
+ * is taken as empty, a slave that times out shows a stale column, nothing
+ * else.
+ *
+ * The chain is cut in segments, one thread each. Time goes in windows: in
+ * step s thread k simulates window s-k of its segment, the edges of window
+ * s-k-1 of its upstream segment are complete by then. --shm publishes the
+ * whole wall at the end of every window.
+ */
+
+#define MAXTHREADS      (256)
+#define LINKSIZE        (1 << 13)   // edges in flight per wire, > 2 windows
+#define MAXCOLUMNS      (1 << 22)   // master columns tracked for the lag
+
+#define MASTER          0           // enum MODES of blinken.c
+#define SLAVE           1
+
+
+char *program_name = "blinkenwall";
+
+char *input, *textfile, *picture, *shmname;
+
+int quiet = TRUE, showhops = FALSE;
+int nodes = 50;             // displays, incl. the master
+int threads = 0;            // 0: one per cpu
+double jitter = 2;          // us, max edge displacement (uniform +/-)
+double skew = 1;            // %, clock deviation per node (+/-)
+unsigned seed = 1;
+double limit = 60;          // s of simulated time at most
+int window = 400;           // ticks per step
+int loops = 1;
+double hold = 2;
+double powerup = 0;         // ms the master is switched on after the slaves
+
+const struct bl_profile *prof;
+
+
+// a level change on a wire, w/ the byte it belongs to (for the statistics)
+struct edge {
+    int64_t t;                      // ns
+    uint8_t level;
+    uint8_t start;                  // first edge of a byte
+    uint8_t value;                  // the byte sent
+    int32_t origin;                 // master column it carries, -1: none
+};
+
+// one producer, one consumer
+struct link {
+    struct edge e[LINKSIZE];
+    uint32_t head;                  // written by the producer
+    uint32_t tail;                  // consumer only
+};
+
+struct node {
+    int id;
+    int64_t period, phase;          // ns of the ISR clock
+    uint64_t n;                     // next ISR call
+    unsigned rnd;
+
+    // ISR, same names as in blinken.c
+    uint8_t lastRead, rxBuff, rxDone;
+    uint16_t comctr;
+    int8_t bitpos;
+    uint8_t bitmask;
+    int mode;
+    int prog;                       // went into PROG mode at boot (input low)
+
+    // the byte on the input wire and the one rxDone was set for
+    uint8_t curValue, rxValue;
+    int32_t curOrigin, rxOrigin;
+    int64_t curStart, rxStart;
+
+    // main loop: busy in transmit() until tick busyUntil
+    int busy;
+    uint64_t busyUntil;
+    uint8_t chr;
+    int32_t chrOrigin;
+    int64_t chrStart;
+    int64_t lastEdge;
+    uint8_t level;                  // input pin
+    int wasSlave;
+
+    uint8_t buff[8];
+    int32_t org[8];
+
+    struct link *in, *out;
+
+    // statistics
+    long tx, rx, overrun, corrupt, timeouts, shown;
+    long idle;                      // timeouts w/o a byte after them: the chain is done
+    int64_t latSum, latMax;
+    int64_t firstShown, lastShown;
+};
+
+struct node *chain;
+struct link *links;
+
+// master
+struct bl_player pl;
+struct bl_frame next;
+int havenext;
+int32_t mcols;                      // columns shown on the master
+int64_t *coltime;                   // ns each master column was shown
+int32_t morg[8];
+int64_t mend;                       // ns the playlist ended, 0: still playing
+
+// last display
+long lagN;
+int64_t lagSum, lagMax;
+
+// run
+int64_t windowNs, endNs;
+int steps, nwindows, nseg;
+int segFirst[MAXTHREADS + 1];
+pthread_barrier_t barrier;
+uint8_t *walls;                     // snapshots of the wall, one per window of the last steps
+struct bl_display *shm;
+
+void readInput (void);
+void simulate (void);
+void report (double);
+
+void info(char *);
+
+
+////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+
+    program_name = argv[0];
+    prof = bl_profile(NULL);
+
+    // while args left..
+    int a = 1; int last_a = 1;
+    do {
+        last_a = a;
+        // two args
+        if (a+1 < argc) {
+
+            // eeprom image of the master
+            if (!strcmp (argv[a], "-i")) {
+                input = argv[a+1];
+                a += 2;
+
+            // cleartext for the master
+            } else if (!strcmp (argv[a], "-t")) {
+                textfile = argv[a+1];
+                a += 2;
+
+            } else if (!strcmp (argv[a], "-p")) {
+                picture = argv[a+1];
+                a += 2;
+
+            // master: passes per message, halt
+            } else if (!strcmp (argv[a], "-n")) {
+                loops = atoi(argv[a+1]);
+                a += 2;
+            } else if (!strcmp (argv[a], "-H")) {
+                hold = atof(argv[a+1]);
+                a += 2;
+
+            // displays in the chain
+            } else if (!strcmp (argv[a], "-N")) {
+                nodes = atoi(argv[a+1]);
+                a += 2;
+
+            // link: jitter, skew, seed (as linktest)
+            } else if (!strcmp (argv[a], "-j")) {
+                jitter = atof(argv[a+1]);
+                a += 2;
+            } else if (!strcmp (argv[a], "-s")) {
+                skew = atof(argv[a+1]);
+                a += 2;
+            } else if (!strcmp (argv[a], "-r")) {
+                seed = atoi(argv[a+1]);
+                a += 2;
+
+            // master switched on later
+            } else if (!strcmp (argv[a], "-b")) {
+                powerup = atof(argv[a+1]);
+                a += 2;
+
+            } else if (!strcmp (argv[a], "-T")) {
+                limit = atof(argv[a+1]);
+                a += 2;
+
+            } else if (!strcmp (argv[a], "-W")) {
+                window = atoi(argv[a+1]);
+                a += 2;
+
+            } else if (!strcmp (argv[a], "--threads")) {
+                threads = atoi(argv[a+1]);
+                a += 2;
+
+            // virtual display
+            } else if (!strcmp (argv[a], "--shm")) {
+                shmname = argv[a+1];
+                a += 2;
+
+            // device profile
+            } else if (!strcmp (argv[a], "--profile")) {
+                prof = bl_profile(argv[a+1]);
+                if (prof == NULL) {
+                    fprintf (stderr, "%s: unknown profile %s, see --help\n", program_name, argv[a+1]);
+                    exit (EXIT_FAILURE);
+                }
+                a += 2;
+            }
+        }
+
+        // one arg (a may have changed)
+        if (a < argc) {
+
+            if (!strcmp (argv[a], "--hops")) {
+                showhops = TRUE;
+                a++;
+
+            // verbose
+            } else if (!strcmp (argv[a], "--verbose")) {
+                quiet = FALSE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--help")) {
+                fprintf (stdout, "\nSimulate a chain of blinken64 displays at the level of the pulse link.\n");
+                fprintf (stdout, "\nUsage: %s (-i image | -t text [-p picture]) [-N nodes] [-j us] [-s %%] [-r seed] [-b ms] [-T s]\n", program_name);
+                fprintf (stdout, "                  [--threads n] [-W ticks] [--shm name] [--hops] [--profile name] [-n loops] [-H s]\n");
+                fprintf (stdout, "\n    -i image         eeprom image of the master (textconv output)");
+                fprintf (stdout, "\n    -t text          cleartext for the master, converted like textconv does");
+                fprintf (stdout, "\n    -p picture       eeprom pictures for -t");
+                fprintf (stdout, "\n   --profile name    device profile of the master");
+                fprintf (stdout, "\n    -n loops         master: passes per message (default %d)", loops);
+                fprintf (stdout, "\n    -H s             master: button pressed this long after a halt (default %g)", hold);
+                fprintf (stdout, "\n    -N nodes         displays in the chain, incl. the master (default %d)", nodes);
+                fprintf (stdout, "\n    -j us            max jitter per edge (default %g)", jitter);
+                fprintf (stdout, "\n    -s %%             max clock deviation per node (default %g)", skew);
+                fprintf (stdout, "\n    -r seed          random seed (default %u)", seed);
+                fprintf (stdout, "\n    -b ms            master switched on after the slaves (default %g: all at once)", powerup);
+                fprintf (stdout, "\n    -T s             simulated time at most (default %g)", limit);
+                fprintf (stdout, "\n   --threads n       worker threads (default: one per cpu)");
+                fprintf (stdout, "\n    -W ticks         ISR ticks per step (default %d)", window);
+                fprintf (stdout, "\n   --shm name        publish the wall on the virtual display name, once per step");
+                fprintf (stdout, "\n   --hops            statistics of every hop");
+                fprintf (stdout, "\n   --verbose         print log on stdout\n\n");
+
+                exit (EXIT_SUCCESS);
+            }
+        }
+
+    } while ( (a < argc) && (a != last_a) );
+
+    if ((input == NULL) == (textfile == NULL)) {
+        fprintf (stderr, "%s: need an image (-i) or a text (-t) for the master, see --help\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+    if (nodes < 2) { nodes = 2; }
+    if (window < 40) { window = 40; }
+    if (window > 4000) { window = 4000; }
+    if (threads <= 0) { threads = sysconf(_SC_NPROCESSORS_ONLN); }
+    if (threads > MAXTHREADS) { threads = MAXTHREADS; }
+    if (threads > nodes - 1) { threads = nodes - 1; }
+
+    readInput();
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    simulate();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    report((t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+
+    exit (EXIT_SUCCESS);
+}
+
+
+void info (char * str) {
+    if (!quiet) {
+        fprintf(stdout,"\n%s",str);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+void readInput () {
+
+    static char text[BL_MAXINPUT];
+    static struct bl_pictures pics;
+    static struct bl_image img;
+    uint8_t image[BL_MAXEEPROM];
+    FILE *f;
+    int len;
+
+    if (input != NULL) {
+        len = bl_read_image(input, image, sizeof(image));
+        if (len < 0 || len > prof->eeprom) {
+            fprintf (stderr, "%s: %s is no eeprom image for %s\n", program_name, input, prof->name);
+            exit (EXIT_FAILURE);
+        }
+        bl_player_init(&pl, image, len, prof);
+
+    } else {
+        if (picture != NULL && bl_read_pictures(picture, &pics) < 0) {
+            fprintf (stderr, "%s: %s is no pgm/pbm of at least 8 rows\n", program_name, picture);
+            exit (EXIT_FAILURE);
+        }
+        f = fopen(textfile, "r");
+        if (f == NULL) {
+            fprintf (stderr, "%s: can not open %s\n", program_name, textfile);
+            exit (EXIT_FAILURE);
+        }
+        len = fread(text, 1, sizeof(text), f);
+        fclose(f);
+        if (bl_convert(text, len, &pics, prof, BL_EE, &img)) {
+            fprintf (stderr, "%s: %s does not fit in the eeprom of %s\n", program_name, textfile, prof->name);
+            exit (EXIT_FAILURE);
+        }
+        bl_player_init(&pl, img.data, img.size, prof);
+    }
+    pl.loops = loops;
+    pl.hold = hold * 1000000 / BL_TICK_US;
+}
+
+
+double rnd (unsigned *r) { return (double)rand_r(r) / RAND_MAX; }
+
+
+// ns of ISR call n
+int64_t tickTime (struct node *nd, uint64_t n) { return nd->phase + (int64_t)n * nd->period; }
+
+
+void push (struct link *l, struct edge *e) {
+    uint32_t h = l->head;
+    while (h - __atomic_load_n(&l->tail, __ATOMIC_ACQUIRE) >= LINKSIZE) { sched_yield(); }
+    l->e[h % LINKSIZE] = *e;
+    __atomic_store_n(&l->head, h + 1, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * transmit(): HI-LO start edge, a pulse per bit (delay() counts ISR calls
+ * of the sender), stop edge after COM_T_BIT/2. the edges but the first get
+ * the jitter, they stay in order. returns the ISR calls it takes
+ */
+int transmit (struct node *nd, uint64_t n, uint8_t b, int32_t origin) {
+
+    struct edge e = { 0, 0, 1, b, origin };
+    int ticks = 0, i;
+    int64_t t;
+
+    e.t = tickTime(nd, n);
+    if (e.t < nd->lastEdge) { e.t = nd->lastEdge; }
+    nd->lastEdge = e.t;
+    if (nd->out != NULL) { push(nd->out, &e); }
+    e.start = 0;
+
+    for (i=0; i<=8; i++) {
+        ticks += i < 8 ? ((b & (1 << i)) ? COM_T_HIGH : COM_T_LOW) : COM_T_BIT/2;
+        e.level = i < 8 ? !e.level : 1;
+        t = tickTime(nd, n + ticks) + jitter * 1000 * (2*rnd(&nd->rnd) - 1);
+        if (t < nd->lastEdge) { t = nd->lastEdge; }
+        e.t = nd->lastEdge = t;
+        if (nd->out != NULL) { push(nd->out, &e); }
+    }
+    nd->tx++;
+    return ticks;
+}
+
+
+// one ISR call, the receiving part of blinken.c (w/o _FRAME_CHECK_, _AUTOBAUD_)
+void isr (struct node *nd, uint8_t read) {
+
+    if (nd->lastRead != read) {
+
+        if (nd->comctr <= COM_T_DEBOUNCE) {
+            nd->comctr = 0;
+            nd->bitpos = -1;
+            nd->rxBuff = 0;
+        }
+
+        if (nd->bitpos == -1) {
+            if (!read) {
+                nd->bitpos = 0;
+                nd->bitmask = 1;
+            }
+
+        } else if (nd->bitpos < 8) {
+            if (nd->comctr < COM_T_BIT) {
+                nd->rxBuff &= ~nd->bitmask;
+                nd->bitpos++;
+                nd->bitmask <<= 1;
+            } else if (nd->comctr < 2*COM_T_BIT) {
+                nd->rxBuff |= nd->bitmask;
+                nd->bitpos++;
+                nd->bitmask <<= 1;
+            } else if (nd->bitpos < 7 && nd->mode == MASTER) {
+                nd->bitpos = -1;        // the button
+            }
+
+            if (nd->bitpos == 8) {
+                if (nd->rxDone) { nd->overrun++; }
+                nd->rxDone = 1;
+                nd->rxValue = nd->curValue;
+                nd->rxOrigin = nd->curOrigin;
+                nd->rxStart = nd->curStart;
+            }
+            if (nd->mode == MASTER && nd->bitpos == 1) { nd->mode = SLAVE; }
+
+        } else {
+            nd->bitpos = -1;
+        }
+
+        nd->lastRead = read;
+        nd->comctr = 0;
+
+    } else {
+        if (++nd->comctr >= COM_T_TIMEOUT) {
+            nd->comctr = 0;
+            nd->bitpos = -1;
+            if (nd->mode == SLAVE) { nd->mode = MASTER; nd->idle++; }
+        }
+    }
+}
+
+
+// the column is shown: shift, like the scroll loop of blinken.c
+void shift (struct node *nd, int64_t t) {
+    int j;
+    for (j=7; j>0; j--) { nd->buff[j] = nd->buff[j-1]; nd->org[j] = nd->org[j-1]; }
+    nd->buff[0] = nd->chr;
+    nd->org[0] = nd->chrOrigin;
+    if (!nd->shown++) { nd->firstShown = t; }
+    nd->lastShown = t;
+
+    if (nd->chrStart >= 0) {
+        int64_t l = t - nd->chrStart;
+        nd->latSum += l;
+        if (l > nd->latMax) { nd->latMax = l; }
+    }
+    if (nd->id == nodes-1 && nd->chrOrigin >= 0 && nd->chrOrigin < MAXCOLUMNS) {
+        int64_t l = t - coltime[nd->chrOrigin];
+        lagN++;
+        lagSum += l;
+        if (l > lagMax) { lagMax = l; }
+    }
+}
+
+
+// a slave up to the end of the window
+void runNode (struct node *nd, int64_t wend) {
+
+    struct link *in = nd->in;
+    int64_t t;
+
+    while ((t = tickTime(nd, nd->n)) < wend) {
+
+        // the input pin
+        while (in->tail != __atomic_load_n(&in->head, __ATOMIC_ACQUIRE) && in->e[in->tail % LINKSIZE].t <= t) {
+            struct edge *e = &in->e[in->tail % LINKSIZE];
+            if (e->start) {
+                nd->curValue = e->value;
+                nd->curOrigin = e->origin;
+                nd->curStart = e->t;
+            }
+            nd->level = e->level;
+            __atomic_store_n(&in->tail, in->tail + 1, __ATOMIC_RELEASE);
+        }
+
+        isr(nd, nd->level);
+
+        // delay(15000) of main(): the ISR is running already. input low at
+        // the end -> programmer attached, PROG mode: the rest of the chain stays dark
+        if (nd->n < BL_BOOT_TICKS || nd->prog) {
+            if (nd->n + 1 == BL_BOOT_TICKS && !nd->level) {
+                nd->prog = 1;
+                nd->mode = MASTER;
+            }
+            if (nd->prog) { nd->rxDone = 0; }     // into the eeprom
+            nd->n++;
+            continue;
+        }
+
+        // transmit() done
+        if (nd->busy && nd->n >= nd->busyUntil) {
+            nd->busy = 0;
+            shift(nd, t);
+        }
+
+        // SLAVE waits for a new column to come in (a timeout leaves it w/ the old rxBuff)
+        if (!nd->busy && nd->mode == SLAVE && nd->rxDone) {
+            nd->chr = nd->rxBuff;
+            nd->chrOrigin = nd->rxOrigin;
+            nd->chrStart = nd->rxStart;
+            nd->rxDone = 0;
+            nd->rx++;
+            nd->timeouts += nd->idle;
+            nd->idle = 0;
+            if (nd->chr != nd->rxValue) { nd->corrupt++; nd->chrOrigin = -1; }
+            nd->busy = 1;
+            nd->busyUntil = nd->n + transmit(nd, nd->n, nd->buff[7], nd->org[7]);
+        } else if (!nd->busy && nd->wasSlave && nd->mode == MASTER) {
+            nd->chr = nd->rxBuff;
+            nd->chrOrigin = -1;
+            nd->chrStart = -1;
+            nd->busy = 1;
+            nd->busyUntil = nd->n + transmit(nd, nd->n, nd->buff[7], nd->org[7]);
+        }
+        nd->wasSlave = nd->mode == SLAVE;
+
+        nd->n++;
+    }
+}
+
+
+// the master: the columns of the player up to the end of the window
+void runMaster (int64_t wend) {
+
+    struct node *m = &chain[0];
+    int j;
+
+    while (havenext && tickTime(m, next.txtick) < wend) {
+        if (next.sent >= 0) {
+            transmit(m, next.txtick, next.sent, morg[7]);
+        }
+        for (j=7; j>0; j--) { morg[j] = morg[j-1]; }
+        morg[0] = mcols < MAXCOLUMNS ? mcols : -1;
+        if (mcols < MAXCOLUMNS) { coltime[mcols] = tickTime(m, next.tick); }
+        mcols++;
+        memcpy(m->buff, next.buff, 8);
+        m->shown++;
+
+        havenext = bl_player_next(&pl, &next);
+        if (!havenext) { mend = tickTime(m, pl.tick); }
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+int newWindows;                     // set by the master thread once the playlist is over
+
+// the wall at the end of window w to the virtual display
+void publish (int w) {
+    if (shm != NULL && w >= 0) {
+        uint8_t *wall = walls + (size_t)(w % (nseg + 1)) * nodes * 8;
+        bl_display_publish(shm, wall, (int64_t)(w + 1) * window, 0);
+    }
+}
+
+
+void *worker (void *arg) {
+
+    int k = (intptr_t)arg, s, i;
+
+    for (s=0; s<steps; s++) {
+        int w = s - k;
+
+        if (w >= 0 && w < nwindows) {
+            int64_t wend = (int64_t)(w + 1) * windowNs;
+            uint8_t *wall = walls + (size_t)(w % (nseg + 1)) * nodes * 8;
+
+            if (k == 0) {
+                runMaster(wend);
+                memcpy(wall, chain[0].buff, 8);
+                // the last bytes still have to get through the chain, a hop is a byte or two
+                if (!havenext && newWindows == 0) {
+                    newWindows = (mend + 100000000 + (int64_t)nodes * 20000000) / windowNs + 1;
+                    if (newWindows < w + 1) { newWindows = w + 1; }
+                }
+            }
+            for (i=segFirst[k]; i<segFirst[k+1]; i++) {
+                runNode(&chain[i], wend);
+                memcpy(wall + 8*i, chain[i].buff, 8);
+            }
+        }
+
+        if (pthread_barrier_wait(&barrier) == PTHREAD_BARRIER_SERIAL_THREAD) {
+            publish(s - (nseg - 1));
+            if (newWindows && newWindows < nwindows) {
+                nwindows = newWindows;
+                steps = nwindows + nseg - 1;
+            }
+        }
+        pthread_barrier_wait(&barrier);
+    }
+    return NULL;
+}
+
+
+void simulate () {
+
+    pthread_t tid[MAXTHREADS];
+    unsigned r = seed;
+    int i, k;
+
+    chain = calloc(nodes, sizeof(*chain));
+    links = calloc(nodes - 1, sizeof(*links));
+    coltime = calloc(MAXCOLUMNS, sizeof(*coltime));
+    if (chain == NULL || links == NULL || coltime == NULL) {
+        fprintf (stderr, "%s: out of memory\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+
+    // clocks: the same for a seed, whatever the number of threads
+    for (i=0; i<nodes; i++) {
+        struct node *nd = &chain[i];
+        nd->id = i;
+        nd->rnd = seed * 7919 + i;
+        nd->period = 1000.0 * BL_TICK_US * (1.0 + skew/100.0 * (2*rnd(&r) - 1));
+        nd->phase = rnd(&r) * nd->period + (i == 0 ? powerup * 1e6 : 0);
+        nd->bitpos = -1;
+        nd->level = 1;
+        nd->mode = MASTER;
+        nd->chrStart = -1;
+        for (k=0; k<8; k++) { nd->org[k] = -1; }
+        if (i > 0) { nd->in = &links[i-1]; }
+        if (i < nodes-1) { nd->out = &links[i]; }
+    }
+    for (k=0; k<8; k++) { morg[k] = -1; }
+    havenext = bl_player_next(&pl, &next);
+
+    // segments of about the same size
+    nseg = threads;
+    for (k=0; k<=nseg; k++) { segFirst[k] = 1 + (long)(nodes - 1) * k / nseg; }
+
+    windowNs = (int64_t)window * BL_TICK_US * 1000;
+    nwindows = (int64_t)((limit + (double)BL_BOOT_TICKS * BL_TICK_US / 1e6) * 1e9) / windowNs + 1;
+    steps = nwindows + nseg - 1;
+
+    walls = calloc((size_t)(nseg + 1) * nodes, 8);
+    if (shmname != NULL) {
+        shm = bl_display_create(shmname, nodes * 8, 256);
+        if (shm == NULL) {
+            fprintf (stderr, "%s: can not create the virtual display %s: %s\n", program_name, shmname, strerror(errno));
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    info ("simulating");
+
+    pthread_barrier_init(&barrier, NULL, nseg);
+    for (k=0; k<nseg; k++) {
+        pthread_create(&tid[k], NULL, worker, (void *)(intptr_t)k);
+    }
+    for (k=0; k<nseg; k++) {
+        pthread_join(tid[k], NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+
+    bl_display_close(shm);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+void report (double took) {
+
+    long overrun = 0, corrupt = 0, lost = 0, timeouts = 0, prog = 0, rx = 0, calls = 0, idle = 0;
+    int64_t latSum = 0, latMax = 0;
+    int bad = 0, firstbad = 0, i;
+    double simulated = (double)nwindows * windowNs / 1e9;
+    struct node *last = &chain[nodes-1];
+
+    if (showhops) {
+        fprintf (stdout, " hop       sent   received  overruns  corrupt     lost  timeouts  latency avg/max [ms]\n");
+    }
+
+    for (i=1; i<nodes; i++) {
+        struct node *nd = &chain[i];
+        long l = chain[i-1].tx - nd->rx - nd->overrun;
+        if (l < 0) { l = 0; }
+
+        rx += nd->rx;
+        overrun += nd->overrun;
+        corrupt += nd->corrupt;
+        lost += l;
+        timeouts += nd->timeouts;
+        idle += nd->idle;
+        prog += nd->prog;
+        latSum += nd->latSum;
+        if (nd->latMax > latMax) { latMax = nd->latMax; }
+        calls += nd->n;
+
+        if (nd->overrun || nd->corrupt || l > 1 || nd->timeouts || nd->prog) {
+            if (!bad++) { firstbad = i; }
+        }
+        if (showhops) {
+            fprintf (stdout, "%4d %10ld %10ld %9ld %8ld %8ld %9ld  %7.2f %7.2f%s\n", i,
+                     chain[i-1].tx, nd->rx, nd->overrun, nd->corrupt, l, nd->timeouts,
+                     nd->shown ? nd->latSum / 1e6 / nd->shown : 0, nd->latMax / 1e6,
+                     nd->prog ? "  PROG at boot" : "");
+        }
+    }
+
+    fprintf (stdout, "%d displays (master + %d), %d threads, jitter +/-%gus, skew +/-%g%%, seed %u\n",
+             nodes, nodes - 1, nseg, jitter, skew, seed);
+    fprintf (stdout, "simulated %.3f s in %.3f s, %.1fx real time, %.0f M ISR calls/s\n",
+             simulated, took, simulated / took, calls / took / 1e6);
+    fprintf (stdout, "master: %d columns%s\n", mcols, havenext ? " (playlist cut, see -T)" : "");
+    fprintf (stdout, "last display: %ld columns, %ld of them master columns, %.1f columns/s\n",
+             last->shown, lagN, last->shown > 1 ? (last->shown - 1) * 1e9 / (last->lastShown - last->firstShown) : 0);
+    if (lagN) {
+        fprintf (stdout, "lag of the wall: %.1f ms avg, %.1f ms max (%.2f ms per display)\n",
+                 lagSum / 1e6 / lagN, lagMax / 1e6, lagSum / 1e6 / lagN / (nodes - 1));
+    }
+    fprintf (stdout, "per hop: %.2f ms avg, %.2f ms max (byte starts upstream -> column shown)\n",
+             rx ? latSum / 1e6 / rx : 0, latMax / 1e6);
+    fprintf (stdout, "errors: %ld overruns, %ld corrupt, %ld lost, %ld timeouts, %ld PROG at boot",
+             overrun, corrupt, lost, timeouts, prog);
+    if (bad) {
+        fprintf (stdout, " - %d hops, the first is %d\n", bad, firstbad);
+    } else {
+        fprintf (stdout, "\n");
+    }
+    if (prog) {
+        fprintf (stdout, "PROG at boot: a byte was on the wire when the slave looked for a programmer, see -b\n");
+    }
+    if (idle) {
+        fprintf (stdout, "%ld slaves timed out after the last byte (back in MASTER mode, a stale column each)\n", idle);
+    }
+}
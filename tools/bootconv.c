@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "../firmware/bootloader.h"
+
+#define AUTHORS "Manuel Jerger"
+#define VERSION "0.1"
+
+#define TRUE ~(uint)0
+#define FALSE (uint)0
+
+
+#define BOOT_PAGES      (BOOTSTART / BOOT_PAGESIZE)
+
+// timing of the programmer (blinkenprog.pde), in us
+#define PROG_T_LOW      (560)       // refbit * 0.7
+#define PROG_T_HIGH     (1040)      // refbit * 1.3
+#define PROG_T_END      (400)       // refbit / 2
+#define PROG_T_GAP      (2000)      // bytegap
+
+// rough ISP (usbasp, avrdude defaults) reference, in us
+#define ISP_T_BYTE      (90)        // 4 spi bytes per flash byte @ 375kHz + usb overhead
+#define ISP_T_PAGE      (4500)      // page write
+#define ISP_T_SETUP     (2000000)   // avrdude start, signature, chip erase
+
+
+void info(char *);
+
+
+char *program_name = "bootconv";
+
+char *input, *output, *flashfile;
+
+int quiet = TRUE, repeat = 1, nodes = 1, handling = 30;
+
+uint8_t image[BOOTSTART];       // application image, padded w/ 0xFF
+int imagesize;                  // length of valid image
+
+uint8_t outb[1 << 16];          // resulting byte stream for the programmer
+int op = 0;
+long duration = 0;              // transfer time of outb, in us
+
+////////////////////////////////////////////////////////////////////////
+
+
+// same as _crc_xmodem_update() of avr-libc
+uint16_t crc_xmodem_update (uint16_t crc, uint8_t data) {
+    int i;
+    crc = crc ^ ((uint16_t)data << 8);
+    for (i=0; i<8; i++) {
+        if (crc & 0x8000) { crc = (crc << 1) ^ 0x1021; }
+        else              { crc <<= 1; }
+    }
+    return crc;
+}
+
+
+// append one byte to the output, keep track of the transfer time
+void emit (uint8_t b) {
+    int i;
+    outb[op++] = b;
+    for (i=0; i<8; i++) { duration += (b & (1<<i)) ? PROG_T_HIGH : PROG_T_LOW; }
+    duration += PROG_T_END + PROG_T_GAP;
+}
+
+
+// one page frame incl. init sequence and crc
+void emitPage (int p) {
+    int i;
+    uint16_t crc = crc_xmodem_update(0, p);
+
+    emit(0xAA); emit(0xAA); emit(BOOT_SYNC);
+    emit(p);
+    for (i=0; i<BOOT_PAGESIZE; i++) {
+        uint8_t b = image[p*BOOT_PAGESIZE + i];
+        crc = crc_xmodem_update(crc, b);
+        emit(b);
+    }
+    emit(crc & 0xFF);
+    emit(crc >> 8);
+
+    for (i=0; i<BOOT_PAD; i++) { emit(0xFF); }
+}
+
+
+// the image the way the bootloader leaves it in the flash (word 0 to the
+// bootloader, the trampoline to the reset handler), for ISP w/ the bootloader
+void patch (uint8_t *flash) {
+    uint16_t reset = image[0] | (image[1] << 8), w = 0xFFFF;
+
+    memcpy(flash, image, BOOTSTART);
+    flash[0] = RJMP(0, BOOTSTART/2) & 0xFF;
+    flash[1] = RJMP(0, BOOTSTART/2) >> 8;
+    if ((reset & 0xF000) == 0xC000) {        // rjmp k  ->  target k+1
+        w = RJMP(BOOT_TRAMPOLINE/2, (reset + 1) & 0x0FFF);
+    }
+    flash[BOOT_TRAMPOLINE]   = w & 0xFF;
+    flash[BOOT_TRAMPOLINE+1] = w >> 8;
+}
+
+
+// convert image to frames: page 0 and the trampoline page go last, so the
+// bootloader knows the reset vector when it writes the trampoline
+int convert () {
+    int p, r, n = 0;
+    int last = (imagesize + BOOT_PAGESIZE - 1) / BOOT_PAGESIZE;  // pages used
+
+    for (r=0; r<repeat; r++) {
+        n = 0;
+        for (p=1; p<last && p<BOOT_PAGES-1; p++) { emitPage(p); n++; }
+        emitPage(0); n++;
+        emitPage(BOOT_PAGES-1); n++;
+    }
+
+    uint16_t crc = crc_xmodem_update(crc_xmodem_update(0, BOOT_DONE), n);
+    emit(0xAA); emit(0xAA); emit(BOOT_SYNC);
+    emit(BOOT_DONE);
+    emit(n);
+    emit(crc & 0xFF);
+    emit(crc >> 8);
+
+    return op;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+
+    program_name = argv[0];
+
+    // while args left..
+    int a = 1; int last_a = 1;
+    do {
+        last_a = a;
+        // two args
+        if (a+1 < argc) {
+
+            // infile
+            if (!strcmp (argv[a], "-i")) {
+                input = argv[a+1];
+                a += 2;
+
+            // outfile
+            } else if (!strcmp (argv[a], "-o")) {
+                output = argv[a+1];
+                a += 2;
+
+            // patched image for ISP, in front of the bootloader
+            } else if (!strcmp (argv[a], "-f")) {
+                flashfile = argv[a+1];
+                a += 2;
+
+            // send image multiple times
+            } else if (!strcmp (argv[a], "-r")) {
+                repeat = atoi(argv[a+1]);
+                a += 2;
+
+            // displays in chain (for the time estimate)
+            } else if (!strcmp (argv[a], "-n")) {
+                nodes = atoi(argv[a+1]);
+                a += 2;
+
+            // seconds per board to clip the ISP on and off
+            } else if (!strcmp (argv[a], "-t")) {
+                handling = atoi(argv[a+1]);
+                a += 2;
+            }
+
+        }
+
+        // one arg (a may have changed)
+        if (a < argc) {
+
+            // verbose
+            if (!strcmp (argv[a], "--verbose")) {
+                quiet = FALSE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--help")) {
+                fprintf (stdout, "\nConvert a binary firmware image to blinken64 bootloader frames.\n");
+                fprintf (stdout, "\nUsage: %s -i infile -o outfile [-f flashfile] [-r n] [-n nodes] [-t sec] [--verbose]\n", program_name);
+                fprintf (stdout, "\n    -i infile        binary image (avr-objcopy -O binary)");
+                fprintf (stdout, "\n    -o outfile       byte stream for the programmer");
+                fprintf (stdout, "\n    -f flashfile     the image as the bootloader writes it, up to the bootloader (ISP)");
+                fprintf (stdout, "\n    -r n             send the image n times (lossy chains)");
+                fprintf (stdout, "\n    -n nodes         displays in chain, for the time estimate");
+                fprintf (stdout, "\n    -t sec           handling time per board for ISP, for the time estimate");
+                fprintf (stdout, "\n   --verbose         print err/log on stdout\n\n");
+
+                exit (EXIT_SUCCESS);
+            }
+        }
+
+    } while ( (a < argc) && (a != last_a) );
+
+    if (input == NULL || output == NULL) {
+        fprintf (stderr, "%s: need -i and -o, see --help\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+
+    // load image
+    FILE* f;
+    memset(image, 0xFF, sizeof(image));
+
+    info ("reading image");
+    f = fopen(input, "rb");
+    if (f == NULL) {
+        fprintf (stderr, "%s: can not open %s\n", program_name, input);
+        exit (EXIT_FAILURE);
+    }
+    imagesize = fread(image, 1, sizeof(image), f);
+    if (fgetc(f) != EOF || imagesize > BOOT_TRAMPOLINE) {
+        fprintf (stderr, "%s: image too big, %d bytes below the bootloader available\n", program_name, BOOT_TRAMPOLINE);
+        fclose(f);
+        exit (EXIT_FAILURE);
+    }
+    fclose(f);
+
+    int len = convert();
+
+    info ("dumping output to file");
+    f = fopen(output, "wb");
+    fwrite(outb, 1, len, f);
+    fclose(f);
+
+    if (flashfile) {
+        uint8_t flash[BOOTSTART];
+        patch(flash);
+        f = fopen(flashfile, "wb");
+        if (f == NULL) {
+            fprintf (stderr, "%s: can not open %s\n", program_name, flashfile);
+            exit (EXIT_FAILURE);
+        }
+        fwrite(flash, 1, sizeof(flash), f);
+        fclose(f);
+    }
+
+    // time estimate: the whole chain is programmed at once (the bootloader
+    // mirrors its input), ISP needs every board on its own
+    long isp = ISP_T_SETUP + (long)imagesize * ISP_T_BYTE * 2                  // write + verify
+             + (long)((imagesize + BOOT_PAGESIZE - 1) / BOOT_PAGESIZE) * ISP_T_PAGE;
+
+    fprintf (stdout, "%d byte image, %d byte stream\n", imagesize, len);
+    fprintf (stdout, "bootloader : %6.1f s for %d display(s)\n", duration / 1e6, nodes);
+    fprintf (stdout, "ISP        : %6.1f s for %d display(s) (%.1f s/board + %d s handling)\n",
+             nodes * (isp / 1e6 + handling), nodes, isp / 1e6, handling);
+
+    exit (EXIT_SUCCESS);
+}
+
+
+
+void info (char * str) {
+    if (!quiet) {
+        fprintf(stdout,"\n%s",str);
+    }
+}
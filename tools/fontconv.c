@@ -1,6 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "pnm.h"
+
+#ifdef HAVE_FREETYPE
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#endif
 
 
 #define BLACK 0
@@ -14,121 +23,503 @@ int rawData[256][8][8];
 int vpos[256][3];   // minleft, width, maxright
 int exists[256];      // 0 = char does not exist
 int firstchar=0xffff,lastchar=0;
-char *infile;
+int rawfont = 0;    // --raw: plain columns in font[], no dictionary
+int packfont = 0;   // --packed: the packed font, even if its decoder costs more than it saves
+char *subsetfile;   // --subset: only the chars in this file (textconv --glyphs)
+int origchar[256];  // code in the full font, for the comments
+int ttfsize = 0;    // --size: pixel size of ttf fonts, 0: the largest one the caps fit in
+
+
+/*
+ * the fonts as the firmware gets them: the glyphs of every font from its
+ * firstchar to its lastchar (width 0 for the missing ones), one font
+ * after the other. The firmware selects a font w/ a control code and
+ * finds a char by its glyph number fontbase[font] + char - fontfirst[font]
+ */
+#define MAXFONTS    9
+#define MAXGLYPHS   (MAXFONTS*256)
+
+int nfonts, nglyphs;
+char *fontfile[MAXFONTS];
+int fontfirst[MAXFONTS], fontlast[MAXFONTS], fontbase[MAXFONTS];
 
+int glyphcols[MAXGLYPHS][8];
+int glyphwidth[MAXGLYPHS];
+int glyphexists[MAXGLYPHS];
+int glyphchar[MAXGLYPHS];   // code in the full font
 
 
+
+// 16x16 chars of 8x8 pixels, black is set. a smaller sheet has empty chars at the end
 void readPicture (char* fileName) { 
-    FILE* f;
-    char s[60];
-    char c;
+    struct bl_pnm img;
     int i,j; 
-    int maxgrey;
 
     printf("\nReading picture  %s... \n",fileName);
-    f = fopen(fileName,"r");  
-
-    fscanf(f,"%s", s);  // pgm descriptor
-    
-    fscanf(f,"%c",&c);  // newline
-    
-    fscanf(f,"%c",&c);  // sharp or number
-    if (c == '#') {
-        do {
-            fscanf(f,"%c",&c);
-        } while (c != '\n');  // skip line
-    } else {
-		ungetc(c, f); // in the line was no comment. So we push back the char c
-	}
-    
-    fscanf(f,"%d %d", &width, &height);
-
+    if (bl_pnm_read(fileName, &img) < 0) {
+        printf("\nError: %s: %s\n", fileName, img.err);
+        exit(1);
+    }
+    width = img.width;
+    height = img.height;
     if (width != 128 || height != 128) {
-      printf("\nError: picture dimensions do not match 128*128 pixels");
+      printf("\nWarning: picture dimensions do not match 128*128 pixels");
     }
 
-    fscanf(f,"%d\n",&maxgrey); 
-
     for (j = 0; j < 128; ++j) {
         for (i = 0; i < 128; ++i) {
-            fscanf(f,"%d ", &(input[i][j])); 
+            input[i][j] = i < width && j < height && img.pix[j*width + i] <= img.thresh ? 0 : 255;
         }
     }
 
-    fclose (f);
+    bl_pnm_free(&img);
+}
+
+
+#ifdef HAVE_FREETYPE
+// unicode of the font chars past ascii, see bl_utf8() (Ö and ö are the same char there, Ü and ü too)
+int ttfChar (int c) {
+    switch (c) {
+        case 128 : return 0x20AC;   // €
+        case 129 : return 0xC4;     // Ä
+        case 130 : return 0xF6;     // ö
+        case 131 : return 0xFC;     // ü
+        case 132 : return 0xDF;     // ß
+        case 133 : return 0xE4;     // ä
+    }
+    return c < 127 ? c : 0;
+}
+
+
+// rows of a glyph above the baseline at pixel size s
+int ttfTop (FT_Face face, int s) {
+    const char *caps = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    int top = 0;
+
+    FT_Set_Pixel_Sizes(face, 0, s);
+    for (; *caps; caps++) {
+        if (FT_Load_Char(face, *caps, FT_LOAD_RENDER | FT_LOAD_TARGET_MONO)) { continue; }
+        if (face->glyph->bitmap_top > top) { top = face->glyph->bitmap_top; }
+    }
+    return top;
+}
+
+
+/*
+ * rasterize a ttf like the font sheet looks: 7 rows above the baseline,
+ * one below (descenders are cut there), at most 8 columns per char,
+ * proportional. Pixels that do not fit are counted
+ */
+void readTTF (char* fileName) {
+    FT_Library lib;
+    FT_Face face;
+    int c, x, y, s = ttfsize, clipped = 0;
+
+    printf("\nRasterizing  %s... \n",fileName);
+    if (FT_Init_FreeType(&lib) || FT_New_Face(lib, fileName, 0, &face)) {
+        printf("\nError: can not read %s\n", fileName);
+        exit(1);
+    }
+
+    if (s == 0) {
+        for (s = 16; s > 4 && ttfTop(face, s) > 7; s--) { }
+    }
+    FT_Set_Pixel_Sizes(face, 0, s);
+
+    for (c = 0; c < 256; c++) {
+        int minleft = 8, maxright = -1;
+
+        for (y = 0; y < 8; y++) { for (x = 0; x < 8; x++) { rawData[c][y][x] = 1; } }
+        exists[c] = 0;
+        vpos[c][0] = vpos[c][1] = vpos[c][2] = 0;
+        origchar[c] = c;
+
+        if (c <= 32 || ttfChar(c) == 0 || FT_Get_Char_Index(face, ttfChar(c)) == 0) { continue; }
+        if (FT_Load_Char(face, ttfChar(c), FT_LOAD_RENDER | FT_LOAD_TARGET_MONO)) { continue; }
+
+        FT_Bitmap *b = &face->glyph->bitmap;
+        for (y = 0; y < (int)b->rows; y++) {
+            int row = 7 - face->glyph->bitmap_top + y;
+            for (x = 0; x < (int)b->width; x++) {
+                if (!(b->buffer[y*b->pitch + x/8] & (0x80 >> (x%8)))) { continue; }
+                if (row < 0 || row > 7 || x > 7) { clipped++; continue; }
+                rawData[c][row][x] = 0;
+                if (x < minleft) { minleft = x; }
+                if (x > maxright) { maxright = x; }
+            }
+        }
+
+        if (maxright >= 0) {
+            exists[c] = 1;
+            vpos[c][0] = minleft;
+            vpos[c][1] = maxright-minleft+1;
+            vpos[c][2] = maxright;
+            lastchar = c;
+            if (c < firstchar) { firstchar = c; }
+        }
+    }
+
+    printf("%d pixel, %d pixels cut off", s, clipped);
+    FT_Done_Face(face);
+    FT_Done_FreeType(lib);
+}
+#endif
+
+
+// glyphs of the font just read
+void collect (char *fileName) {
+    int c, k, l, g;
+
+    if (nfonts == MAXFONTS) {
+        printf("\nError: more than %d fonts\n", MAXFONTS);
+        exit(1);
+    }
+    if (firstchar > lastchar) { firstchar = lastchar = 33; }    // empty font
+
+    fontfile[nfonts] = fileName;
+    fontfirst[nfonts] = firstchar;
+    fontlast[nfonts] = lastchar;
+    fontbase[nfonts] = nglyphs;
+    nfonts++;
+
+    for (c=firstchar; c<=lastchar; ++c) {
+        g = nglyphs++;
+        glyphexists[g] = exists[c];
+        glyphchar[g] = origchar[c];
+        glyphwidth[g] = exists[c] ? vpos[c][1] : 0;
+        for (k = 0; k < glyphwidth[g]; k++) {
+            int b = 0;
+            for (l = 7; l >= 0; --l) {
+                if (rawData[c][l][vpos[c][0]+k] == 0) { b |= (1<<l); }
+            }
+            glyphcols[g][k] = b;
+        }
+    }
+}
+
+
+/*
+ * packed font: every column is a code of FONT_BITS bits, an index into
+ * fontdict[] (the most frequent columns), or FONT_ESC followed by the
+ * column itself (8 bits). Instead of the width, the half-byte per char
+ * (shapes[]) is an index into fontshape[]: width | escaped columns << 4,
+ * so the firmware seeks the bit position the way it sums the widths.
+ * The code length is the one that gives the smallest font w/ at most 16
+ * shapes.
+ *
+ * Both formats have the position of every FONT_BLOCK'th glyph in
+ * fontblk[] (the column in font[], the bit in fontcode[]): a char is
+ * found from there, after at most FONT_BLOCK-1 half-bytes, in any font.
+ */
+#define FONT_BLOCK  8
+
+/*
+ * flash the packed decoder in the firmware takes more than the plain copy:
+ * fontbits() inlined twice, the fontshape[] lookup, the bit position
+ * (avr-gcc -Os, est.; make footprint builds both). Less saved than that,
+ * the plain font is written
+ */
+#define DECODER_SIZE 140
+
+int decoder = DECODER_SIZE;     // --decoder
+
+int freq[256], dict[256], dictlen, codebits;
+int dictidx[256];     // column -> code, -1: escaped
+int shape[16], nshapes;
+int shapeidx[MAXGLYPHS];    // glyph -> index into shape[]
+
+int escapes (int g) {
+    int k, e = 0;
+    for (k = 0; k < glyphwidth[g]; k++) { if (dictidx[glyphcols[g][k]] < 0) { e++; } }
+    return e;
+}
+
+void buildDict (int n) {
+    int i, j, b;
+    int order[256];
+    for (i=0; i<256; i++) { order[i] = i; dictidx[i] = -1; }
+    // most frequent first, equal ones by value
+    for (i=0; i<256; i++) {
+        for (j=i+1; j<256; j++) {
+            if (freq[order[j]] > freq[order[i]]) { b = order[i]; order[i] = order[j]; order[j] = b; }
+        }
+    }
+    dictlen = 0;
+    for (i=0; i<(1<<n)-1 && freq[order[i]] > 0; i++) {
+        dict[dictlen] = order[i];
+        dictidx[order[i]] = dictlen++;
+    }
+}
+
+// bytes of the packed font w/ n bit codes (w/o shapes[], fontblk[]), 0: more than 16 shapes
+int packedSize (int n) {
+    int g, i, s, bits = 0;
+    buildDict(n);
+    nshapes = 0;
+    for (g=0; g<nglyphs; ++g) {
+        s = glyphwidth[g] | (escapes(g) << 4);
+        for (i=0; i<nshapes && shape[i] != s; i++) { }
+        if (i == nshapes) {
+            if (nshapes == 16) { return 0; }
+            shape[nshapes++] = s;
+        }
+        shapeidx[g] = i;
+        bits += glyphwidth[g] * n + escapes(g) * 8;
+    }
+    return dictlen + (bits+7)/8 + 1 + nshapes;
+}
+
+
+// msb first
+uint8_t stream[MAXGLYPHS*8*2];
+int streambits;
+
+void putBits (int v, int n) {
+    int i;
+    for (i=n-1; i>=0; i--) {
+        if ((v >> i) & 1) { stream[streambits>>3] |= 0x80 >> (streambits & 7); }
+        streambits++;
+    }
+}
+
+
+/*
+ * cycles for loading a char into chr[], estimated for avr-gcc -Os: the
+ * font tables and fontblk[], the half-byte lookup per glyph walked (+ the
+ * fontshape[] lookup and the bit position), the copy or the code read per
+ * column (fontbits(): two lpm, the shifts), a dictionary lookup
+ */
+#define CYC_BLOCK   30
+#define CYC_WIDTH   14
+#define CYC_SHAPE   12
+#define CYC_COPY    8
+#define CYC_CODE    45
+#define CYC_DICT    7
+
+void decodeCost () {
+    int g, k, n = 0;
+    long raw, packed, rawsum = 0, packedsum = 0, rawmax = 0, packedmax = 0;
+
+    for (g=0; g<nglyphs; ++g) {
+        if (!glyphexists[g]) { continue; }
+        n++;
+        raw = CYC_BLOCK + (g % FONT_BLOCK + 1) * CYC_WIDTH + glyphwidth[g] * CYC_COPY;
+        packed = CYC_BLOCK + (g % FONT_BLOCK + 1) * (CYC_WIDTH + CYC_SHAPE);
+        for (k = 0; k < glyphwidth[g]; k++) {
+            packed += CYC_CODE + (dictidx[glyphcols[g][k]] < 0 ? CYC_CODE : CYC_DICT);
+        }
+        rawsum += raw; packedsum += packed;
+        if (raw > rawmax) { rawmax = raw; }
+        if (packed > packedmax) { packedmax = packed; }
+    }
+    if (n == 0) { return; }
+    printf("\ndecode cycles per char (est.):\n\traw    %ld avg, %ld max\n\tpacked %ld avg, %ld max",
+           rawsum/n, rawmax, packedsum/n, packedmax);
 }
 
 
 void dumpCFont (char* fileName) {
     
-    int i, j; 
+    int i, g, k, l, pos = 0, n = 0, font;
     FILE* f;
 
+    for (g=0; g<nglyphs; ++g) {
+        if (glyphexists[g]) { n++; }
+        for (k = 0; k < glyphwidth[g]; k++) { freq[glyphcols[g][k]]++; pos++; }
+    }
+
+    // sizes
+    int widthmem = (nglyphs+1)>>1;
+    int blkmem = 2 * ((nglyphs+FONT_BLOCK-1)/FONT_BLOCK) + 4*nfonts;
+    int fontmem = pos;
+    int best = 0, bestmem = 0;
+    for (i=2; i<=7; i++) {
+        int m = packedSize(i);
+        if (m > 0 && (best == 0 || m < bestmem)) { best = i; bestmem = m; }
+    }
+    if (best == 0) {
+        printf("\nno packed font w/ at most 16 shapes, writing the plain one");
+        rawfont = 1;
+    } else if (!rawfont) {
+        if (!packfont && fontmem - bestmem <= decoder) { rawfont = 1; }
+        printf("\npacked font: %d bytes of data saved, its decoder takes %d bytes of code: writing the %s one",
+               fontmem - bestmem, decoder, rawfont ? "plain" : "packed");
+        codebits = best;
+        packedSize(codebits);
+    }
+
     printf("\nDumping progmem arrays as '%s'...\n", fileName);
 
     f = fopen(fileName,"w");
     
-    fprintf(f, "//font.h  -  generated using fonconv; input file was %s",infile);
-    
-    // boundaries etc
-    fprintf(f, "\n#define firstchar %d",firstchar);
-    fprintf(f, "\n#define lastchar %d", lastchar);
-    
-    // font arr
-    fprintf(f, "\nconst uint8_t font[] PROGMEM = {\n");
+    fprintf(f, "//font.h  -  generated using fonconv; input file%s", nfonts > 1 ? "s were" : " was");
+    for (font=0; font<nfonts; font++) { fprintf(f, " %s", fontfile[font]); }
+    if (subsetfile != NULL) { fprintf(f, ", only the chars of %s", subsetfile); }
     
-    
-    int posarr[255];    // begin positions of char
-    
-    int c,k,l,pos,n=0;
-    for (c=0; c<255; ++c) {
-        if (exists[c]) {
-            n++;
-            
-            fprintf(f,"\n// %d\t%c\t%d",c,(char)c,pos, vpos[c][0],vpos[c][2]);
-            
-            for (k = vpos[c][0]; k <= vpos[c][2]; k++) {
-                int b=0;
-                fprintf(f,"\n0b");
-                for (l = 7; l >= 0; --l) {
-                    if (rawData[c][l][k] == 0) {
-                        b |= (1<<l);
-                        fprintf(f,"1");
-                    } else { fprintf(f,"0"); }
+    // boundaries etc: of all fonts, and of each
+    int first = 255, last = 0;
+    for (font=0; font<nfonts; font++) {
+        if (fontfirst[font] < first) { first = fontfirst[font]; }
+        if (fontlast[font] > last) { last = fontlast[font]; }
+    }
+    fprintf(f, "\n#define firstchar %d",first);
+    fprintf(f, "\n#define lastchar %d", last);
+    fprintf(f, "\n#define FONTS %d", nfonts);
+    fprintf(f, "\n#define FONT_BLOCK %d\n", FONT_BLOCK);
+
+    fprintf(f, "\nconst uint8_t fontfirst[] PROGMEM = { ");
+    for (font=0; font<nfonts; font++) { fprintf(f, "%d%s", fontfirst[font], font < nfonts-1 ? "," : ""); }
+    fprintf(f, "};\nconst uint8_t fontlast[] PROGMEM = { ");
+    for (font=0; font<nfonts; font++) { fprintf(f, "%d%s", fontlast[font], font < nfonts-1 ? "," : ""); }
+    fprintf(f, "};\nconst uint16_t fontbase[] PROGMEM = { ");
+    for (font=0; font<nfonts; font++) { fprintf(f, "%d%s", fontbase[font], font < nfonts-1 ? "," : ""); }
+    fprintf(f, "};\n");
+
+    int blk[MAXGLYPHS/FONT_BLOCK+1], nblk = 0;
+
+    if (rawfont) {
+
+        // font arr
+        fprintf(f, "\nconst uint8_t font[] PROGMEM = {\n");
+
+        pos = 0;
+        for (g=0, font=0; g<nglyphs; ++g) {
+            if (g % FONT_BLOCK == 0) { blk[nblk++] = pos; }
+            if (font+1 < nfonts && g == fontbase[font+1]) { font++; }
+            if (g == fontbase[font] && nfonts > 1) { fprintf(f, "\n// font %d: %s", font, fontfile[font]); }
+            if (glyphexists[g]) {
+                fprintf(f,"\n// %d\t%c\t%d",fontfirst[font] + g - fontbase[font],(char)glyphchar[g],pos);
+
+                for (k = 0; k < glyphwidth[g]; k++) {
+                    fprintf(f,"\n0b");
+                    for (l = 7; l >= 0; --l) { fprintf(f, "%d", (glyphcols[g][k] >> l) & 1); }
+
+                    if (pos+k+1 < fontmem) { fprintf(f,","); } // ommit last comma
                 }
-                
-                if (! (c == lastchar && k == vpos[c][2]) ) { fprintf(f,","); } // ommit last comma
             }
-            
-            posarr[c] = vpos[c][1];
-        } else {
-            posarr[c] = 0;
+            pos += glyphwidth[g];
         }
-        
-        pos += vpos[c][1];
+
+        fprintf(f, "};\n");
+
+    } else {
+
+        fprintf(f, "\n#define FONT_PACKED");
+        fprintf(f, "\n#define FONT_BITS %d", codebits);
+        fprintf(f, "\n#define FONT_ESC %d\n", (1<<codebits)-1);
+
+        // dictionary
+        fprintf(f, "\nconst uint8_t fontdict[] PROGMEM = {");
+        for (i=0; i<dictlen; i++) {
+            fprintf(f, "\n0b");
+            for (l = 7; l >= 0; --l) { fprintf(f, "%d", (dict[i] >> l) & 1); }
+            fprintf(f, "%s\t// %d: %dx", i < dictlen-1 ? "," : "", i, freq[dict[i]]);
+        }
+        fprintf(f, "\n};\n");
+
+        // code stream
+        streambits = 0;
+        for (g=0; g<nglyphs; ++g) {
+            if (g % FONT_BLOCK == 0) { blk[nblk++] = streambits; }
+            for (k = 0; k < glyphwidth[g]; k++) {
+                int col = glyphcols[g][k];
+                if (dictidx[col] < 0) {
+                    putBits((1<<codebits)-1, codebits);
+                    putBits(col, 8);
+                } else {
+                    putBits(dictidx[col], codebits);
+                }
+            }
+        }
+
+        fprintf(f, "\nconst uint8_t fontcode[] PROGMEM = {");
+        for (i=0; i<(streambits+7)/8+1; i++) {    // one more: the decoder reads two bytes
+            if (i % 16 == 0) { fprintf(f, "\n"); }
+            fprintf(f, "0x%02x%s", stream[i], i < (streambits+7)/8 ? "," : "");
+        }
+        fprintf(f, "};\n");
+
+        // width | escaped columns << 4
+        fprintf(f, "\nconst uint8_t fontshape[] PROGMEM = { ");
+        for (i=0; i<nshapes; i++) { fprintf(f, "%d%s", shape[i], i < nshapes-1 ? "," : ""); }
+        fprintf(f, "};\n");
     }
-    
+
+    // where every FONT_BLOCK'th glyph begins
+    fprintf(f, "\nconst uint16_t fontblk[] PROGMEM = { ");
+    for (i=0; i<nblk; i++) { fprintf(f, "%d%s", blk[i], i < nblk-1 ? "," : ""); }
     fprintf(f, "};\n");
     
     
-    // fontpos
-    fprintf(f, "\nconst int8_t widths[] PROGMEM = { ");
+    // fontpos: widths, or the fontshape[] of the glyphs
+    fprintf(f, "\nconst int8_t %s[] PROGMEM = { ", rawfont ? "widths" : "shapes");
     
-    for (c=firstchar; c<=lastchar; c+=2) {
-        fprintf(f, "%d", ( ( (uint)posarr[c] & 0b1111) << 4) | ( (uint)posarr[c+1] & 0b1111)) ;
-//        fprintf(f, "%d", (posarr[c] << 4) | posarr[c+1]);
-        if (c != lastchar) { fprintf(f, ","); }
+    for (g=0; g<nglyphs; g+=2) {
+        int hi = rawfont ? glyphwidth[g] : shapeidx[g], lo = rawfont ? glyphwidth[g+1] : shapeidx[g+1];
+        if (g+1 == nglyphs) { lo = 0; }
+        fprintf(f, "%d", ( ( (uint)hi & 0b1111) << 4) | ( (uint)lo & 0b1111)) ;
+        if (g+2 < nglyphs) { fprintf(f, ","); }
     }
         
     fprintf(f, "};\n");
     
     
     // stats    
-    int widthmem = (lastchar-firstchar+1)>>1;
-    int fontmem = pos;
-    printf("mem usage for %d characters:\n\t%d byte fontdata\n\t%d byte width data\n\t----\nsum =\t%d bytes",n,fontmem,widthmem, fontmem+widthmem);
+    printf("mem usage for %d characters in %d font%s:\n\t%d byte fontdata\n\t%d byte width data\n\t%d byte font/block tables\n\t----\nsum =\t%d bytes",
+           n, nfonts, nfonts > 1 ? "s" : "", fontmem, widthmem, blkmem, fontmem+widthmem+blkmem);
+    if (best) {
+        int e = 0;
+        codebits = best;
+        packedSize(codebits);
+        for (g=0; g<nglyphs; ++g) { e += escapes(g); }
+        printf("\npacked (%d bit codes, %d columns in the dictionary, %d of %d escaped, %d shapes):\n\t%d byte fontdata\n\t%d byte shape data\n\t%d byte font/block tables\n\t%d byte decoder (est.)\n\t----\nsum =\t%d bytes, %d bytes %s",
+               codebits, dictlen, e, fontmem, nshapes, bestmem, widthmem, blkmem, decoder, bestmem+widthmem+blkmem+decoder,
+               abs(fontmem-bestmem-decoder), fontmem > bestmem+decoder ? "saved" : "more");
+        if (rawfont) { printf(" (not used)"); }
+    }
+    decodeCost();
 };
 
+
+/*
+ * only the chars of the glyph file (decimal codes, as textconv --glyphs
+ * writes them), renumbered in ascending order from the first char after
+ * SPACE. textconv --font-map does the same to the images
+ */
+void subset (char *fileName) {
+    static int keepData[256][8][8], keepPos[256][3], keepExists[256];
+    int c, n = 33, want[256] = { 0 };
+    FILE *f = fopen(fileName, "r");
+
+    if (f == NULL) {
+        printf("\nError: can not read %s\n", fileName);
+        exit(1);
+    }
+    while (fscanf(f, "%d", &c) == 1) {
+        if (c >= 33 && c < 256) { want[c] = 1; }
+    }
+    fclose(f);
+
+    memcpy(keepData, rawData, sizeof(rawData));
+    memcpy(keepPos, vpos, sizeof(vpos));
+    memcpy(keepExists, exists, sizeof(exists));
+    memset(exists, 0, sizeof(exists));
+
+    for (c=33; c<256; c++) {
+        if (!want[c]) { continue; }
+        if (!keepExists[c]) { printf("\nWarning: char %d is not in the font", c); }
+        memcpy(rawData[n], keepData[c], sizeof(rawData[n]));
+        memcpy(vpos[n], keepPos[c], sizeof(vpos[n]));
+        exists[n] = keepExists[c];
+        origchar[n] = c;
+        n++;
+    }
+    firstchar = 33;
+    lastchar = n > 33 ? n-1 : 33;
+    printf("\nsubset of %d chars from %s", n-33, fileName);
+}
+
+
 void splitraw() {
     
     int i,j,k,l,c=0;
@@ -179,6 +570,7 @@ void splitraw() {
                 if (c < firstchar) { firstchar = c; }
             }
             
+            origchar[c] = c;
             c++;
         }
     }
@@ -186,15 +578,49 @@ void splitraw() {
 
 
 int main (int argc, char *argv[]) {
-    printf("\nfontconvert: converter for 128x128 pixel font (8x8 pixel per char, ascii table layout w/ 8x8 chars) to progmem c array\n\n");
+    int i;
+
+    printf("\nfontconvert: converter for 128x128 pixel fonts (8x8 pixel per char, ascii table layout w/ 8x8 chars)");
+#ifdef HAVE_FREETYPE
+    printf("\n             and ttf fonts (rasterized 8 pixel high)");
+#endif
+    printf(" to progmem c arrays\n\n");
+
+    while (argc > 1 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "--raw")) { rawfont = 1; argc--; argv++; }
+        else if (!strcmp(argv[1], "--packed")) { packfont = 1; argc--; argv++; }
+        else if (!strcmp(argv[1], "--decoder") && argc > 2) { decoder = atoi(argv[2]); argc -= 2; argv += 2; }
+        else if (!strcmp(argv[1], "--subset") && argc > 2) { subsetfile = argv[2]; argc -= 2; argv += 2; }
+        else if (!strcmp(argv[1], "--size") && argc > 2) { ttfsize = atoi(argv[2]); argc -= 2; argv += 2; }
+        else { argc = 0; }
+    }
     if (argc < 3) { 
-        printf("usage:\n\tfontconvert font.pgm font8.h\n\n");
+        printf("usage:\n\tfontconvert [--raw | --packed] [--decoder bytes] [--subset glyphs.txt] [--size pixels] font.pgm|font.ttf [more fonts] font8.h\n");
+        printf("\tthe first font is font 0 (\\F1 in textconv), the next one font 1 (\\F2)..\n\n");
         exit(1); 
     }
-    infile = argv[1];
-    readPicture (argv[1]);
-    splitraw();
-    dumpCFont(argv[2]);
+
+    for (i = 1; i < argc-1; i++) {
+        char *ext = strrchr(argv[i], '.');
+
+        memset(exists, 0, sizeof(exists));
+        firstchar = 0xffff; lastchar = 0;
+
+        if (ext != NULL && (!strcmp(ext, ".ttf") || !strcmp(ext, ".TTF") || !strcmp(ext, ".otf"))) {
+#ifdef HAVE_FREETYPE
+            readTTF (argv[i]);
+#else
+            printf("\nError: %s: built w/o freetype, no ttf fonts\n", argv[i]);
+            exit(1);
+#endif
+        } else {
+            readPicture (argv[i]);
+            splitraw();
+        }
+        if (subsetfile != NULL) { subset(subsetfile); }
+        collect(argv[i]);
+    }
+    dumpCFont(argv[argc-1]);
     
     printf("\n");
     return 0;
@@ -0,0 +1,1126 @@
+/*
+ *  blinken64 tools / libblinken.c
+ *
+ *  text -> eeprom conversion, utf8 decoding, pictures and font lookup,
+ *  the player and the virtual display, shared by the tools. See libblinken.h.
+ *
+ *
+ *  Copyright (C) 2011 Manuel Jerger <nom@nomnom.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PROGMEM
+#include "../firmware/font.h"
+#include "../firmware/profiles.h"
+#include "../firmware/comm.h"
+
+#include "libblinken.h"
+
+
+// state of one conversion
+struct conv {
+    const struct bl_pictures *pics;
+    const struct bl_profile *prof;
+    struct bl_image *img;
+    int inb[BL_MAXINPUT];      // utf8-free input (only commands left)
+    int inpsize;               // length of valid input
+    int flags;                 // BL_EE, BL_OPTIMIZE
+    uint8_t *out;              // text & commands, all of it (grows), only the budget goes to the image
+    int outsize;
+    int op;                    // output position, may run past maxmem (too much text)
+    int picpos;                // number of actually used eeprom pictures
+    int lastpos;               // last eeprom pos
+    int maxmem;                // max mem pos we can write text & commands, without pictures (at least 1x EOM at end)
+    int picid[BL_MAXPICTURES]; // mapping of pic IDs in input -> IDs in eeprom
+    int separated;             // true if last character was a \n -> message separator
+};
+
+static const struct bl_pictures nopics;
+
+
+static void diag (struct bl_image *img, int pos, const char *msg) {
+    if (img != NULL && img->ndiag < BL_MAXDIAG) {
+        img->diag[img->ndiag].pos = pos;
+        img->diag[img->ndiag].msg = msg;
+        img->ndiag++;
+    }
+}
+
+
+// write to output. it grows, only counts if it can not
+static int put (struct conv *cv, int c) {
+    if (cv->op >= cv->outsize) {
+        uint8_t *o = realloc(cv->out, cv->outsize * 2 + 256);
+        if (o != NULL) { cv->out = o; cv->outsize = cv->outsize * 2 + 256; }
+    }
+    if (cv->op < cv->outsize) { cv->out[cv->op] = c; }
+    cv->op++;
+    return c;
+}
+
+
+const struct bl_profile *bl_profile_list (int i) {
+    if (i < 0 || i >= (int)(sizeof(profiles)/sizeof(profiles[0])) - 1) { return NULL; }
+    return (const struct bl_profile *)&profiles[i];
+}
+
+
+const struct bl_profile *bl_profile (const char *name) {
+    const struct bl_profile *p;
+    int i;
+
+    if (name == NULL) { name = profiles[0].name; }
+    for (i=0; (p = bl_profile_list(i)) != NULL; i++) {
+        if (!strcmp(p->name, name)) { return p; }
+    }
+    return NULL;
+}
+
+
+// places eeprom picture #idx at the end of memory (first use only) and
+// writes its code: PICTUREn, or PICTURE_X + slot past the 8th.
+// decrements maxmem
+static int picture (struct conv *cv, int idx) {
+
+    int i;
+
+    // the same columns as a picture in the eeprom already: that one
+    for (i=0; i<BL_MAXPICTURES && cv->picid[idx] == -1 && (cv->flags & BL_OPTIMIZE); i++) {
+        if (cv->picid[i] != -1 && !memcmp(cv->pics->cols + i*8, cv->pics->cols + idx*8, 8)) {
+            cv->picid[idx] = cv->picid[i];
+            cv->img->saved += 8;
+        }
+    }
+
+    // pic is not used yet
+    if (cv->picid[idx] == -1) {
+        cv->picid[idx] = cv->picpos;
+        memcpy(cv->img->data + cv->lastpos - cv->picpos*8 - 8, cv->pics->cols + idx*8, 8);
+        cv->maxmem -= 8;
+        cv->picpos++;
+    }
+
+    // the actual used pic-ID used in eeprom
+    if (cv->picid[idx] < 8) {
+        return put(cv, cv->picid[idx] + PICTURE1);
+    }
+    put(cv, PICTURE_X);
+    return put(cv, cv->picid[idx]);
+}
+
+
+// the flipbook as FLIP codes, the wait after every frame. every frame is the
+// smaller of a key frame (9 bytes) and the delta to the one before (mask +
+// the columns that change), one like the one before is only its wait. the
+// first is a key frame: what is on the display then is not known
+static int flipbook (struct conv *cv, int wait) {
+    const uint8_t *f = cv->pics->book, *prev = NULL;
+    int n, x, mask, k;
+
+    for (n=0; n<cv->pics->frames; n++, prev = f, f += 8) {
+        for (mask=0, k=0, x=0; prev && x<8; x++) {
+            if (f[x] != prev[x]) { mask |= 1 << x; k++; }
+        }
+        if (prev && mask && 2 + k < 1 + 8) {
+            put(cv, FLIP_DELTA);
+            put(cv, mask);
+            for (x=0; x<8; x++) { if (mask & (1 << x)) { put(cv, f[x] ^ prev[x]); } }
+        } else if (!prev || mask) {
+            put(cv, FLIP_KEY);
+            for (x=0; x<8; x++) { put(cv, f[x]); }
+        }
+        put(cv, wait);
+    }
+    return wait;
+}
+
+
+// process unicode low level (we need only a few special chars for german text)
+int bl_utf8 (const char *str, int len, int *out, int max, struct bl_image *img) {
+
+    const unsigned char *s = (const unsigned char *)str;
+    int i, pos=0;
+
+    for (i=0; i<len && pos<max; i++) {
+        int ic = s[i];
+
+        // ascii, utf8 compatible
+        if (ic < 128) {
+            out[pos++] = ic;
+
+        // utf8
+        } else {
+            int fail = 0, at = i;
+
+            if (ic == 195 && i+1 < len) {
+                ic = s[++i];
+                switch (ic) {
+                    case 132 : out[pos++] = 129; break; //Ä
+                    case 150 : case 182 :  out[pos++] = 130; break;//Ö//ö
+                    case 156 : case 188 :  out[pos++] = 131; break;//Ü //ü
+                    case 159 : out[pos++] = 132; break; //ß
+                    case 164 : out[pos++] = 133; break; //ä
+                    default : fail = 1;
+                }
+            } else if (ic == 226 && i+2 < len && s[i+1] == 130 && s[i+2] == 172) {    // €
+                out[pos++] = 128;
+                i += 2;
+            } else {
+                fail = 1;
+            }
+
+            if (fail) { diag(img, at, "unknown char in UTF range"); }
+        }
+    }
+
+    return pos;
+}
+
+
+// convert input to output. returns the length, > maxmem+1 if the text does
+// not fit
+static int convert (struct conv *cv, int flags) {
+    int ip=0, last=-1;
+    cv->op = 0;
+
+    if (flags & BL_EE) {    // for direct eeprom flashing : two dummy bytes
+        put(cv, 0x20);
+        put(cv, 0x20);
+    }
+
+    int eflag = 0;          // for escape char detection
+
+    while (ip < cv->inpsize) {
+
+        int c = cv->inb[ip];
+
+        // if escape chr was last
+        if (eflag) {
+            eflag = 0;
+
+            // its just an escaped backslash..
+            if (c == '\\') {
+                last = put(cv, c);
+                ++ip;
+            // read whole command, three chars incl backslash
+            } else {
+                int at = ip - 1;
+                ++ip;
+                int num = -1; // for numbered commands
+                // check if next char is a number
+                if (ip < cv->inpsize) {
+                    int nc = cv->inb[ip];
+
+                    if (nc-0x30 >= 0 && nc-0x30 <= 0x09) {
+                        num = nc-0x30;
+                    } else if ((c == 'P' || c == 'p') && (nc|0x20) >= 'a' && (nc|0x20) <= 'g') {
+                        num = (nc|0x20) - 'a' + 10;     // pictures 10..16
+                    }
+                }
+                if (c == 'I') {             // invert
+                    last = put(cv, INVERT);
+
+                } else if (c == 'H') {      // halt
+                    last = put(cv, HALT);
+
+                } else if ((c == 'F' || c == 'f') && num >= 1) {     // 9 fonts, the firmware has FONTS of them
+                    ++ip;
+                    last = put(cv, FONT_X);
+                    put(cv, num-1);         // may be 0, not a MSG_SEP
+
+                } else {
+                    ++ip;
+                    int fail = 1;
+
+                    if (num >= 1) {
+                        switch (c) {
+                            case 'S' : case 's' :     // 8 speeds
+                                if (num <= 8) { last = put(cv, num-1 + SPEED1); fail = 0; }
+                                break;
+                            case 'W' : case 'w' :     // 8 waits
+                                if (num <= 8) { last = put(cv, num-1 + WAIT1); fail = 0; }
+                                break;
+                            case 'P' : case 'p' :     // 8 pictures
+                                if (num <= cv->prof->pictures) { last = picture(cv, num-1); fail = 0; }
+                                break;
+                            case 'D' : case 'd' :     // 2 spacers
+                                if (num <= 2) { last = put(cv, num-1 + SPACER1); fail = 0; }
+                                break;
+                            case 'B' : case 'b' :     // the flipbook, 8 waits between the frames
+                                if (num <= 8 && cv->pics->frames) { last = flipbook(cv, num-1 + WAIT1); fail = 0; }
+                                break;
+                        }
+                    }
+
+                    if (fail) { diag(cv->img, at, "bad command, skipped"); }
+                }
+
+            }
+
+
+        // no eflag set
+        } else {
+
+            // newline = msg sep (only once, swallow empty lines)
+            if (c == '\n') {
+                if (cv->separated) {
+                    cv->separated = 0;
+                } else {
+                    last = put(cv, MSG_SEP);
+                    cv->separated = 1;
+                }
+
+            } else {
+                cv->separated = 0;
+
+                // escape character '\' special handling
+                if (c == '\\') {
+                    eflag = 1;      // if next char is also a '\', it gets copied
+
+                // ascii 127, printable characters + converted utf8 chars
+                } else if (c >= SPACE) {
+                    last = put(cv, c);
+                }
+            }
+
+            ++ip;
+        }
+    }
+
+    // append end-of-message
+    if (last == MSG_SEP) {
+        cv->op--;
+        put(cv, END_OF_MEMORY);   // replace last MSG Sep. by EOM
+    } else {
+        put(cv, END_OF_MEMORY);   // additional EOM
+    }
+
+    return cv->op;
+}
+
+
+int bl_convert (const char *text, int len, const struct bl_pictures *pics, const struct bl_profile *prof,
+                int flags, struct bl_image *img) {
+
+    struct conv *cv = calloc(1, sizeof(struct conv));
+    int i, n, over;
+
+    if (cv == NULL) { return -1; }
+
+    memset(img, 0, sizeof(*img));
+    cv->img = img;
+    cv->pics = pics ? pics : &nopics;
+    cv->prof = prof ? prof : bl_profile(NULL);
+    for (i=0; i<BL_MAXPICTURES; i++) { cv->picid[i] = -1; }
+
+    // direct eeprom flash: picture positions moved left by two
+    cv->lastpos = (flags & BL_EE) ? cv->prof->eeprom : cv->prof->eeprom - 2;
+    cv->maxmem = cv->lastpos - 1;   // EOM must fit below lastpos too
+
+    cv->flags = flags;
+    cv->inpsize = bl_utf8(text, len, cv->inb, BL_MAXINPUT, img);
+    img->len = convert(cv, flags);
+
+    // the smallest program that shows the same, then what fits (incl. the EOM) next to the pictures
+    if ((flags & BL_OPTIMIZE) && cv->op <= cv->outsize) {
+        img->len = bl_optimize(cv->out, (flags & BL_EE) ? 2 : 0, img->len);
+        img->saved += cv->op - img->len;
+    }
+    n = img->len < cv->maxmem + 1 ? img->len : cv->maxmem + 1;
+    if (cv->out != NULL) { memcpy(img->data, cv->out, n < cv->outsize ? n : cv->outsize); }
+
+    img->size = cv->lastpos;
+    img->budget = cv->maxmem + 1;
+    img->pictures = cv->picpos;
+
+    over = img->len - img->budget;
+    free(cv->out);
+    free(cv);
+
+    if (over > 0) {
+        diag(img, len, "no more memory left in device for textdata");
+        return over;
+    }
+    return 0;
+}
+
+
+int bl_convert_buf (const char *text, int len, const struct bl_pictures *pics, const char *profile,
+                    int flags, uint8_t *out, int outsize) {
+
+    struct bl_image img;
+    const struct bl_profile *prof = bl_profile(profile);
+    int over;
+
+    if (prof == NULL) { return -1; }
+    over = bl_convert(text, len, pics, prof, flags, &img);
+
+    if (over) { return -over; }
+    if (img.size > outsize) { return -1; }
+    memcpy(out, img.data, img.size);
+    return img.size;
+}
+
+
+int bl_read_pictures (const char *file, struct bl_pictures *pics) {
+
+    struct bl_pnm img;
+    int n;
+
+    if (bl_pnm_read(file, &img) < 0) { return -1; }
+    if (img.height < 8) {
+        bl_pnm_free(&img);
+        return -1;
+    }
+
+    n = (img.width + 7) / 8;
+    if (n > BL_MAXPICTURES) { n = BL_MAXPICTURES; }
+
+    memset(pics->cols, 0, sizeof(pics->cols));
+    bl_pnm_columns(&img, 0, 0, n * 8, pics->cols);
+
+    bl_pnm_free(&img);
+    return n;
+}
+
+
+int bl_read_flipbook (const char *file, struct bl_pictures *pics) {
+
+    struct bl_pnm img;
+    int per, n, y;
+
+    if (bl_pnm_read(file, &img) < 0) { return -1; }
+    if (img.height < 8) {
+        bl_pnm_free(&img);
+        return -1;
+    }
+
+    per = (img.width + 7) / 8;      // frames per 8 rows
+    n = per * (img.height / 8);
+    free(pics->book);
+    pics->book = malloc(n * 8);
+    pics->frames = 0;
+    if (pics->book == NULL) {
+        bl_pnm_free(&img);
+        return -1;
+    }
+    for (y=0; y < img.height / 8; y++) {
+        bl_pnm_columns(&img, 0, y * 8, per * 8, pics->book + y * per * 8);
+    }
+    pics->frames = n;
+
+    bl_pnm_free(&img);
+    return n;
+}
+
+
+struct bl_pictures *bl_pictures_open (const char *file) {
+    struct bl_pictures *pics = calloc(1, sizeof(struct bl_pictures));
+
+    if (pics != NULL && bl_read_pictures(file, pics) < 0) {
+        free(pics);
+        pics = NULL;
+    }
+    return pics;
+}
+
+
+// font char -> columns, same lookup as the firmware
+#ifdef FONT_PACKED
+static int fontbits (int *bit, int n) {
+    int w = (fontcode[*bit >> 3] << 8) | fontcode[(*bit >> 3) + 1];
+    w = (w << (*bit & 7)) & 0xffff;
+    *bit += n;
+    return w >> (16 - n);
+}
+#endif
+
+int bl_font_glyph (int fnt, int c, uint8_t *cols) {
+    int i, g, k, s, at;
+
+    if (fnt < 0 || fnt >= FONTS || c < fontfirst[fnt] || c > fontlast[fnt]) { return 0; }
+
+    // from the block of the glyph on
+    g = fontbase[fnt] + c - fontfirst[fnt];
+    at = fontblk[g / FONT_BLOCK];
+    for (k = g & ~(FONT_BLOCK-1); ; k++) {
+#ifdef FONT_PACKED
+        s = shapes[k>>1];
+        if (!(k & 0x01)) { s >>= 4; }
+        s = fontshape[s & 0x0F];
+        if (k == g) { break; }
+        at += (s & 0x0F) * FONT_BITS + (s >> 4) * 8;
+#else
+        s = widths[k>>1];
+        if (!(k & 0x01)) { s >>= 4; }
+        if (k == g) { break; }
+        at += s & 0x0F;
+#endif
+    }
+    for (i=0; i < (s & 0x0F); i++) {
+#ifdef FONT_PACKED
+        int code = fontbits(&at, FONT_BITS);
+        cols[i] = code == FONT_ESC ? fontbits(&at, 8) : fontdict[code];
+#else
+        cols[i] = font[at+i];
+#endif
+    }
+    return s & 0x0F;
+}
+
+
+int bl_glyph (int c, uint8_t *cols) {
+    return bl_font_glyph(0, c, cols);
+}
+
+
+int bl_fonts (void) {
+    return FONTS;
+}
+
+
+int bl_read_image (const char *file, uint8_t *image, int max) {
+
+    static char buf[BL_MAXEEPROM * 8];
+    FILE *f;
+    int len, n = 0;
+    char *p;
+
+    f = fopen(file, "r");
+    if (f == NULL) { return -1; }
+    len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+
+    // --hex: "0x20,0x41,..."
+    if (len > 2 && buf[0] == '0' && buf[1] == 'x') {
+        buf[len] = 0;
+        for (p = buf; *p && n < max; ) {
+            image[n++] = strtol(p, &p, 16);
+            while (*p == ',' || *p == '\n' || *p == '\r' || *p == ' ') { p++; }
+        }
+        return n;
+    }
+    n = len < max ? len : max;
+    memcpy(image, buf, n);
+    return n;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// font subsets
+
+// length of the code at i: control chars, PICTURE_X w/ its slot, FONT_X w/
+// the font, flipbook frames, font chars
+static int codeLen (const uint8_t *d, int i) {
+    int c = d[i], m, n = c == PICTURE_X || c == FONT_X ? 2 : 1;
+
+    if (c == FLIP_KEY) {
+        n = 9;
+    } else if (c == FLIP_DELTA) {
+        for (m = d[i+1], n = 2; m; m &= m - 1) { n++; }
+    }
+    return n;
+}
+
+
+// font char at i, or 0
+static int glyphAt (const struct bl_image *img, int i, int *next) {
+    int c = img->data[i];
+    *next = i + codeLen(img->data, i);
+    return c > SPACE && c <= lastchar ? c : 0;
+}
+
+
+void bl_glyphs_used (const struct bl_image *img, uint8_t *used) {
+    int i, c, n = img->len < (int)sizeof(img->data) ? img->len : (int)sizeof(img->data);
+    for (i=0; i<n; ) {
+        if ((c = glyphAt(img, i, &i))) { used[c] = 1; }
+    }
+}
+
+
+int bl_write_glyphs (const char *file, const uint8_t *used) {
+    FILE *f = fopen(file, "w");
+    int c, n = 0;
+
+    if (f == NULL) { return -1; }
+    for (c=BL_FIRSTGLYPH; c<256; c++) {
+        if (used[c]) { fprintf(f, "%d%s", c, ++n % 16 ? " " : "\n"); }
+    }
+    if (n % 16) { fprintf(f, "\n"); }
+    fclose(f);
+    return n;
+}
+
+
+int bl_read_glyphs (const char *file, uint8_t *map) {
+    FILE *f = fopen(file, "r");
+    int c, n = 0;
+
+    if (f == NULL) { return -1; }
+    memset(map, 0, 256);
+    while (fscanf(f, "%d", &c) == 1) {
+        if (c >= BL_FIRSTGLYPH && c < 256) { map[c] = 1; }
+    }
+    fclose(f);
+    for (c=BL_FIRSTGLYPH; c<256; c++) {
+        if (map[c]) {
+            if (BL_FIRSTGLYPH + n > 255) { return -1; }
+            map[c] = BL_FIRSTGLYPH + n++;
+        }
+    }
+    return n;
+}
+
+
+int bl_remap (struct bl_image *img, const uint8_t *map) {
+    int i, c, at, missing = 0, n = img->len < (int)sizeof(img->data) ? img->len : (int)sizeof(img->data);
+    for (i=0; i<n; ) {
+        at = i;
+        if ((c = glyphAt(img, i, &i))) {
+            if (map[c]) {
+                img->data[at] = map[c];
+            } else {
+                missing++;
+            }
+        }
+    }
+    return missing;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// player, see blinken.c main()
+
+#define EEPROM_BEGIN    0x02
+#define spacing         1
+
+static const uint16_t waits[8] = { 50, 100, 250, 500, 1000, 1500, 2000, 5000};
+static const uint8_t delays[8] = { 0, 5, 20, 32, 64, 96, 128, 255};
+
+#define IDLE_MAX        (1000000)
+
+
+void bl_player_init (struct bl_player *pl, const uint8_t *image, int len, const struct bl_profile *prof) {
+
+    if (prof == NULL) { prof = bl_profile(NULL); }
+
+    memset(pl, 0, sizeof(*pl));
+    pl->size = prof->eeprom;
+    pl->xpics = prof->pictures > 8;
+    pl->loops = 1;
+
+    // w/o the dummy bytes it is written from EEPROM_BEGIN (PROG mode)
+    if (len < pl->size) {
+        if (len > pl->size - EEPROM_BEGIN) { len = pl->size - EEPROM_BEGIN; }
+        memcpy(pl->ee + EEPROM_BEGIN, image, len);
+    } else {
+        memcpy(pl->ee, image, pl->size);
+    }
+
+    pl->pos = pl->text_begin = EEPROM_BEGIN;
+    pl->speed = 4;
+    pl->tick = BL_BOOT_TICKS;
+}
+
+
+// ctr_delay_ms = 0; while (ctr_delay_ms < n) {}
+static void wait (struct bl_player *pl, int n) {
+    if (n) { pl->tick = (pl->tick / BL_MS_TICKS + n) * BL_MS_TICKS; }
+}
+
+
+static uint8_t readEE (struct bl_player *pl) {
+    uint8_t c = pl->ee[pl->pos];
+    pl->pos = (pl->pos + 1) % pl->size;
+    pl->chars++;
+    return c;
+}
+
+
+// one pass of the big if-elseif block
+static void step (struct bl_player *pl) {
+
+    uint8_t c;
+    int i, n;
+
+    if (pl->onstep) { pl->onstep(pl, pl->pos, pl->arg); }
+    c = readEE(pl);
+
+    pl->width = 0;
+    pl->rows2do = 0;
+    pl->col = 0;
+
+    // Message separator + End Of Memory
+    if (c <= END_OF_MEMORY) {
+
+        // end of a pass: the button is pressed after the last one
+        if (!pl->skip && pl->loops && ++pl->pass >= pl->loops) { pl->skip = 1; }
+
+        // we found the next message...
+        if (pl->skip) {
+            pl->skip = 0;
+            pl->pass = 0;
+            pl->msg++;
+            if (c == END_OF_MEMORY) {   // End Of Memory -> wrap around, playlist done
+                pl->pos = EEPROM_BEGIN;
+                pl->done = 1;
+            }
+            pl->text_begin = pl->pos;
+
+        // loop current message
+        } else {
+            pl->pos = pl->text_begin;
+        }
+
+    } else if (c <= SPEED8) {
+        pl->speed = c - SPEED1;
+
+    } else if (c == INVERT) {
+        pl->inverted = ~pl->inverted;
+
+    } else if (c == HALT) {
+        if (!pl->skip) {
+            // stays until the button is pressed
+            if (pl->hold) {
+                pl->tick += pl->hold;
+                pl->skip = 1;
+            } else {
+                pl->done = 1;
+            }
+        }
+
+    } else if (c == FONT_X) {
+        n = readEE(pl);
+        if (n < FONTS) { pl->font = n; }
+
+    } else if (c == PICTURE_X && pl->xpics) {
+        n = readEE(pl);
+        pl->width = pl->rows2do = 8;
+        for (i=0; i<8; i++) { pl->chr[i] = pl->ee[(pl->size - n*8 - 8 + i) % pl->size]; }
+
+    } else if (c <= WAIT8) {
+        // 0x0D: no wait of its own (the firmware reads past waits[])
+        if (!pl->skip && c >= WAIT1) { wait(pl, waits[c - WAIT1]); }
+
+    } else if (c <= PICTURE8) {
+        pl->width = pl->rows2do = 8;
+        for (i=0; i<8; i++) { pl->chr[i] = pl->ee[pl->size - (c-PICTURE1)*8 - 8 + i]; }
+
+    } else if (c <= SPACE) {
+        pl->rows2do = c - 29;
+
+    // a char the font does not have is one empty column (spacing), like in the firmware
+    } else if (c <= lastchar) {
+        n = bl_font_glyph(pl->font, c, pl->chr);
+        pl->width = n;
+        pl->rows2do = spacing + n;
+
+    // a flipbook frame: into buff at once, shown w/o a framewait
+    } else if (c == FLIP_KEY || c == FLIP_DELTA) {
+        n = c == FLIP_DELTA ? readEE(pl) : 0xFF;
+        for (i=0; i<8; i++) {
+            if (n & (1 << i)) {
+                uint8_t d = readEE(pl);
+                if (c == FLIP_KEY) { d ^= pl->inverted ^ pl->buff[7-i]; }
+                if (!pl->skip) { pl->buff[7-i] ^= d; }
+            }
+        }
+        pl->flip = !pl->skip;
+    }
+}
+
+
+int bl_player_next (struct bl_player *pl, struct bl_frame *fr) {
+
+    int i, j;
+
+    while (!pl->done) {
+
+        // DO SCROLLING, if not skipmessage
+        if (pl->col < pl->rows2do && !pl->skip) {
+
+            // transmit last column (if speed > 0): start edge, a pulse per bit, stop
+            fr->sent = -1;
+            fr->txtick = pl->tick;
+            if (pl->speed) {
+                fr->sent = pl->buff[7];
+                for (j=0; j<8; j++) { pl->tick += (pl->buff[7] & (1 << j)) ? COM_T_HIGH : COM_T_LOW; }
+                pl->tick += COM_T_BIT/2;
+            }
+
+            for (j=7; j>0; j--) { pl->buff[j] = pl->buff[j-1]; }
+            pl->buff[0] = (pl->col < pl->width ? pl->chr[pl->col] : 0) ^ pl->inverted;
+            pl->col++;
+
+            for (i=0; i<8; i++) { fr->buff[i] = pl->buff[i]; }
+            fr->tick = pl->tick;
+            fr->msg = pl->msg;
+
+            // FRAMEWAIT
+            wait(pl, delays[pl->speed]);
+            pl->idle = 0;
+            return 1;
+        }
+
+        if (pl->flip) {
+            pl->flip = 0;
+            for (i=0; i<8; i++) { fr->buff[i] = pl->buff[i]; }
+            fr->tick = fr->txtick = pl->tick;
+            fr->msg = pl->msg;
+            fr->sent = -1;
+            pl->idle = 0;
+            return 1;
+        }
+
+        // a message w/o any column never ends
+        if (++pl->idle > IDLE_MAX) { pl->done = 1; break; }
+
+        step(pl);
+    }
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// optimizer, see the player for what the codes do
+
+#define ANY             (-1)        // speed / font not known here
+#define NONE            (-2)        // message not reached (yet)
+
+static const uint8_t boot[2] = { 4, 0 };   // speed, font after power on
+
+
+// a code that scrolls columns in (they depend on speed, invert), or one the
+// player does not know: anything may depend on that
+int bl_scrolls (int c) {
+    return (c >= PICTURE1 && c <= SPACE) || c == PICTURE_X || (c > SPACE && c != FLIP_KEY && c != FLIP_DELTA);
+}
+
+
+// speed / font the code at i sets, -1: none
+static int sets (const uint8_t *d, int i, int what) {
+    if (what == 0) { return d[i] >= SPEED1 && d[i] <= SPEED8 ? d[i] - SPEED1 : -1; }
+    return d[i] == FONT_X && d[i+1] < FONTS ? d[i+1] : -1;
+}
+
+
+// the code at i is overwritten before anything uses it: speed by the next
+// SPEED before a column, font by the next FONT_X before a font char. the
+// message ends before: it may loop, next one
+static int dead (const uint8_t *d, int i, int len, int what) {
+    for (i += codeLen(d, i); i < len && d[i] > END_OF_MEMORY; i += codeLen(d, i)) {
+        if (sets(d, i, what) >= 0) { return 1; }
+        if (what == 0 ? bl_scrolls(d[i]) : d[i] > SPACE && d[i] != FLIP_KEY && d[i] != FLIP_DELTA) { return 0; }
+    }
+    return 0;
+}
+
+
+// the INVERT at i is undone by the next one before a column or a key frame
+// (a delta is the same either way): that one, or -1
+static int uninverted (const uint8_t *d, int i, int len) {
+    for (i++; i < len && d[i] > END_OF_MEMORY; i += codeLen(d, i)) {
+        if (d[i] == INVERT) { return i; }
+        if (bl_scrolls(d[i]) || d[i] == FLIP_KEY) { return -1; }
+    }
+    return -1;
+}
+
+
+static int join (int a, int b) {
+    return a == NONE ? b : b == NONE || a == b ? a : ANY;
+}
+
+
+// fewest codes of a set of lengths (waits in 50 ms, blank columns) that add
+// up to n, into out. returns their number
+static int fewest (const int *len, const uint8_t *code, int k, int n, uint8_t *out) {
+    int *best = malloc((n + 1) * sizeof(int)), *last = malloc((n + 1) * sizeof(int)), i, j, m = 0;
+
+    if (best == NULL || last == NULL) { free(best); free(last); return -1; }
+    best[0] = 0;
+    for (i=1; i<=n; i++) {
+        best[i] = n + 1;
+        for (j=0; j<k; j++) {
+            if (len[j] <= i && best[i - len[j]] + 1 < best[i]) { best[i] = best[i - len[j]] + 1; last[i] = j; }
+        }
+    }
+    if (best[n] > n) { m = -1; }
+    for (i=n; i>0 && m >= 0; i -= len[last[i]]) { out[m++] = code[last[i]]; }
+    free(best);
+    free(last);
+    return m;
+}
+
+
+/*
+ * speed and font are known where every way into a message agrees: from the
+ * one before (boot for the first, and the last one wraps around) and from
+ * its own end (it loops). A SPEED or FONT_X that sets what is set already,
+ * or that is set again before it is used, goes; so do two INVERTs w/ no
+ * column between them. Waits next to each other are one wait (the player
+ * and the firmware add them up to the ms), blank columns next to each
+ * other are SPACEs and a SPACER: both as few codes as add up to the same.
+ * Columns, waits and frames come out the same, at the same time.
+ */
+int bl_optimize (uint8_t *data, int begin, int len) {
+
+    static const int wlen[8] = { 1, 2, 5, 10, 20, 30, 40, 100 }, blen[3] = { 1, 2, 3 };
+    static const uint8_t wcode[8] = { WAIT1, WAIT1+1, WAIT1+2, WAIT1+3, WAIT1+4, WAIT1+5, WAIT1+6, WAIT8 },
+                         bcode[3] = { SPACER1, SPACER2, SPACE };
+    int *start, (*in)[2], nmsg = 0, m, i, j, w, v, changed, o = begin;
+    uint8_t *drop, *run;
+
+    start = malloc((len + 1) * sizeof(int));
+    in = malloc((len + 1) * sizeof(*in));
+    drop = calloc(len + 1, 1);
+    run = malloc(2 * len + 2);      // a run, the fewest codes for it
+    if (start == NULL || in == NULL || drop == NULL || run == NULL) { o = len; goto out; }
+
+    for (i = begin, v = MSG_SEP; i < len; v = data[i], i += codeLen(data, i)) {
+        if (v <= END_OF_MEMORY) { start[nmsg++] = i; }
+    }
+
+    // what is known at the start of every message
+    for (m=0; m<nmsg; m++) { in[m][0] = in[m][1] = NONE; }
+    in[0][0] = boot[0];
+    in[0][1] = boot[1];
+    do {
+        changed = 0;
+        for (m=0; m<nmsg; m++) {
+            for (w=0; w<2; w++) {
+                int at = in[m][w];
+                if (at == NONE) { continue; }
+                for (i = start[m]; i < len && data[i] > END_OF_MEMORY; i += codeLen(data, i)) {
+                    if ((v = sets(data, i, w)) >= 0) { at = v; }
+                }
+                // loops, goes on w/ the next one (after the last: the first)
+                for (j=0; j<2; j++) {
+                    int to = j ? (m + 1) % nmsg : m;
+                    if ((v = join(in[to][w], at)) != in[to][w]) { in[to][w] = v; changed = 1; }
+                }
+            }
+        }
+    } while (changed);
+
+    // codes that do nothing
+    for (m=0; m<nmsg; m++) {
+        int at[2] = { in[m][0], in[m][1] };
+        for (i = start[m]; i < len && data[i] > END_OF_MEMORY; i += codeLen(data, i)) {
+            if (drop[i]) { continue; }
+            if (data[i] == INVERT && (j = uninverted(data, i, len)) >= 0) {
+                drop[i] = drop[j] = 1;
+            }
+            for (w=0; w<2; w++) {
+                if ((v = sets(data, i, w)) < 0 && !(w == 1 && data[i] == FONT_X)) { continue; }
+                if (v < 0 || v == at[w] || dead(data, i, len, w)) {
+                    drop[i] = 1;
+                } else {
+                    at[w] = v;
+                }
+            }
+        }
+    }
+
+    // the rest, runs of waits and blank columns as few codes as possible
+    for (i = begin; i < len; ) {
+        int n = codeLen(data, i), wait = data[i] >= WAIT1 && data[i] <= WAIT8,
+            blank = data[i] >= SPACER1 && data[i] <= SPACE, sum = 0, codes = 0, k;
+
+        if (drop[i]) { i += n; continue; }
+        if (!wait && !blank) {
+            memmove(data + o, data + i, n);
+            o += n;
+            i += n;
+            continue;
+        }
+        for (j = i; j < len && (drop[j] || (wait ? data[j] >= WAIT1 && data[j] <= WAIT8 : data[j] >= SPACER1 && data[j] <= SPACE));
+             j += codeLen(data, j)) {
+            if (drop[j]) { continue; }
+            sum += wait ? wlen[data[j] - WAIT1] : blen[data[j] - SPACER1];
+            run[codes++] = data[j];
+        }
+        k = wait ? fewest(wlen, wcode, 8, sum, run + codes) : fewest(blen, bcode, 3, sum, run + codes);
+        if (k >= 0 && k < codes) {
+            memcpy(data + o, run + codes, k);
+            o += k;
+        } else {
+            memcpy(data + o, run, codes);
+            o += codes;
+        }
+        i = j;
+    }
+
+out:
+    free(start);
+    free(in);
+    free(drop);
+    free(run);
+    return o;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// virtual display
+
+static struct bl_display *display (const char *name) {
+    struct bl_display *d = calloc(1, sizeof(*d));
+    if (d != NULL) {
+        snprintf(d->name, sizeof(d->name), "%s%s", name[0] == '/' ? "" : "/", name);
+    }
+    return d;
+}
+
+
+static struct bl_shm_slot *slot (struct bl_display *d, uint64_t n) {
+    return (struct bl_shm_slot *)(d->mem + BL_SHM_SLOTS + (n % d->h->slots) * d->h->slotsize);
+}
+
+
+struct bl_display *bl_display_create (const char *name, int width, int slots) {
+
+    struct bl_display *d = display(name);
+    int fd;
+
+    if (d == NULL || width < 1 || slots < 1) { free(d); return NULL; }
+
+    // slots on cache lines of their own
+    uint32_t slotsize = (sizeof(struct bl_shm_slot) + width + 63) & ~63;
+    d->size = BL_SHM_SLOTS + (size_t)slots * slotsize;
+
+    shm_unlink(d->name);
+    fd = shm_open(d->name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 || ftruncate(fd, d->size) < 0) {
+        if (fd >= 0) { close(fd); shm_unlink(d->name); }
+        free(d);
+        return NULL;
+    }
+    d->mem = mmap(NULL, d->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (d->mem == MAP_FAILED) { shm_unlink(d->name); free(d); return NULL; }
+
+    d->h = (struct bl_shm_header *)d->mem;
+    d->h->width = width;
+    d->h->slots = slots;
+    d->h->slotsize = slotsize;
+    d->h->tick_us = BL_TICK_US;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(d->h->magic, BL_SHM_MAGIC, 8);
+    d->owner = 1;
+    return d;
+}
+
+
+struct bl_display *bl_display_open (const char *name) {
+
+    struct bl_display *d = display(name);
+    struct stat st;
+    int fd;
+
+    if (d == NULL) { return NULL; }
+
+    fd = shm_open(d->name, O_RDONLY, 0);
+    if (fd < 0 || fstat(fd, &st) < 0 || (size_t)st.st_size < BL_SHM_SLOTS) {
+        if (fd >= 0) { close(fd); }
+        free(d);
+        return NULL;
+    }
+    d->size = st.st_size;
+    d->mem = mmap(NULL, d->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (d->mem == MAP_FAILED) { free(d); return NULL; }
+
+    d->h = (struct bl_shm_header *)d->mem;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (memcmp(d->h->magic, BL_SHM_MAGIC, 8) ||
+        BL_SHM_SLOTS + (size_t)d->h->slots * d->h->slotsize > d->size) {
+        munmap(d->mem, d->size);
+        free(d);
+        return NULL;
+    }
+    return d;
+}
+
+
+void bl_display_close (struct bl_display *d) {
+    if (d == NULL) { return; }
+    if (d->owner) {
+        __atomic_store_n(&d->h->closed, 1, __ATOMIC_RELEASE);
+        shm_unlink(d->name);
+    }
+    munmap(d->mem, d->size);
+    free(d);
+}
+
+
+void bl_display_publish (struct bl_display *d, const uint8_t *cols, int64_t tick, int msg) {
+
+    uint64_t n = d->h->head;
+    struct bl_shm_slot *s = slot(d, n);
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    __atomic_store_n(&s->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    s->tick = tick;
+    s->ns = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    s->msg = msg;
+    memcpy(s->cols, cols, d->h->width);
+    __atomic_store_n(&s->seq, n + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&d->h->head, n + 1, __ATOMIC_RELEASE);
+}
+
+
+uint64_t bl_display_head (struct bl_display *d) {
+    return __atomic_load_n(&d->h->head, __ATOMIC_ACQUIRE);
+}
+
+
+const struct bl_shm_slot *bl_display_get (struct bl_display *d, uint64_t n) {
+    const struct bl_shm_slot *s = slot(d, n);
+    if (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != n + 1) { return NULL; }
+    return s;
+}
+
+
+int bl_display_valid (struct bl_display *d, uint64_t n, const struct bl_shm_slot *s) {
+    (void)d;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&s->seq, __ATOMIC_RELAXED) == n + 1;
+}
+
+
+int bl_display_read (struct bl_display *d, uint64_t n, struct bl_shm_slot *out) {
+
+    const struct bl_shm_slot *s;
+
+    if (n >= bl_display_head(d)) { return 0; }
+    if ((s = bl_display_get(d, n)) == NULL) { return -1; }
+    memcpy(out, s, d->h->slotsize);
+    return bl_display_valid(d, n, s) ? 1 : -1;
+}
@@ -0,0 +1,289 @@
+/*
+ *  blinken64 tools / libblinken.h
+ *
+ *  The text -> eeprom converter of textconv as a library: no globals, no
+ *  files, no exit(). Used by textconv, blinkend and (via ctypes) the python
+ *  services. Also the firmware player of blinkenplay and the shared memory
+ *  virtual display.
+ *
+ *
+ *  Copyright (C) 2011 Manuel Jerger <nom@nomnom.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __LIBBLINKEN_H__
+#define __LIBBLINKEN_H__
+
+#include <stdint.h>
+
+#include "pnm.h"
+
+// control chars, see blinken.c
+#define MSG_SEP         0x00
+#define END_OF_MEMORY   0x01
+
+#define SPEED1          0x02
+#define SPEED8          0x09
+
+#define INVERT          0x0A
+#define HALT            0x0B
+#define FONT_X          0x0C        // + font: \F1.. in the text, font 0..
+#define PICTURE_X       0x0D        // + slot: pictures 9.., larger profiles only
+
+#define WAIT1           0x0E
+#define WAIT8           0x15
+
+#define PICTURE1        0x16
+#define PICTURE8        0x1D
+#define SPACER1         0x1E
+#define SPACER2         0x1F
+#define SPACE           0x20
+
+#define FLIP_KEY        0xF0        // + 8 columns: flipbook frame, \B1.. in the text
+#define FLIP_DELTA      0xF1        // + mask of the columns that change + their xor, column i is bit i
+
+#define BL_EEPROM_SIZE  (128)       // the badge, default profile
+#define BL_PICTURES     (8)
+#define BL_MAXEEPROM    (1024)      // largest profile
+#define BL_MAXPICTURES  (16)
+#define BL_MAXINPUT     (8192)      // chars per conversion
+#define BL_MAXDIAG      (16)
+
+// flags for bl_convert()
+#define BL_EE           (1)         // image for flashing the eeprom directly (two dummy bytes)
+#define BL_OPTIMIZE     (2)         // bl_optimize() the text, pictures w/ the same columns only once
+
+
+// memory of a part, see firmware/profiles.h
+struct bl_profile {
+    const char *name, *mcu;
+    int eeprom, flash, pictures;
+    long clock;
+};
+
+// the eeprom pictures, 8 columns each (bit 0 is the top row), and the
+// frames of a flipbook (in the text, not in picture slots)
+struct bl_pictures {
+    uint8_t cols[BL_MAXPICTURES * 8];
+    uint8_t *book;                  // 8 columns per frame, malloc'd, NULL: none
+    int frames;
+};
+
+// something in the input that was skipped
+struct bl_diag {
+    int pos;                        // char in the input
+    const char *msg;
+};
+
+// result of a conversion
+struct bl_image {
+    uint8_t data[BL_MAXEEPROM];     // eeprom image, pictures at the end
+    int size;                       // bytes of data to write: eeprom size - 2, all of it w/ BL_EE
+    int len;                        // text incl. EOM, may be > budget
+    int budget;                     // bytes left for text next to the pictures
+    int pictures;                   // eeprom pictures used
+    int saved;                      // bytes BL_OPTIMIZE saved, text and pictures
+    int ndiag;
+    struct bl_diag diag[BL_MAXDIAG];
+};
+
+
+// profile by name, NULL: the default (blinken64). NULL if there is none
+const struct bl_profile *bl_profile (const char *name);
+const struct bl_profile *bl_profile_list (int i);      // i-th profile, NULL after the last
+
+/*
+ * convert utf8 cleartext (textconv syntax) to an eeprom image for a profile
+ * (NULL: default). returns 0 if the text fits, otherwise the bytes over
+ * budget (nothing past the budget is written). pics may be NULL (empty
+ * pictures)
+ */
+int bl_convert (const char *text, int len, const struct bl_pictures *pics, const struct bl_profile *prof,
+                int flags, struct bl_image *img);
+
+// same, for bindings: profile by name, image to out, returns its size or -(bytes over budget)
+int bl_convert_buf (const char *text, int len, const struct bl_pictures *pics, const char *profile,
+                    int flags, uint8_t *out, int outsize);
+
+// rewrite the text of an image (data[begin..len), up to the EOM) into the
+// smallest one the firmware shows the same way. returns its length
+int bl_optimize (uint8_t *data, int begin, int len);
+
+// the code c scrolls columns in (text, pictures, blanks, codes the player
+// does not know), as opposed to settings, waits and flipbook frames
+int bl_scrolls (int c);
+
+// utf8 -> font chars (ascii + the german specials of the font), returns the number of chars
+int bl_utf8 (const char *s, int len, int *out, int max, struct bl_image *diag);
+
+// pgm/pbm, 8 columns per picture -> pictures: the top 8 rows (at least 8),
+// a last picture of less than 8 columns is filled up, more than there are
+// slots are left out. returns the number of pictures, or -1 if it can not
+// be read
+int bl_read_pictures (const char *file, struct bl_pictures *pics);
+struct bl_pictures *bl_pictures_open (const char *file);     // malloc'd, NULL on error
+// pgm/pbm strip (or sheet: 8 rows after 8 rows) -> flipbook frames of 8x8, left to right.
+// returns the number of frames, or -1
+int bl_read_flipbook (const char *file, struct bl_pictures *pics);
+
+// columns of a font char, as the firmware draws them. returns the width
+int bl_glyph (int c, uint8_t *cols);
+int bl_font_glyph (int font, int c, uint8_t *cols);     // font 0.. (\F1..)
+int bl_fonts (void);                                    // fonts in firmware/font.h
+
+// eeprom image from textconv (binary or --hex), returns its length or -1
+int bl_read_image (const char *file, uint8_t *image, int max);
+
+
+/*
+ * font subsets (fontconv --subset): only the font chars a set of messages
+ * uses, renumbered in ascending order from BL_FIRSTGLYPH. The glyph file
+ * has their codes in the full font, decimal, separated by white space.
+ */
+#define BL_FIRSTGLYPH   (SPACE+1)
+
+// font chars of the text of an image: used[c] = 1 (the others are left)
+void bl_glyphs_used (const struct bl_image *img, uint8_t *used);
+// used[] -> glyph file, returns the number of chars or -1
+int bl_write_glyphs (const char *file, const uint8_t *used);
+// glyph file -> map[c]: code of c in the subset, 0 if it is not in it. returns the number of chars or -1
+int bl_read_glyphs (const char *file, uint8_t *map);
+// renumber the font chars of an image for a subset, returns the number of chars not in it (left as they are)
+int bl_remap (struct bl_image *img, const uint8_t *map);
+
+
+/*
+ * the MASTER loop of blinken.c on the host: plays an eeprom image and
+ * returns the display after every scroll step, with the time it happened.
+ * Time is counted in ticks of the 20kHz ISR, like the firmware does (its
+ * "ms" counter wraps every 40 ticks, transmit() takes the pulse lengths of
+ * comm.h). The code between the busy waits is taken as free.
+ *
+ * The firmware loops a message until the button is pressed: the player
+ * presses it after every loops'th pass, and after hold ticks on a HALT.
+ * Once the last message is done, the playlist is over.
+ */
+#define BL_TICK_US      (50)        // ISR period
+#define BL_MS_TICKS     (40)        // CTR_DELAY_MS_MAX
+#define BL_BOOT_TICKS   (15000)     // delay() before the main loop
+
+struct bl_frame {
+    uint8_t buff[8];                // as in blinken.c: buff[0] is the right (newest) column, bit 0 the top row
+    int64_t tick;                   // when buff was set, since power on
+    int msg;                        // message number, from 0
+    int sent;                       // column sent to the next display before (the old buff[7]), -1: none (speed 0)
+    int64_t txtick;                 // when transmit() started
+};
+
+struct bl_player {
+    uint8_t ee[BL_MAXEEPROM];       // the eeprom
+    int size;
+    int loops;                      // passes per message before the button press, 0: never
+    int64_t hold;                   // ticks on a HALT before the button press, 0: never
+
+    // firmware state
+    int pos, text_begin, speed, font;
+    uint8_t inverted, buff[8];
+    int64_t tick;
+
+    // current char
+    uint8_t chr[8];
+    int width, rows2do, col;
+
+    int msg, pass;                  // message, passes of it so far
+    int skip;                       // skipmessage: the button was pressed
+    int flip;                       // a flipbook frame is in buff, not shown yet
+    int xpics;                      // firmware has PICTURE_X (profiles w/ more than 8 pictures)
+    int done;
+    long idle;                      // reads w/o a frame (a message that never shows anything)
+    long chars;                     // eeprom bytes read
+
+    // called before every code is read (pos: its address), NULL: none
+    void (*onstep) (struct bl_player *pl, int pos, void *arg);
+    void *arg;
+};
+
+// image: eeprom image (BL_EE) or the image w/o the two dummy bytes (written from address 2)
+void bl_player_init (struct bl_player *pl, const uint8_t *image, int len, const struct bl_profile *prof);
+
+// next frame. returns 0 at the end of the playlist (pl->tick is the end then)
+int bl_player_next (struct bl_player *pl, struct bl_frame *fr);
+
+
+/*
+ * virtual display: frames in a ring in posix shared memory (/dev/shm), for
+ * viewers, recorders and test oracles. One producer, any number of readers;
+ * nobody waits for anybody, a reader that is too slow loses frames (and
+ * knows which).
+ *
+ * A frame is the buff[] of N displays in a row (width = 8*N columns,
+ * cols[8*d + j] = buff[j] of display d, d=0 next to the master), with the
+ * device time and the host time it was published. The layout is fixed, so
+ * a reader may also mmap the segment on its own: header at 0, slots of
+ * slotsize bytes from BL_SHM_SLOTS.
+ *
+ * Frame n is in slot n % slots. Its seq is 0 while it is written and n+1
+ * after, the header's head is the number of frames published. A reader
+ * checks seq before and after using a slot (bl_display_get, _valid).
+ */
+#define BL_SHM_MAGIC    "blnkshm1"
+#define BL_SHM_SLOTS    (64)        // offset of the first slot
+
+struct bl_shm_header {
+    char magic[8];                  // BL_SHM_MAGIC, written last
+    uint32_t width;                 // columns per frame
+    uint32_t slots;
+    uint32_t slotsize;
+    uint32_t tick_us;               // BL_TICK_US
+    uint64_t head;                  // frames published
+    uint32_t closed;                // producer is gone, no more frames
+};
+
+struct bl_shm_slot {
+    uint64_t seq;
+    int64_t tick;                   // device time (bl_frame.tick)
+    int64_t ns;                     // CLOCK_MONOTONIC when published
+    int32_t msg;
+    uint32_t pad;
+    uint8_t cols[];
+};
+
+struct bl_display {
+    struct bl_shm_header *h;
+    uint8_t *mem;
+    size_t size;
+    int owner;
+    char name[64];
+};
+
+// producer: new segment (replaces an old one of that name). NULL on error
+struct bl_display *bl_display_create (const char *name, int width, int slots);
+// reader: attach to a segment. NULL if there is none (yet)
+struct bl_display *bl_display_open (const char *name);
+// the producer removes the segment, readers keep their mapping until they close
+void bl_display_close (struct bl_display *d);
+
+void bl_display_publish (struct bl_display *d, const uint8_t *cols, int64_t tick, int msg);
+
+uint64_t bl_display_head (struct bl_display *d);
+// slot of frame n, NULL if it is not published yet or already overwritten
+const struct bl_shm_slot *bl_display_get (struct bl_display *d, uint64_t n);
+// frame n was not overwritten while the slot was used
+int bl_display_valid (struct bl_display *d, uint64_t n, const struct bl_shm_slot *s);
+// copy of frame n (slotsize bytes): 1, 0 if not published yet, -1 if overwritten
+int bl_display_read (struct bl_display *d, uint64_t n, struct bl_shm_slot *out);
+
+#endif
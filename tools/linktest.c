@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "../firmware/comm.h"
+
+#define AUTHORS "Manuel Jerger"
+#define VERSION "0.1"
+
+#define TRUE ~(uint)0
+#define FALSE (uint)0
+
+
+/*
+ * linktest : bit error rate of the single pin link, measured on a model of
+ * the transmitter (transmit() in blinken.c) and the receiving ISR, with
+ * jitter, clock skew and glitches injected. Runs every speed w/ and w/o the
+ * parity pulse of _FRAME_CHECK_.
+ */
+
+#define TICK            (50.0)      // us, ISR period of the receiver
+#define MAXEDGES        (64)
+
+
+char *program_name = "linktest";
+
+int nbytes = 20000;         // bytes per run
+double jitter = 20;         // us, max edge displacement (uniform +/-)
+double skew = 5;            // %, receiver clock deviation (+/-, random per run)
+double glitches = 2;        // glitches per second
+double gap = 2000;          // us idle between bytes
+unsigned seed = 1;
+
+int speeds[] = { 50, 40, 35, 30, 25, 20, 18, 15, 12 };     // us per tick of the transmitter
+#define NUMSPEEDS (sizeof(speeds)/sizeof(speeds[0]))
+
+
+// receiver state, same names as in blinken.c
+struct rx {
+    uint8_t lastRead;
+    uint8_t rxBuff;
+    uint16_t comctr;
+    int8_t bitpos;
+    uint8_t bitmask;
+    uint8_t rxParity;
+    uint8_t thr;            // com_t_bit
+    int bits;               // COM_BITS
+};
+
+// results of one run
+struct result {
+    long sent, ok, wrong, dropped, lost;
+    long biterrors;
+};
+
+
+double rnd () { return (double)rand() / RAND_MAX; }
+
+
+// edge times (us, relative to start of byte) of one byte, like transmit()
+int encode (uint8_t b, int parity, double t_tick, double *edges) {
+    int n = 0, i, p = 0;
+    double t = 0;
+
+    edges[n++] = t;                                 // start edge, HI-LO
+    for (i=0; i<8; i++) {
+        int one = b & (1 << i);
+        t += (one ? COM_T_HIGH : COM_T_LOW) * t_tick;
+        edges[n++] = t;
+        p ^= one ? 1 : 0;
+    }
+    if (parity) {
+        t += (p ? COM_T_HIGH : COM_T_LOW) * t_tick;
+        edges[n++] = t;
+    } else {
+        t += COM_T_BIT/2 * t_tick;
+        edges[n++] = t;                             // stop edge, back to high
+    }
+    return n;
+}
+
+
+// one ISR call, returns 1 if a byte is complete (byte in rxBuff), -1 on a
+// parity error
+int isr (struct rx *r, uint8_t read) {
+
+    int done = 0;
+
+    if (r->lastRead != read) {
+
+        if (r->comctr <= COM_T_DEBOUNCE) {
+            r->comctr = 0;
+            r->bitpos = -1;
+            r->rxBuff = 0;
+        }
+
+        if (r->bitpos == -1) {
+            if (!read) {
+                r->bitpos = 0;
+                r->bitmask = 1;
+                r->rxParity = 0;
+            }
+        } else if (r->bitpos < r->bits) {
+            if (r->comctr < r->thr) {
+                r->rxBuff &= ~r->bitmask;
+                r->bitpos++;
+                r->bitmask <<= 1;
+            } else if (r->comctr < 2*r->thr) {
+                r->rxBuff |= r->bitmask;
+                r->bitpos++;
+                r->bitmask <<= 1;
+                r->rxParity ^= 1;
+            }
+
+            if (r->bitpos == r->bits) {
+                if (r->bits == 9) {
+                    done = r->rxParity ? -1 : 1;
+                    r->bitpos = -1;
+                } else {
+                    done = 1;
+                }
+            }
+        } else {
+            r->bitpos = -1;
+        }
+
+        r->lastRead = read;
+        r->comctr = 0;
+
+    } else {
+        if (++r->comctr >= COM_T_TIMEOUT) {
+            r->comctr = 0;
+            r->bitpos = -1;
+        }
+    }
+
+    return done;
+}
+
+
+int popcount (uint8_t b) { int n = 0; while (b) { n += b & 1; b >>= 1; } return n; }
+
+
+/*
+ * send nbytes random bytes at the given transmitter tick, sample the line w/
+ * the (skewed) receiver tick and decode. a byte counts as lost if nothing
+ * (or something else) was decoded before the next one starts.
+ */
+struct result run (int t_tick, int parity) {
+
+    struct result res;
+    struct rx r;
+    double edges[MAXEDGES];
+    double t_rx = TICK * (1.0 + skew/100.0 * (2*rnd() - 1));
+    double t = 0, sample = 0;
+    int i;
+
+    memset(&res, 0, sizeof(res));
+    memset(&r, 0, sizeof(r));
+    r.lastRead = 1;
+    r.bitpos = -1;
+    r.bits = parity ? 9 : 8;
+    // auto-baud: threshold between the short and long pulse, in receiver ticks
+    r.thr = (uint8_t)((COM_T_LOW + COM_T_HIGH) / 2.0 * t_tick / t_rx + 0.5);
+    if (r.thr <= COM_T_DEBOUNCE) { r.thr = COM_T_DEBOUNCE + 1; }
+
+    for (i=0; i<nbytes; i++) {
+        uint8_t b = rand();
+        int n = encode(b, parity, t_tick, edges), e;
+        double end;
+        int level = 1, got = 0;
+        uint8_t val = 0;
+
+        // jitter on every edge but the first
+        for (e=1; e<n; e++) { edges[e] += jitter * (2*rnd() - 1); }
+        for (e=1; e<n; e++) { if (edges[e] < edges[e-1]) { edges[e] = edges[e-1]; } }
+        for (e=0; e<n; e++) { edges[e] += t; }
+        end = edges[n-1] + gap;
+
+        // glitch: short pulse somewhere within this byte + gap
+        double glitch = -1, glitchlen = 0;
+        if (rnd() < glitches * (end - t) / 1e6) {
+            glitch = t + rnd() * (end - t);
+            glitchlen = 5 + rnd() * 150;
+        }
+
+        // sample the line until the next byte starts
+        for (; sample < end; sample += t_rx) {
+            level = 1;
+            for (e=0; e<n && edges[e] <= sample; e++) { level = !level; }
+            if (glitch >= 0 && sample >= glitch && sample < glitch + glitchlen) { level = !level; }
+
+            int d = isr(&r, level);
+            if (d == 1 && !got) { got = 1; val = r.rxBuff; }
+            if (d == -1 && !got) { got = -1; }
+        }
+        t = end;
+
+        res.sent++;
+        if (got == 1 && val == b) { res.ok++; }
+        else if (got == 1)        { res.wrong++; res.biterrors += popcount(val ^ b); }
+        else if (got == -1)       { res.dropped++; }
+        else                      { res.lost++; }
+    }
+
+    return res;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+
+    program_name = argv[0];
+
+    // while args left..
+    int a = 1; int last_a = 1;
+    do {
+        last_a = a;
+        // two args
+        if (a+1 < argc) {
+            if (!strcmp (argv[a], "-n")) {
+                nbytes = atoi(argv[a+1]);
+                a += 2;
+            } else if (!strcmp (argv[a], "-j")) {
+                jitter = atof(argv[a+1]);
+                a += 2;
+            } else if (!strcmp (argv[a], "-s")) {
+                skew = atof(argv[a+1]);
+                a += 2;
+            } else if (!strcmp (argv[a], "-g")) {
+                glitches = atof(argv[a+1]);
+                a += 2;
+            } else if (!strcmp (argv[a], "-d")) {
+                gap = atof(argv[a+1]);
+                a += 2;
+            } else if (!strcmp (argv[a], "-r")) {
+                seed = atoi(argv[a+1]);
+                a += 2;
+            }
+        }
+
+        // one arg (a may have changed)
+        if (a < argc) {
+            if (!strcmp (argv[a], "--help")) {
+                fprintf (stdout, "\nMeasure the bit error rate of the blinken64 pulse link (simulated).\n");
+                fprintf (stdout, "\nUsage: %s [-n bytes] [-j us] [-s %%] [-g n] [-d us] [-r seed]\n", program_name);
+                fprintf (stdout, "\n    -n bytes         bytes per speed (default %d)", nbytes);
+                fprintf (stdout, "\n    -j us            max jitter per edge (default %.0f)", jitter);
+                fprintf (stdout, "\n    -s %%             max receiver clock deviation (default %.0f)", skew);
+                fprintf (stdout, "\n    -g n             glitches per second (default %.0f)", glitches);
+                fprintf (stdout, "\n    -d us            idle time between bytes (default %.0f)", gap);
+                fprintf (stdout, "\n    -r seed          random seed\n\n");
+
+                exit (EXIT_SUCCESS);
+            }
+        }
+
+    } while ( (a < argc) && (a != last_a) );
+
+    srand(seed);
+
+    fprintf (stdout, "jitter +/-%.0fus, skew +/-%.0f%%, %.1f glitches/s, %d bytes per run\n\n", jitter, skew, glitches, nbytes);
+    fprintf (stdout, "tick   bit/s  parity       ok    wrong  dropped     lost  BER (undetected)\n");
+
+    unsigned s;
+    for (s=0; s<NUMSPEEDS; s++) {
+        int parity;
+        for (parity=0; parity<2; parity++) {
+            struct result r = run(speeds[s], parity);
+            double bitrate = 1e6 / ((COM_T_LOW + COM_T_HIGH) / 2.0 * speeds[s]);
+            fprintf (stdout, "%3dus %7.0f  %-6s %8ld %8ld %8ld %8ld  %.2e\n",
+                     speeds[s], bitrate, parity ? "yes" : "no",
+                     r.ok, r.wrong, r.dropped, r.lost,
+                     (double)r.biterrors / (r.sent * 8.0));
+        }
+    }
+
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,514 @@
+/*
+ * blinken64 tools / mock/Arduino.cpp
+ *
+ * Simulated arduino core for blinkenprog.pde: runs setup() and loop() on
+ * simulated time, feeds stdin through the serial port at the given baud rate
+ * (honouring the CTS pin), emulates timer 1 / OC1B and records every edge on
+ * the output pin. When the input is sent and the line idle, the edges are
+ * decoded again and checked against the input and the nominal pulse lengths.
+ * With framecheck a display built w/ _FRAME_CHECK_ sits on the output pin: it
+ * takes the frames like blinken.c in PROG mode, writes its eeprom and answers
+ * ACK / NAK on inPin w/ the timing of transmit(). Its eeprom is checked then.
+ * In STREAM mode a chain of displays in SLAVE mode is on the output pin, its
+ * end on inPin: every column comes out 8 columns per display later. The last
+ * display sends like blinken.c, right after the column before if it is behind,
+ * and a column that comes in while one waits replaces it. What the bridge
+ * passes on to the host has to be what came out, w/o a byte lost.
+ *
+ * usage: blinkenprog-host [-s [-c displays] | -f [-e byte] [-p byte]] [-l latency_us] [-t tracefile] < data
+ *    -s   hold key B during reset (STREAM mode)
+ *    -c   displays in the chain (default 1)
+ *    -f   hold key A during reset (PROG w/ framecheck)
+ *    -e   the display gets two bits of this byte wrong (crc fails: NAK)
+ *    -p   the display gets one bit of this byte wrong (parity: dropped, no answer)
+ *    -l   ISR latency in us (default 3)
+ *    -t   write all edges as "<us> <level>" lines
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Arduino.h"
+#include "../../firmware/comm.h"
+
+// pins of blinkenprog.pde
+#define OUTPIN      10
+#define INPIN       11
+#define CTSPIN      12
+#define KEYAPIN     2
+#define KEYBPIN     3
+
+#define SERIAL_BUF  64              // rx buffer of the arduino core
+#define T_IDLE_END  6000000000ULL   // ns w/o activity -> done
+
+// the display (framecheck)
+#define T_TICK      50000ULL        // ns, its ISR
+#define T_EEPROM    3400000ULL      // ns per eeprom_write_byte
+#define T_SLAVE     20000ULL        // ns from a column to its transmit() (SLAVE)
+#define EE_BEGIN    2               // EEPROM_BEGIN
+#define EE_SIZE     256             // attiny4313
+
+
+// from blinkenprog.pde
+extern long refbit, refbit_low, refbit_high;
+extern boolean framecheck, streaming;
+#define bytedelay   20      // ms
+
+
+//----------------------------------------------------------------------
+// state
+
+static uint64_t now = 0;                // ns
+static uint8_t port[32];
+static bool irq_on = true;
+static uint64_t latency = 3000;         // ns
+static bool keya_held = false, keyb_held = false;
+static FILE *trace = NULL;
+
+// serial
+static std::vector<uint8_t> input;
+static size_t input_pos = 0;            // next byte the host sends
+static uint8_t rxbuf[SERIAL_BUF];
+static int rx_head = 0, rx_used = 0;
+static uint64_t byte_ns = 0;            // 0 : not begun
+static uint64_t next_arrival = 0;
+static uint64_t last_input = 0;
+static long overruns = 0;
+static uint64_t cts_paused = 0;         // ns the host had to wait
+
+// timer 1
+static bool oc1b = false;
+static uint64_t last_match = 0;         // absolute tick
+static bool isr_pending = false;
+static uint64_t isr_due = 0;
+
+// output pin
+struct edge { uint64_t t; bool level; };
+static std::vector<edge> edges;
+static bool line = false;
+
+// the display on the output pin, what it sends goes to inPin
+static struct {
+    size_t at;                          // next edge to decode
+    int bitpos;                         // -1 : waits for the start edge
+    int b, parity;
+    long n;                             // bytes decoded
+    int sync;                           // 0xAA of the init sequence seen
+    uint8_t frame[COM_FRAME_MAX + 3];
+    int f;
+    unsigned addr;
+    uint64_t ready;                     // back in the receive loop
+    uint8_t ee[EE_SIZE];
+    long frames, naks, dropped;
+} disp = { 0, -1 };
+static long flip2 = -1, flip1 = -1;
+static std::vector<edge> back;          // level changes on inPin, high before the first
+static size_t back_at = 0;
+
+// STREAM: the chain, what comes out at its end, what the bridge passed on
+static std::vector<uint8_t> chain(8, 0x00);
+static std::vector<uint8_t> chain_out, host;
+static int chain_wait = -1;             // column in rxBuff while the display sends
+static long chain_lost = 0;
+
+
+static void finish(void);
+
+
+//----------------------------------------------------------------------
+// registers w/ side effects
+
+static bool outLevel(void) {
+    return (TCCR1A & ((1 << COM1B1) | (1 << COM1B0))) ? oc1b : port[OUTPIN];
+}
+
+static void updateLine(void) {
+    bool l = outLevel();
+    if (l != line) {
+        line = l;
+        if (!edges.empty() && edges.back().t == now) {     // zero length glitch
+            edges.pop_back();
+            return;
+        }
+        edges.push_back((edge){ now, l });
+        if (trace) { fprintf(trace, "%.3f %d\n", now / 1000.0, l); }
+    }
+}
+
+static void forceCompare(void) {
+    if (TCCR1C & (1 << FOC1B)) {
+        uint8_t com = (TCCR1A >> COM1B0) & 0x03;
+        if (com == 1) { oc1b = !oc1b; }
+        if (com == 2) { oc1b = false; }
+        if (com == 3) { oc1b = true; }
+        TCCR1C.v = 0;
+    }
+    updateLine();
+}
+
+static void clearFlags(void) { TIFR1.v = 0; }     // only OCF1B used, written to clear it
+
+MockReg8 TCCR1A = { 0, updateLine };
+MockReg8 TCCR1C = { 0, forceCompare };
+MockReg8 TIFR1  = { 0, clearFlags };
+volatile uint8_t TCCR1B, TIMSK1;
+volatile uint16_t OCR1B;
+
+uint16_t mock_tcnt1(void) { return (now / 500) & 0xFFFF; }
+
+
+//----------------------------------------------------------------------
+// simulated time
+
+static uint64_t nextMatch(void) {
+    uint64_t a = now / 500;
+    uint64_t d = (uint16_t)(OCR1B - (a & 0xFFFF));
+    if (d == 0) { d = 0x10000; }
+    uint64_t m = a + d;
+    if (m <= last_match) { m += 0x10000; }
+    return m;
+}
+
+static bool timerRunning(void) {
+    return (TCCR1B & 0x07) == (1 << CS11)
+        && ((TCCR1A & ((1 << COM1B1) | (1 << COM1B0))) || (TIMSK1 & (1 << OCIE1B)));
+}
+
+static void serialArrival(void) {
+    if (port[CTSPIN]) {                         // host waits for CTS
+        cts_paused += byte_ns;
+    } else if (rx_used == SERIAL_BUF) {
+        overruns++;
+        input_pos++;
+    } else {
+        rxbuf[(rx_head + rx_used++) % SERIAL_BUF] = input[input_pos++];
+    }
+    last_input = now;
+    next_arrival += byte_ns;
+}
+
+static void advance(uint64_t ns) {
+    uint64_t target = now + ns;
+
+    for (;;) {
+        uint64_t t = target;
+        int ev = 0;
+
+        if (byte_ns && input_pos < input.size() && next_arrival <= t) { t = next_arrival; ev = 1; }
+        if (timerRunning()) {
+            uint64_t m = nextMatch() * 500;
+            if (m <= t) { t = m; ev = 2; }
+        }
+        if (isr_pending && irq_on && isr_due <= t) { t = isr_due; ev = 3; }
+
+        if (t > now) { now = t; }
+        if (ev == 0) { break; }
+
+        if (ev == 1) {
+            serialArrival();
+
+        } else if (ev == 2) {
+            last_match = now / 500;
+            uint8_t com = (TCCR1A >> COM1B0) & 0x03;
+            if (com == 1) { oc1b = !oc1b; }
+            if (com == 2) { oc1b = false; }
+            if (com == 3) { oc1b = true; }
+            updateLine();
+            TIFR1.v |= (1 << OCF1B);
+            if ((TIMSK1 & (1 << OCIE1B)) && !isr_pending) { isr_pending = true; isr_due = now + latency; }
+
+        } else {
+            isr_pending = false;
+            TIFR1.v &= ~(1 << OCF1B);
+            irq_on = false;
+            TIMER1_COMPB_vect();
+            irq_on = true;
+            updateLine();
+        }
+    }
+
+    // done?
+    if (input_pos == input.size() && rx_used == 0 && !timerRunning()
+            && now - last_input > T_IDLE_END
+            && (edges.empty() || now - edges.back().t > T_IDLE_END)) {
+        finish();
+    }
+}
+
+
+//----------------------------------------------------------------------
+// the display: the ISR of blinken.c on the recorded edges, the PROG loop
+// w/ _FRAME_CHECK_ on the bytes, transmit() for the answer. In STREAM the
+// chain, the last display sends what falls out of it
+
+// returns when the line is high again
+static uint64_t transmit(uint64_t t, uint8_t c) {
+    bool l = false;
+    int i, p = 0;
+    back.push_back((edge){ t, l });
+    for (i=0; i<8; i++) {
+        int one = (c >> i) & 1;
+        t += (one ? COM_T_HIGH : COM_T_LOW) * T_TICK;
+        back.push_back((edge){ t, l = !l });
+        p ^= one;
+    }
+    if (framecheck) {
+        t += (p ? COM_T_HIGH : COM_T_LOW) * T_TICK;
+        back.push_back((edge){ t, l = !l });
+    }
+    t += COM_T_BIT/2 * T_TICK;
+    if (!l) { back.push_back((edge){ t, true }); }
+    return t;
+}
+
+static void received(uint64_t t, int b) {
+    uint64_t ready = t > disp.ready ? t : disp.ready;
+    int i;
+
+    if (streaming) {
+        if (t < disp.ready) {               // still sending
+            if (chain_wait >= 0) { chain_lost++; }
+            chain_wait = b;
+            return;
+        }
+        chain.push_back(b);
+        chain_out.push_back(chain.front());
+        chain.erase(chain.begin());
+        disp.ready = transmit(t + T_SLAVE, chain_out.back());
+        return;
+    }
+
+    if (ready - disp.ready > COM_T_FRAME_GAP * 1000000ULL) { disp.f = 0; }
+    disp.ready = ready;
+
+    if (disp.sync < 2) {                // 0x55, init sequence
+        if (b == 0xAA) { disp.sync++; }
+        return;
+    }
+    disp.frame[disp.f++] = b;
+    if (disp.f > 1 && (disp.frame[1] > COM_FRAME_MAX || disp.f == disp.frame[1] + 3)) {
+        uint8_t crc = 0, ack = COM_NAK;
+        for (i=0; i<disp.f; i++) {
+            crc ^= disp.frame[i];
+            for (int k=0; k<8; k++) { crc = (crc & 1) ? (crc >> 1) ^ 0x8C : (crc >> 1); }
+        }
+        unsigned a = disp.addr;
+        if (disp.frame[0] < (a & 0xFF)) { a += 0x100; }
+        a = (a & 0xFF00) | disp.frame[0];
+        if (!crc && disp.frame[1] <= COM_FRAME_MAX
+                 && a >= EE_BEGIN && a + disp.frame[1] <= EE_SIZE) {
+            memcpy(disp.ee + a, disp.frame + 2, disp.frame[1]);
+            disp.addr = a;
+            disp.ready += disp.frame[1] * T_EEPROM;
+            ack = COM_ACK;
+        } else {
+            disp.naks++;
+        }
+        disp.frames++;
+        disp.f = 0;
+        disp.ready = transmit(disp.ready, ack);
+    }
+}
+
+// decode the edges up to now (the last one may still vanish as a glitch)
+static void display(void) {
+    if (!framecheck && !streaming) { return; }
+    for (; disp.at < edges.size() && edges[disp.at].t < now; disp.at++) {
+        edge &e = edges[disp.at];
+        if (disp.bitpos < 0) {
+            if (!e.level) { disp.bitpos = 0; disp.b = 0; disp.parity = 0; }
+            continue;
+        }
+        int one = e.t - edges[disp.at-1].t >= (uint64_t)refbit * 1000;
+        if (disp.bitpos < 8) { disp.b |= one << disp.bitpos; }
+        disp.parity ^= one;
+        if (++disp.bitpos == (framecheck ? 9 : 8)) {
+            disp.bitpos = -1;
+            if (disp.n == flip2) { disp.b ^= 0x11; }
+            if (disp.n == flip1) { disp.b ^= 0x01; disp.parity ^= 1; }
+            disp.n++;
+            if (framecheck && disp.parity) { disp.dropped++; continue; }
+            received(e.t, disp.b);
+        }
+    }
+    // the column that came in meanwhile, once the one before is out
+    if (chain_wait >= 0 && now + T_SLAVE >= disp.ready) {
+        int b = chain_wait;
+        chain_wait = -1;
+        uint64_t t = disp.ready;
+        disp.ready = 0;
+        received(t, b);
+    }
+}
+
+
+//----------------------------------------------------------------------
+// core api
+
+void pinMode(uint8_t pin, uint8_t mode) { advance(1000); }
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    port[pin & 31] = val ? 1 : 0;
+    updateLine();
+    advance(4000);
+}
+
+int digitalRead(uint8_t pin) {
+    advance(1000);
+    if (pin == KEYAPIN && keya_held && now < 100000000ULL) { return LOW; }
+    if (pin == KEYBPIN && keyb_held && now < 100000000ULL) { return LOW; }
+    if (pin == INPIN) {
+        display();
+        while (back_at < back.size() && back[back_at].t <= now) { back_at++; }
+        return back_at ? back[back_at-1].level : HIGH;
+    }
+    return HIGH;
+}
+
+unsigned long millis(void) { advance(1000); return now / 1000000; }
+unsigned long micros(void) { advance(1000); return now / 1000; }
+void delay(unsigned long ms) { advance(ms * 1000000ULL); }
+void delayMicroseconds(unsigned int us) { advance(us * 1000ULL); }
+
+void interrupts(void)   { irq_on = true; }
+void noInterrupts(void) { irq_on = false; }
+
+
+MockSerial Serial;
+
+void MockSerial::begin(long baud) {
+    byte_ns = 10 * 1000000000ULL / baud;
+    next_arrival = now + byte_ns;
+}
+
+int MockSerial::available(void) { advance(1000); return rx_used; }
+
+int MockSerial::read(void) {
+    advance(1000);
+    if (!rx_used) { return -1; }
+    int c = rxbuf[rx_head];
+    rx_head = (rx_head + 1) % SERIAL_BUF;
+    rx_used--;
+    return c;
+}
+
+void MockSerial::flush(void) { rx_used = 0; }
+
+size_t MockSerial::write(uint8_t b) { host.push_back(b); fputc(b, stderr); return 1; }
+
+void MockSerial::print(const char *s)      { fputs(s, stderr); }
+void MockSerial::print(char c)             { fputc(c, stderr); }
+void MockSerial::print(long n, int base)   { fprintf(stderr, base == HEX ? "%lx" : "%ld", n); }
+void MockSerial::println(const char *s)    { fprintf(stderr, "%s\n", s); }
+void MockSerial::println(long n, int base) { print(n, base); fputc('\n', stderr); }
+
+
+
+//----------------------------------------------------------------------
+// decode the recorded edges, check against input and nominal timing
+
+static void finish(void) {
+
+    std::vector<uint8_t> got;
+    double min0 = 1e9, max0 = 0, min1 = 1e9, max1 = 0;
+    uint64_t first = 0, last = 0;
+    int bits = framecheck ? 9 : 8;
+    long parityErrors = 0, initErrors = 0;
+    int init = 0;                           // init sequence bytes still expected
+    size_t i = 0;
+
+    while (i + bits < edges.size()) {
+        if (edges[i].level) { i++; continue; }          // HI-LO start edge
+
+        // PROG mode: every burst (long pause before) starts w/ the init sequence
+        if (!streaming && (i == 0 || edges[i].t - edges[i-1].t > bytedelay * 500000ULL)) { init = 3; }
+
+        int b = 0, p = 0, k;
+        for (k = 0; k < bits; k++) {
+            double us = (edges[i+k+1].t - edges[i+k].t) / 1000.0;
+            int one = us >= refbit;
+            if (k < 8) { b |= one << k; }
+            p ^= one;
+            if (one) { if (us < min1) { min1 = us; } if (us > max1) { max1 = us; } }
+            else     { if (us < min0) { min0 = us; } if (us > max0) { max0 = us; } }
+        }
+        if (framecheck && p) { parityErrors++; }
+        if (!first) { first = edges[i].t; }
+        last = edges[i+bits].t;
+        i += framecheck ? bits + 1 : bits + 2;
+
+        if (init) {
+            if (b != (init == 3 ? 0x55 : 0xAA)) { initErrors++; }
+            init--;
+        } else {
+            got.push_back(b);
+        }
+    }
+
+    // w/ framecheck the frames come again: the display's eeprom counts
+    size_t errors = initErrors;
+    if (framecheck) {
+        display();
+        errors = disp.sync < 2;
+        for (size_t j = 0; j < input.size(); j++) {
+            if (EE_BEGIN + j >= EE_SIZE || disp.ee[EE_BEGIN + j] != input[j]) { errors++; }
+        }
+    } else {
+        for (size_t j = 0; j < input.size() || j < got.size(); j++) {
+            if (j >= input.size() || j >= got.size() || input[j] != got[j]) { errors++; }
+        }
+    }
+    if (streaming) {
+        display();
+        if (host != chain_out) { errors++; }
+    }
+
+    double secs = (last - first) / 1e9;
+    fprintf(stdout, "mode            %s\n", streaming ? "STREAM" : framecheck ? "PROG (framecheck)" : "PROG");
+    fprintf(stdout, "bytes in/out    %zu / %zu, %zu mismatches, %ld parity errors\n", input.size(), got.size(), errors, parityErrors);
+    if (streaming) {
+        fprintf(stdout, "end of chain    %zu / %zu bytes to the host%s, %ld columns lost in the chain\n", host.size(), chain_out.size(),
+                host == chain_out ? "" : ", not what came out", chain_lost);
+    }
+    if (framecheck) {
+        fprintf(stdout, "display         %ld frames, %ld NAKed, %ld bytes dropped (parity)\n", disp.frames, disp.naks, disp.dropped);
+    }
+    fprintf(stdout, "serial          %ld overruns, host paused by CTS for %.1f ms\n", overruns, cts_paused / 1e6);
+    fprintf(stdout, "0 pulses        %.1f .. %.1f us (nominal %ld)\n", min0, max0, refbit_low);
+    fprintf(stdout, "1 pulses        %.1f .. %.1f us (nominal %ld)\n", min1, max1, refbit_high);
+    if (secs > 0) {
+        fprintf(stdout, "throughput      %.1f bytes/s on the wire (%.3f s)\n", got.size() / secs, secs);
+    }
+
+    if (trace) { fclose(trace); }
+    exit(errors || overruns ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+
+
+int main(int argc, char **argv) {
+    int c;
+    while ((c = getopt(argc, argv, "sc:fe:p:l:t:")) != -1) {
+        switch (c) {
+            case 's' : keyb_held = true; break;
+            case 'c' : chain.assign(8 * atoi(optarg), 0x00); break;
+            case 'f' : keya_held = true; break;
+            case 'e' : flip2 = atol(optarg); break;
+            case 'p' : flip1 = atol(optarg); break;
+            case 'l' : latency = atof(optarg) * 1000; break;
+            case 't' : trace = fopen(optarg, "w"); break;
+            default  : return EXIT_FAILURE;
+        }
+    }
+
+    while ((c = getchar()) != EOF) { input.push_back(c); }
+    memset(disp.ee, 0xFF, sizeof(disp.ee));
+
+    // the core leaves the line low until the sketch says otherwise
+    line = false;
+
+    setup();
+    for (;;) { loop(); }
+}
@@ -0,0 +1,85 @@
+/*
+ * blinken64 tools / mock/Arduino.h
+ *
+ * Just enough of the arduino core to build blinkenprog.pde on a PC. Time is
+ * simulated, timer 1 toggles outPin (OC1B) on compare match like the real
+ * one, serial input comes from stdin. See Arduino.cpp.
+ */
+
+#ifndef __MOCK_ARDUINO_H__
+# define __MOCK_ARDUINO_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH    1
+#define LOW     0
+#define INPUT   0
+#define OUTPUT  1
+#define DEC     10
+#define HEX     16
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void interrupts(void);
+void noInterrupts(void);
+
+
+class MockSerial {
+  public:
+    void begin(long baud);
+    int available(void);
+    int read(void);
+    size_t write(uint8_t b);
+    void flush(void);
+    void print(const char *s);
+    void print(char c);
+    void print(long n, int base = DEC);
+    void println(const char *s);
+    void println(long n, int base = DEC);
+};
+
+extern MockSerial Serial;
+
+
+// registers that do something when written
+struct MockReg8 {
+    uint8_t v;
+    void (*hook)(void);
+    operator uint8_t() const { return v; }
+    MockReg8& operator=(uint8_t x)  { v = x; if (hook) { hook(); } return *this; }
+    MockReg8& operator|=(uint8_t x) { return *this = v | x; }
+    MockReg8& operator&=(uint8_t x) { return *this = v & x; }
+};
+
+// timer 1 (atmega328p), 0.5 us per tick
+extern MockReg8 TCCR1A, TCCR1C, TIFR1;
+extern volatile uint8_t TCCR1B, TIMSK1;
+extern volatile uint16_t OCR1B;
+uint16_t mock_tcnt1(void);
+#define TCNT1   (mock_tcnt1())
+
+#define COM1B1  5
+#define COM1B0  4
+#define FOC1B   6
+#define CS11    1
+#define OCIE1B  2
+#define OCF1B   2
+
+#define ISR(vect)   void vect(void)
+void TIMER1_COMPB_vect(void);
+
+void setup(void);
+void loop(void);
+
+#endif
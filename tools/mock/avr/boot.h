@@ -0,0 +1,19 @@
+/*
+ * blinken64 tools / mock/avr/boot.h
+ *
+ * Self programming of the mock attiny4313, see mock/bootloader.cpp.
+ */
+
+#ifndef __MOCK_AVR_BOOT_H__
+# define __MOCK_AVR_BOOT_H__
+
+#include <stdint.h>
+
+#define SPM_PAGESIZE    (64)
+
+void boot_page_erase(uint16_t addr);
+void boot_page_fill(uint16_t addr, uint16_t w);
+void boot_page_write(uint16_t addr);
+void boot_spm_busy_wait(void);
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * blinken64 tools / mock/avr/io.h
+ *
+ * Just enough of an attiny4313 to build firmware/bootloader.c on a PC: the
+ * pins of comm.h and the flag of timer 1. Reading the input pin moves the
+ * simulated time on, see mock/bootloader.cpp.
+ */
+
+#ifndef __MOCK_AVR_IO_H__
+# define __MOCK_AVR_IO_H__
+
+#include <stdint.h>
+
+#define PA2     2
+#define PD6     6
+
+#define WGM12   3
+#define CS10    0
+#define OCF1A   6
+
+extern volatile uint8_t PORTA, DDRA, PORTD, DDRD, TCCR1B;
+extern volatile uint16_t OCR1A;
+
+uint8_t mock_pind(void);
+#define PIND    (mock_pind())
+
+// OCF1A is set by the timer, written w/ a one to clear it
+struct MockTifr {
+    operator uint8_t() const;
+    MockTifr& operator=(uint8_t x);
+};
+extern MockTifr TIFR;
+
+// start() of the bootloader: a call into the application
+void mock_jump(uint16_t word);
+#define jump(_word)     mock_jump(_word)
+
+// main() of the bootloader, called by the simulation
+#define main            bootMain
+
+#endif
@@ -0,0 +1,12 @@
+/*
+ * blinken64 tools / mock/avr/pgmspace.h
+ */
+
+#ifndef __MOCK_AVR_PGMSPACE_H__
+# define __MOCK_AVR_PGMSPACE_H__
+
+#include <stdint.h>
+
+uint16_t pgm_read_word(uint16_t addr);
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * blinken64 tools / mock/bootloader.cpp
+ *
+ * Simulated attiny4313 for firmware/bootloader.c: the frames of bootconv come
+ * in as pulses on the input pin, the way blinkenprog.pde sends them (PROG
+ * mode: the line low at reset, the calibration byte and the init sequence
+ * before the burst). Page erase and write take as long as on the
+ * part, the input is not polled meanwhile. The flash holds an old application
+ * at the start. When the bootloader jumps, or nothing happens on the line for
+ * a while, the flash is checked against the image: word 0 a rjmp to the
+ * bootloader, the trampoline below it a rjmp to the reset handler of the
+ * image, every page bootconv sent written. A mix of the old and the new
+ * application must never be started.
+ *
+ * usage: bootloader-host [-s us] [-c bytes] [-e byte] [-d] -i frames -a image
+ *        bootloader-host -m size > image
+ *    -s   tick of the programmer in us (default 50)
+ *    -c   the frames end after this many bytes: the old application or
+ *         nothing may be started, the new one is not complete
+ *    -e   flip a bit of this byte of the frames (a page w/ a bad crc, it
+ *         has to come again: bootconv -r 2)
+ *    -d   the page count of the DONE frame one less, w/ -e on a page of
+ *         a single image: the count of the pages that made it, but not
+ *         what was sent. Its crc has to catch it, nothing may be started
+ *    -n   noise before the burst: bytes other than 0x55 / 0xAA must not
+ *         change the bit threshold
+ *    -m   write a made up application image of size bytes
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "avr/io.h"
+#include "avr/boot.h"
+#include "avr/pgmspace.h"
+#include "../../firmware/comm.h"
+#include "../../firmware/bootloader.h"
+
+#undef main                             // ours, the bootloader's is bootMain()
+
+#define FLASH_SIZE      (4096)
+#define BOOT_PAGES      (BOOTSTART / SPM_PAGESIZE)
+
+#define T_POLL          (5000)          // ns per pass through the polling loop of rx()
+#define T_TICK          (50000)         // ns, timer 1 CTC at OCR1A 199
+#define T_SPM           (4500000)       // ns, page erase / write (tWD_FLASH)
+#define T_LEAD          (20000000ULL)   // ns low before the first byte
+#define T_GAP           (2000)          // us, bytegap of blinkenprog.pde
+#define T_BYTEDELAY     (20000)         // us high before a burst
+#define T_IDLE_END      (5000000000ULL) // ns w/o an edge after the last one -> done
+
+#define OLD_APP         (0x5A)          // the old application, every byte
+#define APP_VECTOR      (0xC012)        // made up images: rjmp to word 0x13, past the vectors
+
+// word address an rjmp at word _at goes to
+#define RJMP_TARGET(_at, _w)    (((_at) + 1 + (((_w) & 0x0800) ? ((_w) | ~0x0FFF) : ((_w) & 0x0FFF))) & (FLASH_SIZE/2 - 1))
+#define RJMP(_from, _to)        (0xC000 | (((_to) - (_from) - 1) & 0x0FFF))
+
+void bootMain(void);
+
+struct Jump { uint16_t word; };
+struct Idle { };
+
+
+//----------------------------------------------------------------------
+// state
+
+static uint64_t now = 0;                // ns
+static uint64_t nextTick = 0;
+static bool ocf1a = false;
+static uint64_t spmBusy = 0;            // ns of erase / write pending
+
+static uint8_t flash[FLASH_SIZE];
+static uint16_t spmBuffer[SPM_PAGESIZE/2];
+static int erases = 0, writes = 0;
+static bool selfWrite = false;          // bootloader tried to write itself
+
+// the line: level changes, from low at reset
+struct edge { uint64_t t; bool level; };
+static std::vector<edge> edges;
+static size_t at = 0;                   // next edge
+
+volatile uint8_t PORTA, DDRA, PORTD, DDRD, TCCR1B;
+volatile uint16_t OCR1A;
+MockTifr TIFR;
+
+
+static void advance(uint64_t ns) {
+    now += ns;
+    if (TCCR1B & (1 << CS10)) {
+        if (!nextTick) { nextTick = now + T_TICK; }
+        while (nextTick <= now) { ocf1a = true; nextTick += T_TICK; }
+    }
+    while (at < edges.size() && edges[at].t <= now) { at++; }
+    if (at == edges.size() && now > edges.back().t + T_IDLE_END) { throw Idle(); }
+}
+
+uint8_t mock_pind(void) {
+    advance(T_POLL);
+    return (at && edges[at-1].level) ? (1 << PD6) : 0;
+}
+
+MockTifr::operator uint8_t() const { return ocf1a ? (1 << OCF1A) : 0; }
+MockTifr& MockTifr::operator=(uint8_t x) { if (x & (1 << OCF1A)) { ocf1a = false; } return *this; }
+
+void mock_jump(uint16_t word) { throw Jump{ word }; }
+
+
+//----------------------------------------------------------------------
+// self programming
+
+void boot_page_fill(uint16_t addr, uint16_t w) { spmBuffer[(addr % SPM_PAGESIZE) / 2] = w; }
+
+void boot_page_erase(uint16_t addr) {
+    addr &= ~(SPM_PAGESIZE - 1);
+    if (addr >= BOOTSTART) { selfWrite = true; return; }
+    memset(flash + addr, 0xFF, SPM_PAGESIZE);
+    spmBusy += T_SPM;
+    erases++;
+}
+
+void boot_page_write(uint16_t addr) {
+    int i;
+    addr &= ~(SPM_PAGESIZE - 1);
+    if (addr >= BOOTSTART) { selfWrite = true; return; }
+    for (i=0; i<SPM_PAGESIZE/2; i++) {
+        flash[addr + 2*i]     &= spmBuffer[i];
+        flash[addr + 2*i + 1] &= spmBuffer[i] >> 8;
+        spmBuffer[i] = 0xFFFF;
+    }
+    spmBusy += T_SPM;
+    writes++;
+}
+
+void boot_spm_busy_wait(void) {
+    uint64_t t = spmBusy;
+    spmBusy = 0;
+    advance(t);
+}
+
+uint16_t pgm_read_word(uint16_t addr) { return flash[addr] | (flash[addr+1] << 8); }
+
+static uint16_t word(const uint8_t *mem, int addr) { return mem[addr] | (mem[addr+1] << 8); }
+
+
+//----------------------------------------------------------------------
+// the programmer
+
+static void level(bool l, double us) {
+    static uint64_t t = 0;
+    if (edges.empty() || edges.back().level != l) { edges.push_back((edge){ t, l }); }
+    t += us * 1000;
+}
+
+// gap (high), start edge, a pulse per bit, stop: like the bridge
+static void sendByte(uint8_t c, double tick) {
+    int i;
+    bool l = false;
+    level(true, T_GAP);
+    for (i=0; i<8; i++) {
+        level(l, ((c & (1 << i)) ? COM_T_HIGH : COM_T_LOW) * tick);
+        l = !l;
+    }
+    level(l, COM_T_BIT/2 * tick);
+}
+
+
+static int readFile(const char *name, std::vector<uint8_t> &v) {
+    FILE *f = fopen(name, "rb");
+    int c;
+    if (f == NULL) { return -1; }
+    while ((c = fgetc(f)) != EOF) { v.push_back(c); }
+    fclose(f);
+    return v.size();
+}
+
+
+
+int main(int argc, char **argv) {
+    std::vector<uint8_t> frames, app;
+    const char *framesFile = NULL, *appFile = NULL;
+    double tick = 50;
+    long cut = -1, flip = -1;
+    bool noise = false, garble = false;
+    int c, i;
+
+    while ((c = getopt(argc, argv, "s:c:e:dni:a:m:")) != -1) {
+        switch (c) {
+            case 's' : tick = atof(optarg); break;
+            case 'c' : cut = atol(optarg); break;
+            case 'e' : flip = atol(optarg); break;
+            case 'd' : garble = true; break;
+            case 'n' : noise = true; break;
+            case 'i' : framesFile = optarg; break;
+            case 'a' : appFile = optarg; break;
+            case 'm' :
+                srand(1);
+                for (i=0; i<atoi(optarg); i++) { putchar(i == 0 ? APP_VECTOR & 0xFF : i == 1 ? APP_VECTOR >> 8 : rand()); }
+                return EXIT_SUCCESS;
+            default  : return EXIT_FAILURE;
+        }
+    }
+    if (!framesFile || !appFile || readFile(framesFile, frames) < 0 || readFile(appFile, app) < 2) {
+        fprintf(stderr, "%s: need -i frames (bootconv) and -a image\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (cut >= (long)frames.size()) { cut = -1; }
+    if (cut >= 0) { frames.resize(cut); }
+    if (flip >= 0 && flip < (long)frames.size()) { frames[flip] ^= 0x10; }
+    if (garble && frames.size() >= 3) { frames[frames.size() - 3]--; }    // BOOT_DONE <n> <crc lo> <crc hi>
+
+    // the old application, started through its trampoline
+    memset(flash, 0xFF, sizeof(flash));
+    memset(flash, OLD_APP, BOOT_TRAMPOLINE);
+    flash[0] = RJMP(0, BOOTSTART/2) & 0xFF;
+    flash[1] = RJMP(0, BOOTSTART/2) >> 8;
+    flash[BOOT_TRAMPOLINE]   = RJMP(BOOT_TRAMPOLINE/2, 0x13) & 0xFF;
+    flash[BOOT_TRAMPOLINE+1] = RJMP(BOOT_TRAMPOLINE/2, 0x13) >> 8;
+    std::vector<uint8_t> old(flash, flash + BOOTSTART);
+
+    // low at reset: the bootloader stays. the bridge starts the burst like
+    // every one in PROG mode: high, the calibration byte and the init
+    // sequence. high 20 ms after the last byte, then low again
+    level(false, T_LEAD / 1000);
+    level(true, T_BYTEDELAY);
+    if (noise) {
+        sendByte(0x00, tick);
+        sendByte(0xFF, tick);
+        sendByte(0x3C, tick);
+        level(true, T_BYTEDELAY);
+    }
+    sendByte(0x55, tick);
+    sendByte(0xAA, tick);
+    sendByte(0xAA, tick);
+    for (i=0; i<(int)frames.size(); i++) { sendByte(frames[i], tick); }
+    level(true, 20000);
+    level(false, 0);
+
+    // what the image has to look like in the flash: the pages bootconv sent
+    std::vector<uint8_t> want(BOOTSTART, 0xFF);
+    memcpy(&want[0], &app[0], app.size() < BOOTSTART ? app.size() : BOOTSTART);
+    uint16_t appReset = word(&app[0], 0);
+    want[0] = RJMP(0, BOOTSTART/2) & 0xFF;
+    want[1] = RJMP(0, BOOTSTART/2) >> 8;
+    want[BOOT_TRAMPOLINE]   = RJMP(BOOT_TRAMPOLINE/2, (appReset + 1) & 0x0FFF) & 0xFF;
+    want[BOOT_TRAMPOLINE+1] = RJMP(BOOT_TRAMPOLINE/2, (appReset + 1) & 0x0FFF) >> 8;
+    int last = (app.size() + SPM_PAGESIZE - 1) / SPM_PAGESIZE;
+
+    bool newApp = true, oldApp = true, started = false;
+    const char *result;
+    uint16_t entry = 0;
+
+    try {
+        bootMain();
+    } catch (Jump &j) {
+        started = true;
+        entry = j.word;
+    } catch (Idle &) {
+    }
+
+    for (i=0; i<BOOTSTART; i++) {
+        int p = i / SPM_PAGESIZE;
+        if ((p < last || p == BOOT_PAGES-1) && flash[i] != want[i]) { newApp = false; }
+        if (flash[i] != old[i]) { oldApp = false; }
+    }
+
+    // word 0 has to lead to the bootloader, and from the trampoline to the reset handler of the image
+    bool chain = RJMP_TARGET(0, word(flash, 0)) == BOOTSTART/2
+              && entry == BOOT_TRAMPOLINE/2
+              && RJMP_TARGET(BOOT_TRAMPOLINE/2, word(flash, BOOT_TRAMPOLINE)) == RJMP_TARGET(0, appReset);
+
+    if (selfWrite) {
+        result = "FAILED: wrote to the bootloader";
+    } else if (!started) {
+        result = cut >= 0 || garble ? "nothing started (image not complete)" : "FAILED: nothing started";
+    } else if (newApp && chain) {
+        result = cut >= 0 || garble ? "FAILED: started w/o the whole image" : "new image started";
+    } else if (oldApp && cut >= 0) {
+        result = "old image started (no page came in)";
+    } else {
+        result = "FAILED: started a broken image";
+    }
+
+    fprintf(stdout, "%zu bytes of frames at %g us, %d pages erased, %d written, %.1f s: %s\n",
+            frames.size(), tick, erases, writes, now / 1e9, result);
+    return strncmp(result, "FAILED", 6) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,338 @@
+/*
+ *  blinken64 tools / pnm.c
+ *
+ *  pgm/pbm loader of the tools (pictures, fonts, animations). See pnm.h.
+ *
+ *
+ *  Copyright (C) 2011 Manuel Jerger <nom@nomnom.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "pnm.h"
+
+
+struct pnmtext {
+    const uint8_t *p, *end;
+};
+
+// white space and comments
+static void pnmSpace (struct pnmtext *t) {
+    while (t->p < t->end) {
+        if (*t->p == '#') {
+            while (t->p < t->end && *t->p != '\n' && *t->p != '\r') { t->p++; }
+        } else if (*t->p == ' ' || *t->p == '\n' || *t->p == '\r' || *t->p == '\t' || *t->p == '\v' || *t->p == '\f') {
+            t->p++;
+        } else {
+            break;
+        }
+    }
+}
+
+// decimal number, -1 if there is none (or it is too large)
+static long pnmNumber (struct pnmtext *t) {
+    long v = 0;
+    pnmSpace(t);
+    if (t->p >= t->end || *t->p < '0' || *t->p > '9') { return -1; }
+    while (t->p < t->end && *t->p >= '0' && *t->p <= '9') {
+        v = v * 10 + (*t->p++ - '0');
+        if (v > (1L << 30)) { return -1; }
+    }
+    return v;
+}
+
+
+static int pnmRaster (struct pnmtext *t, int type, struct bl_pnm *img) {
+    long n = (long)img->width * img->height, i, v;
+    int maxval = img->maxval, rowbytes = (img->width + 7) / 8, x, y;
+    uint8_t *pix = img->pix;
+
+    switch (type) {
+
+    case '1':       // ascii bits, need not be separated
+        for (i=0; i<n; i++) {
+            pnmSpace(t);
+            if (t->p >= t->end || (*t->p != '0' && *t->p != '1')) { return -1; }
+            pix[i] = *t->p++ == '0' ? 255 : 0;
+        }
+        return 0;
+
+    case '2':       // the common case inline, comments in the raster the slow way
+        for (i=0; i<n; i++) {
+            const uint8_t *p = t->p;
+            while (p < t->end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) { p++; }
+            if (p < t->end && *p >= '0' && *p <= '9' && t->end - p > 5) {
+                v = *p++ - '0';
+                while (v <= 65535 && *p >= '0' && *p <= '9') { v = v * 10 + (*p++ - '0'); }
+                if (v > 65535) { return -1; }
+                t->p = p;
+            } else {
+                t->p = p;
+                if ((v = pnmNumber(t)) < 0) { return -1; }
+            }
+            if (v > maxval) { v = maxval; }
+            pix[i] = maxval > 255 ? v * 255 / maxval : v;
+        }
+        return 0;
+
+    case '4':       // bits, rows padded to bytes
+        if (t->end - t->p < (long)rowbytes * img->height) { return -1; }
+        for (y=0; y<img->height; y++, t->p += rowbytes) {
+            for (x=0; x<img->width; x++) {
+                *pix++ = (t->p[x >> 3] & (0x80 >> (x & 7))) ? 0 : 255;
+            }
+        }
+        return 0;
+
+    case '5':       // one byte per sample, two (msb first) above 255
+        if (maxval <= 255) {
+            if (t->end - t->p < n) { return -1; }
+            memcpy(pix, t->p, n);
+            for (i=0; i<n; i++) { if (pix[i] > maxval) { pix[i] = maxval; } }
+        } else {
+            if (t->end - t->p < 2*n) { return -1; }
+            for (i=0; i<n; i++) {
+                v = (t->p[2*i] << 8) | t->p[2*i+1];
+                pix[i] = (v > maxval ? maxval : v) * 255 / maxval;
+            }
+        }
+        return 0;
+    }
+    return -1;
+}
+
+
+int bl_pnm_read (const char *file, struct bl_pnm *img) {
+
+    struct pnmtext t;
+    struct stat st;
+    uint8_t *map;
+    long w, h, m = 1;
+    int fd, type;
+
+    memset(img, 0, sizeof(*img));
+
+    fd = open(file, O_RDONLY);
+    if (fd < 0) { img->err = "can not open it"; return -1; }
+    if (fstat(fd, &st) < 0 || st.st_size < 3) {
+        close(fd);
+        img->err = "empty";
+        return -1;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) { img->err = "can not map it"; return -1; }
+
+    t.p = map;
+    t.end = map + st.st_size;
+    type = map[1];
+
+    if (map[0] != 'P' || type < '1' || type > '5' || type == '3') {
+        img->err = "no pgm/pbm (P1, P2, P4, P5)";
+    } else {
+        t.p += 2;
+        w = pnmNumber(&t);
+        h = pnmNumber(&t);
+        if (type == '2' || type == '5') { m = pnmNumber(&t); }
+
+        if (w <= 0 || h <= 0 || w * h > (1L << 28)) {
+            img->err = "bad dimensions";
+        } else if (m <= 0 || m > 65535) {
+            img->err = "bad maxval";
+        } else if ((type == '4' || type == '5') && (t.p >= t.end || (*t.p != ' ' && *t.p != '\n' && *t.p != '\r' && *t.p != '\t'))) {
+            img->err = "no white space after the header";
+        } else {
+            if (type == '4' || type == '5') { t.p++; }     // the raster begins after exactly one
+            img->width = w;
+            img->height = h;
+            img->maxval = m;
+            img->thresh = m > 255 || m == 1 ? 127 : m / 2;
+            img->pix = malloc(w * h);
+            if (img->pix == NULL) {
+                img->err = "out of memory";
+            } else if (pnmRaster(&t, type, img) < 0) {
+                img->err = "image data ends early or is broken";
+            }
+        }
+    }
+
+    munmap(map, st.st_size);
+    if (img->err != NULL) {
+        bl_pnm_free(img);
+        return -1;
+    }
+    return 0;
+}
+
+
+// number in a stream, -1 if there is none. the char after it is consumed
+// (the one white space before a binary raster) unless it starts a comment
+static long pnmFNumber (FILE *f, int *end) {
+    long v = 0;
+    int c;
+
+    do {
+        c = getc(f);
+        if (c == '#') { while ((c = getc(f)) != '\n' && c != '\r' && c != EOF) {} }
+    } while (c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f');
+
+    if (c < '0' || c > '9') { return -1; }
+    while (c >= '0' && c <= '9') {
+        v = v * 10 + (c - '0');
+        if (v > (1L << 30)) { return -1; }
+        c = getc(f);
+    }
+    if (c == '#') { ungetc(c, f); }
+    *end = c;
+    return v;
+}
+
+
+int bl_pnm_fread (FILE *f, struct bl_pnm *img) {
+
+    struct pnmtext t;
+    uint8_t *raw = NULL;
+    long w, h, m = 1, n, i, v;
+    int c, type, end = 0, fail = 0;
+
+    img->err = NULL;
+
+    // white space between the images is fine
+    do { c = getc(f); } while (c == ' ' || c == '\n' || c == '\r' || c == '\t');
+    if (c == EOF) { return 0; }
+    type = getc(f);
+    if (c != 'P' || type < '1' || type > '5' || type == '3') {
+        img->err = "no pgm/pbm (P1, P2, P4, P5)";
+        return -1;
+    }
+
+    w = pnmFNumber(f, &end);
+    h = pnmFNumber(f, &end);
+    if (type == '2' || type == '5') { m = pnmFNumber(f, &end); }
+
+    if (w <= 0 || h <= 0 || w * h > (1L << 28)) {
+        img->err = "bad dimensions";
+        return -1;
+    } else if (m <= 0 || m > 65535) {
+        img->err = "bad maxval";
+        return -1;
+    } else if ((type == '4' || type == '5') && end != ' ' && end != '\n' && end != '\r' && end != '\t') {
+        img->err = "no white space after the header";
+        return -1;
+    }
+
+    // the pixels of the last one if it had the same size
+    n = w * h;
+    if (img->pix == NULL || (long)img->width * img->height != n) {
+        free(img->pix);
+        img->pix = malloc(n);
+    }
+    img->width = w;
+    img->height = h;
+    img->maxval = m;
+    img->thresh = m > 255 || m == 1 ? 127 : m / 2;
+    if (img->pix == NULL) {
+        img->err = "out of memory";
+        return -1;
+    }
+
+    switch (type) {
+
+    case '1':
+        for (i=0; i<n && !fail; i++) {
+            do {
+                c = getc(f);
+                if (c == '#') { while ((c = getc(f)) != '\n' && c != '\r' && c != EOF) {} }
+            } while (c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f');
+            fail = c != '0' && c != '1';
+            img->pix[i] = c == '0' ? 255 : 0;
+        }
+        break;
+
+    case '2':
+        for (i=0; i<n && !fail; i++) {
+            v = pnmFNumber(f, &end);
+            fail = v < 0;
+            if (v > m) { v = m; }
+            img->pix[i] = m > 255 ? v * 255 / m : v;
+        }
+        break;
+
+    // binary: the raster as it is, then like from a file
+    default:
+        v = type == '4' ? (long)(w + 7) / 8 * h : m > 255 ? 2 * n : n;
+        raw = malloc(v);
+        if (raw == NULL || (long)fread(raw, 1, v, f) != v) {
+            fail = 1;
+        } else {
+            t.p = raw;
+            t.end = raw + v;
+            fail = pnmRaster(&t, type, img) < 0;
+        }
+        free(raw);
+    }
+
+    if (fail) {
+        img->err = "image data ends early or is broken";
+        return -1;
+    }
+    return 1;
+}
+
+
+void bl_pnm_free (struct bl_pnm *img) {
+    free(img->pix);
+    img->pix = NULL;
+}
+
+
+void bl_pnm_columns (const struct bl_pnm *img, int x0, int y0, int n, uint8_t *cols) {
+    int x, y, from = x0 < 0 ? -x0 : 0, to = x0 + n > img->width ? img->width - x0 : n;
+
+    memset(cols, 0, n);
+    for (y = 0; y < 8; y++) {
+        if (y0 + y < 0 || y0 + y >= img->height || from >= to) { continue; }
+        const uint8_t *row = img->pix + (long)(y0 + y) * img->width + x0;
+        uint8_t bit = 1 << y;
+
+        x = from;
+#ifdef __SSE2__
+        // 16 pixels at a time: unsigned compare as signed one w/ the sign bits flipped
+        __m128i sign = _mm_set1_epi8((char)0x80), b = _mm_set1_epi8((char)bit);
+        __m128i th = _mm_set1_epi8((char)(img->thresh ^ 0x80));
+        for (; x + 16 <= to; x += 16) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(row + x)), sign);
+            __m128i on = _mm_and_si128(_mm_cmpgt_epi8(v, th), b);
+            __m128i c = _mm_loadu_si128((const __m128i *)(cols + x));
+            _mm_storeu_si128((__m128i *)(cols + x), _mm_or_si128(c, on));
+        }
+#endif
+        for (; x < to; x++) {
+            if (row[x] > img->thresh) { cols[x] |= bit; }
+        }
+    }
+}
@@ -0,0 +1,56 @@
+/*
+ *  blinken64 tools / pnm.h
+ *
+ *  pgm/pbm loader, shared by libblinken (pictures) and fontconv. No font,
+ *  no profile, so fontconv can link it before there is a font.h.
+ *
+ *
+ *  Copyright (C) 2011 Manuel Jerger <nom@nomnom.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __PNM_H__
+#define __PNM_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * netpbm images: P1/P4 bitmaps, P2/P5 greymaps, ascii or binary, any
+ * number of comments in the header. The file is mapped, not read through
+ * stdio. Samples are kept as 8 bit (16 bit ones scaled down). A pixel is
+ * on if it is brighter than half of maxval, like the pictures always were
+ * (in a pbm 1 is black: off)
+ */
+struct bl_pnm {
+    int width, height;
+    int maxval;                     // of the file, 1 for pbm
+    uint8_t *pix;                   // width*height, row by row
+    uint8_t thresh;                 // on: pix > thresh
+    const char *err;                // why it could not be read
+};
+
+// 0, or -1 (img->err says why)
+int bl_pnm_read (const char *file, struct bl_pnm *img);
+// the next image of a stream of them (ffmpeg -f image2pipe -vcodec pgm): 1,
+// 0 at the end, -1 (img->err). img is zeroed before the first one, the
+// pixels are kept for the next one if it has the same size
+int bl_pnm_fread (FILE *f, struct bl_pnm *img);
+void bl_pnm_free (struct bl_pnm *img);
+// 8 rows from y0, n columns from x0 -> cols, bit 0 the top row (pixels outside the image are off)
+void bl_pnm_columns (const struct bl_pnm *img, int x0, int y0, int n, uint8_t *cols);
+
+#endif
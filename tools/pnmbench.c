@@ -0,0 +1,305 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "pnm.h"
+
+#define AUTHORS "Manuel Jerger"
+#define VERSION "0.1"
+
+#define TRUE ~(uint)0
+#define FALSE (uint)0
+
+
+/*
+ * pnmbench : the pgm/pbm loader (pnm.c) against the fscanf reader the tools
+ * had before, on a large sprite sheet. The sheet is written as P2 (w/
+ * comments in the header), P5, P1 and P4; every one is read into 8 pixel
+ * high bands of columns, like the pictures, and has to give the same
+ * columns as the old reader on the P2. One line per format:
+ * file size, ms per read (best of n), MB/s, Mpixel/s, speedup.
+ */
+
+
+char *program_name = "pnmbench";
+
+char *dir = "bench";
+int cols = 8192, rows = 256;        // 1024 sprites of 64x32
+int repeats = 5;
+int quiet = TRUE;
+
+uint8_t *sheet;                     // the pixels, 0 or 255
+
+void info(char *);
+
+
+int64_t now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+// sprites: a frame around a diagonal that moves from sprite to sprite, some noise
+void makeSheet () {
+    int x, y;
+    sheet = malloc((long)cols * rows);
+    srand(64);
+    for (y=0; y<rows; y++) {
+        for (x=0; x<cols; x++) {
+            int sx = x % 64, sy = y % 32, n = x / 64;
+            int on = sx == 0 || sy == 0 || (sx + n) % 32 == sy || rand() % 7 == 0;
+            sheet[(long)y*cols + x] = on ? 255 : 0;
+        }
+    }
+}
+
+
+char *path (const char *ext) {
+    static char name[4][256];
+    static int i;
+    i = (i + 1) % 4;
+    snprintf(name[i], sizeof(name[i]), "%s/sheet.%s", dir, ext);
+    return name[i];
+}
+
+
+void writeSheets () {
+    FILE *f;
+    int x, y, b;
+    long i;
+
+    mkdir(dir, 0777);
+
+    // P2, the way the gimp writes it
+    f = fopen(path("p2.pgm"), "w");
+    if (f == NULL) {
+        fprintf (stderr, "%s: can not write to %s\n", program_name, dir);
+        exit (EXIT_FAILURE);
+    }
+    fprintf (f, "P2\n# CREATOR: pnmbench\n# sprite sheet\n%d %d\n# maxval\n255\n", cols, rows);
+    for (i=0; i<(long)cols*rows; i++) { fprintf (f, "%d\n", sheet[i]); }
+    fclose(f);
+
+    f = fopen(path("p5.pgm"), "w");
+    fprintf (f, "P5\n# sprite sheet\n%d %d\n255\n", cols, rows);
+    fwrite(sheet, 1, (long)cols*rows, f);
+    fclose(f);
+
+    // pbm: 1 is black
+    f = fopen(path("p1.pbm"), "w");
+    fprintf (f, "P1\n# sprite sheet\n%d %d\n", cols, rows);
+    for (y=0; y<rows; y++) {
+        for (x=0; x<cols; x++) {
+            fputc(sheet[(long)y*cols + x] ? '0' : '1', f);
+            if (x % 64 == 63 || x == cols-1) { fputc('\n', f); }
+        }
+    }
+    fclose(f);
+
+    f = fopen(path("p4.pbm"), "w");
+    fprintf (f, "P4\n# sprite sheet\n%d %d\n", cols, rows);
+    for (y=0; y<rows; y++) {
+        for (x=0; x<cols; x+=8) {
+            for (b=0, i=0; i<8; i++) {
+                if (x+i < cols && !sheet[(long)y*cols + x+i]) { b |= 0x80 >> i; }
+            }
+            fputc(b, f);
+        }
+    }
+    fclose(f);
+}
+
+
+// the reader of libblinken/blinkend before pnm.c (any height here), bands of 8 rows -> out
+int oldRead (const char *file, uint8_t *out) {
+    FILE *f = fopen(file, "r");
+    char s[60];
+    int width, height, maxgrey, x, y, v, c;
+
+    if (f == NULL) { return -1; }
+
+    if (fscanf(f, "%59s", s) != 1 || strcmp(s, "P2")) { fclose(f); return -1; }
+    while ((c = fgetc(f)) == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '#') {
+        if (c == '#') { while ((c = fgetc(f)) != '\n' && c != EOF) {} }
+    }
+    ungetc(c, f);
+
+    // comments between the numbers: the old one could not
+    if (fscanf(f, "%d %d", &width, &height) != 2) { fclose(f); return -1; }
+    while ((c = fgetc(f)) == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '#') {
+        if (c == '#') { while ((c = fgetc(f)) != '\n' && c != EOF) {} }
+    }
+    ungetc(c, f);
+    if (fscanf(f, "%d", &maxgrey) != 1) { fclose(f); return -1; }
+
+    memset(out, 0, (long)width * ((height + 7) / 8));
+    for (y = 0; y < height; ++y) {
+        for (x = 0; x < width; ++x) {
+            if (fscanf(f, "%d", &v) != 1) { fclose(f); return -1; }
+            if (v > maxgrey/2) { out[(long)(y/8)*width + x] |= (1 << (y%8)); }
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+
+int newRead (const char *file, uint8_t *out) {
+    struct bl_pnm img;
+    int y;
+
+    if (bl_pnm_read(file, &img) < 0) {
+        fprintf (stderr, "%s: %s: %s\n", program_name, file, img.err);
+        return -1;
+    }
+    for (y=0; y<img.height; y+=8) {
+        bl_pnm_columns(&img, 0, y, img.width, out + (long)(y/8) * img.width);
+    }
+    bl_pnm_free(&img);
+    return 0;
+}
+
+
+// best of repeats, ms
+double timeRead (int (*rd)(const char *, uint8_t *), const char *file, uint8_t *out) {
+    int64_t best = -1, t;
+    int r;
+    for (r=0; r<repeats; r++) {
+        t = now();
+        if (rd(file, out) < 0) { return -1; }
+        t = now() - t;
+        if (best < 0 || t < best) { best = t; }
+    }
+    return best / 1e6;
+}
+
+
+void report (const char *what, const char *file, double ms, double base) {
+    struct stat st;
+    stat(file, &st);
+    fprintf (stdout, "%-14s %10ld %9.2f %9.1f %9.1f %8.1fx\n", what, (long)st.st_size, ms,
+             st.st_size / ms / 1e3, (double)cols * rows / ms / 1e3, base / ms);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+
+    static const char *fmt[4][2] = {
+        { "P2 ascii", "p2.pgm" }, { "P5 binary", "p5.pgm" },
+        { "P1 ascii", "p1.pbm" }, { "P4 binary", "p4.pbm" } };
+    long bands;
+    uint8_t *ref, *out;
+    double base, ms;
+    int i, fail = 0;
+
+    program_name = argv[0];
+
+    // while args left..
+    int a = 1; int last_a = 1;
+    do {
+        last_a = a;
+        // two args
+        if (a+1 < argc) {
+
+            // sheet size
+            if (!strcmp (argv[a], "-x")) {
+                cols = atoi(argv[a+1]);
+                a += 2;
+
+            } else if (!strcmp (argv[a], "-y")) {
+                rows = atoi(argv[a+1]);
+                a += 2;
+
+            // reads per format
+            } else if (!strcmp (argv[a], "-n")) {
+                repeats = atoi(argv[a+1]);
+                a += 2;
+
+            // where the sheets go
+            } else if (!strcmp (argv[a], "-d")) {
+                dir = argv[a+1];
+                a += 2;
+            }
+        }
+
+        // one arg (a may have changed)
+        if (a < argc) {
+
+            // verbose
+            if (!strcmp (argv[a], "--verbose")) {
+                quiet = FALSE;
+                a++;
+
+            } else if (!strcmp (argv[a], "--help")) {
+                fprintf (stdout, "\nThe pgm/pbm loader against the old fscanf reader, on a sprite sheet.\n");
+                fprintf (stdout, "\nUsage: %s [-x cols] [-y rows] [-n repeats] [-d dir] [--verbose]\n", program_name);
+                fprintf (stdout, "\n    -x cols          sheet width (default %d)", cols);
+                fprintf (stdout, "\n    -y rows          sheet height (default %d)", rows);
+                fprintf (stdout, "\n    -n repeats       reads per format, the best counts (default %d)", repeats);
+                fprintf (stdout, "\n    -d dir           for the sheets (default %s)", dir);
+                fprintf (stdout, "\n   --verbose         print log on stderr\n\n");
+
+                exit (EXIT_SUCCESS);
+            }
+        }
+
+    } while ( (a < argc) && (a != last_a) );
+
+    if (cols < 1 || rows < 1 || repeats < 1) {
+        fprintf (stderr, "%s: bad sheet size, see --help\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+
+    info ("writing the sheets");
+    makeSheet();
+    writeSheets();
+
+    bands = (long)cols * ((rows + 7) / 8);
+    ref = malloc(bands);
+    out = malloc(bands);
+
+    info ("reading");
+    fprintf (stdout, "%dx%d sprite sheet\n", cols, rows);
+    fprintf (stdout, "%-14s %10s %9s %9s %9s %9s\n", "reader", "bytes", "ms", "MB/s", "Mpix/s", "speedup");
+
+    base = timeRead(oldRead, path("p2.pgm"), ref);
+    if (base < 0) {
+        fprintf (stderr, "%s: the old reader failed\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+    report("fscanf P2", path("p2.pgm"), base, base);
+
+    for (i=0; i<4; i++) {
+        memset(out, 0xAA, bands);
+        ms = timeRead(newRead, path(fmt[i][1]), out);
+        if (ms < 0) { fail = 1; continue; }
+        report(fmt[i][0], path(fmt[i][1]), ms, base);
+        if (memcmp(ref, out, bands)) {
+            fprintf (stderr, "%s: %s differs from the old reader\n", program_name, fmt[i][0]);
+            fail = 1;
+        }
+    }
+
+    free(ref);
+    free(out);
+    free(sheet);
+    exit (fail ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+
+void info (char * str) {
+    if (!quiet) {
+        fprintf(stderr,"\n%s",str);
+    }
+}
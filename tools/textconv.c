@@ -1,7 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <locale.h>
+#include <unistd.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 
 #define AUTHORS "Manuel Jerger"
 #define VERSION "0.1"
@@ -10,47 +13,20 @@
 #define FALSE (uint)0
 
 
-#define MSG_SEP         0x00
-#define END_OF_MEMORY   0x01
-
-#define SPEED1          0x02
-#define SPEED2          0x03
-#define SPEED3          0x04
-#define SPEED4          0x05
-#define SPEED5          0x06
-#define SPEED6          0x07
-#define SPEED7          0x08
-#define SPEED8          0x09
-
-#define INVERT          0x0A
-#define HALT            0x0B
-
-
-#define WAIT1           0x0E
-#define WAIT2           0x0F
-#define WAIT3           0x10
-#define WAIT4           0x11
-#define WAIT5           0x12
-#define WAIT6           0x13
-#define WAIT7           0x14
-#define WAIT8           0x15
-
-#define PICTURE1        0x16
-#define PICTURE2        0x17
-#define PICTURE3        0x18
-#define PICTURE4        0x19
-#define PICTURE5        0x1A
-#define PICTURE6        0x1B
-#define PICTURE7        0x1C
-#define PICTURE8        0x1D
-#define SPACER1         0x1E
-#define SPACER2         0x1F
-#define SPACE           0x20
+#include "libblinken.h"
 
 
 void readPicture (void);
+void readFlipbook (void);
 void readFile (void);
 void readStdin (void);
+void dump (FILE *, struct bl_image *);
+void report (struct bl_image *);
+void timeline (struct bl_image *);
+int subset (struct bl_image *);
+void writeGlyphs (void);
+int convertLines (void);
+int batchConvert (void);
 
 void info(char *);
 void err(char *);
@@ -59,162 +35,32 @@ void err(char *);
 char *program_name = "textconv";
 
 
-char *input, *output, *picture;
+char *input, *output, *picture, *flipbook;
+char *glyphout, *fontmap;  // font subsets: chars used -> file, file -> renumbered chars
+uint8_t used[256], glyphmap[256];
 
-int quiet = TRUE, usehex = FALSE, useEE = FALSE;
+int quiet = TRUE, usehex = FALSE, useEE = FALSE, uselines = FALSE, optimize = FALSE, usetimeline = FALSE;
+int flags;                 // for bl_convert()
 
-int tresh=127;             // pixel val treshold
-int picdata[64][8];        // raw picture data
-int inb[2048];             // utf8-free input (only commands left)
-int inpsize;               // length of valid input
-int outb[128];             // resulting eeprom hex (0xFF max)
+// batch mode: one image per line of the list, input is the template
+char *batch, *outdir = ".", *key = "VORNAME";
+int usecsv = FALSE, jobs = 0;
 
-int picpos=0;              // number of actually used eeprom pictures
-int lastpos=127;		   // last eeprom pos
-int maxmem=127;            // max mem pos we can write text & commands, without pictures (at least 1x EOM at end)
-int picid[8] = {-1,-1,-1,-1,-1,-1,-1,-1};       // mapping of pic IDs in input -> IDs in eeprom
-int separated = 0;           // true if last character was a \n -> message separator
+struct bl_pictures pics;   // eeprom pictures (-p), empty w/o
+struct bl_image img;       // resulting eeprom image
+const struct bl_profile *prof;  // memory of the device
+FILE *msgf;                // info/err, stderr if stdout is the image
 
-////////////////////////////////////////////////////////////////////////
-
-
-// checks if inb has n valid chars starting at position p
-int has(int p, int n) {}
-
-// convert input to output
-int convert() {
-    int ip=0, op=0;
-    
-    if (useEE) {            // for direct eeprom flashing : two dummy bytes
-        outb[op++] = 0x20;
-        outb[op++] = 0x20;
-    }
-    
-    int eflag = FALSE;      // for escape char detection
-
-    while (ip < inpsize) {
-
-        if (op == maxmem) {
-            err("no more memory left in device for textdata");
-            exit (EXIT_FAILURE);
-        }
-
-        int c = inb[ip];
+unsigned char text[BL_MAXINPUT];    // raw input file / template
+int textsize;
 
-        // if escape chr was last
-        if (eflag) {
-            eflag = FALSE;
-
-            // its just an escaped backslash..
-            if (c == '\\') {
-                outb[op++] = c;
-                ++ip;
-            // read whole command, three chars incl backslash
-            } else {
-                ++ip;
-                int num = -1; // for numbered commands
-                char nc;
-                // check if next char is a number
-                if (ip+1 < inpsize) { 
-                    nc = inb[ip];
-                    
-                    if (nc-0x30 >= 0 && nc-0x30 <= 0x09) { 
-                        num = nc-0x30;
-                    }
-                }
-                if (c == 'I') {             // invert
-                    outb[op++] = INVERT;
-                    
-                } else if (c == 'H') {      // halt
-                    outb[op++] = HALT;
-                    
-                } else {
-                    ++ip;
-                    int fail = FALSE;
-                    
-                        
-                    if (num >= 1) {
-                        switch (c) {
-                            case 'S' : case 's' :     // 8 speeds
-                                if (num <= 8) { outb[op++] = num-1 + SPEED1; }
-                                else { fail = TRUE; }
-                                break;
-                            case 'W' : case 'w' :     // 8 waits
-                                if (num <= 8) { outb[op++] = num-1 + WAIT1; }
-                                else { fail = TRUE; }
-                                break;
-                            case 'P' : case 'p' :     // 8 pictures
-                                if (num <= 8) { outb[op++] = convertPicture (num-1) + PICTURE1; }
-                                else { fail = TRUE; }
-                                break;
-                            case 'D' : case 'd' :     // 2 spacers
-                                if (num <= 2) { outb[op++] = num-1 + SPACER1; }
-                                else { fail = TRUE; }
-                                break;
-                        }
-                    }
-                    
-                }
-                
-            }
-
-            
-        // no eflag set
-        } else {
-        
-            
-            // read on only char : 
-
-            // newline = msg sep (onlye once, swallow empty lines)
-            if (c == '\n') {
-                if (separated) { 
-                    separated = 0; 
-                } else {
-                    outb[op++] = 0x00; 
-                    separated = 1; 
-                }
-                
-            } else {
-                separated = 0;    
-
-                // escape character '\' special handling
-                if (c == '\\') {
-                    eflag = TRUE;   // if next char is also a '\', it gets copied
-                } else if (c < SPACE) {
-                    
-                    // ???????
-
-                // ascii 127, printable characters + converted utf8 chars
-                } else if (c >= SPACE) {
-                    outb[op++] = c;
-                }
-            }
-            
-            ++ip;
-        }
-    }
-    
-    // append end-of-message
-    //if (op > 0) {
-        if (outb[op-1] == 0x00) {
-            outb[op-1] = 0x01;        // replace last MSG Sep. by EOM
-        } else {
-            outb[op++] = 0x01;      // additional EOM
-        }
-    //}
-        
-
-    return op;
-}
-
-
- 
 ////////////////////////////////////////////////////////////////////////
 
 int main (int argc, char **argv)
 {
 
     program_name = argv[0];
+    prof = bl_profile(NULL);
     
         //setlocale (LC_ALL, "");
         //bindtextdomain (PACKAGE, LOCALEDIR);
@@ -225,7 +71,7 @@ int main (int argc, char **argv)
 
 
     // while args left..
-    int a = 1; int last_a = 1;
+    int a = 1; int last_a = 1, i;
     do {
         last_a = a;
         // two args
@@ -241,10 +87,54 @@ int main (int argc, char **argv)
                 picture = argv[a+1];
                 a += 2;
 
+            // flipbook frames (8x8 pixels each)
+            } else if (!strcmp (argv[a], "-f")) {
+                flipbook = argv[a+1];
+                a += 2;
+
             // outfile
             } else if (!strcmp (argv[a], "-o")) {
                 output = argv[a+1];
                 a += 2;
+
+            // batch: list of substitutions for the template (-i)
+            } else if (!strcmp (argv[a], "-b")) {
+                batch = argv[a+1];
+                a += 2;
+
+            // batch: output directory
+            } else if (!strcmp (argv[a], "-d")) {
+                outdir = argv[a+1];
+                a += 2;
+
+            // batch: placeholder in the template
+            } else if (!strcmp (argv[a], "-k")) {
+                key = argv[a+1];
+                a += 2;
+
+            // batch: worker processes
+            } else if (!strcmp (argv[a], "-j")) {
+                jobs = atoi(argv[a+1]);
+                a += 2;
+
+            // write the font chars used
+            } else if (!strcmp (argv[a], "--glyphs")) {
+                glyphout = argv[a+1];
+                a += 2;
+
+            // images for a font subset
+            } else if (!strcmp (argv[a], "--font-map")) {
+                fontmap = argv[a+1];
+                a += 2;
+
+            // device profile
+            } else if (!strcmp (argv[a], "--profile")) {
+                prof = bl_profile(argv[a+1]);
+                if (prof == NULL) {
+                    fprintf (stderr, "%s: unknown profile %s, see --help\n", program_name, argv[a+1]);
+                    exit (EXIT_FAILURE);
+                }
+                a += 2;
             }
             
         } 
@@ -261,6 +151,26 @@ int main (int argc, char **argv)
             } else if (!strcmp (argv[a], "--ee")) {
                 useEE = TRUE;
                 a++;
+
+            // smallest program that shows the same
+            } else if (!strcmp (argv[a], "-O") || !strcmp (argv[a], "--optimize")) {
+                optimize = TRUE;
+                a++;
+
+            // how long the messages play
+            } else if (!strcmp (argv[a], "--timeline")) {
+                usetimeline = TRUE;
+                a++;
+
+            // batch: list is csv, the header names the placeholders
+            } else if (!strcmp (argv[a], "--csv")) {
+                usecsv = TRUE;
+                a++;
+
+            // stream: one image per line of stdin
+            } else if (!strcmp (argv[a], "--lines")) {
+                uselines = TRUE;
+                a++;
                         
             // verbose
             } else if (!strcmp (argv[a], "--verbose")) {
@@ -270,9 +180,28 @@ int main (int argc, char **argv)
                 
             } else if (!strcmp (argv[a], "--help")) {
                 fprintf (stdout, "\nConvert cleartext commands and readable characters to blinken64 eeprom format.\n");
-                fprintf (stdout, "\nUsage: %s [-i infile] [-o outfile] [--hex] [--verbose]\n", program_name);
-                fprintf (stdout, "\n    -i infile        read clear text from file");
+                fprintf (stdout, "\nUsage: %s [-i infile] [-o outfile] [-p picture] [-f strip] [--profile name] [--glyphs file] [--font-map file] [-O] [--timeline] [--hex] [--ee] [--verbose]\n", program_name);
+                fprintf (stdout, "\n       %s --lines [-p picture] [--hex] [--ee] < texts > images\n", program_name);
+                fprintf (stdout, "\n       %s -i template -b list [-d dir] [-k key | --csv] [-j n] [-p picture] [--hex] [--ee]\n", program_name);
+                fprintf (stdout, "\n    -i infile        read clear text from file (default: stdin, only the image goes to stdout)");
                 fprintf (stdout, "\n    -o outfile       dump output also to file");
+                fprintf (stdout, "\n    -p picture       eeprom pictures (8 pixel high pgm, 8 columns each: 64x8 for 8)");
+                fprintf (stdout, "\n    -f strip         flipbook for \\B1..\\B8, the wait between the frames (pgm/pbm, 8x8 per frame)");
+                fprintf (stdout, "\n   --profile name    device profile (default %s):", bl_profile(NULL)->name);
+                for (i=0; bl_profile_list(i); i++) {
+                    const struct bl_profile *p = bl_profile_list(i);
+                    fprintf (stdout, "\n                       %-12s %4d byte eeprom, %2d pictures", p->name, p->eeprom, p->pictures);
+                }
+                fprintf (stdout, "\n   --glyphs file     write the font chars used by the images (for fontconv --subset)");
+                fprintf (stdout, "\n   --font-map file   images for a firmware w/ a font subset (the --glyphs file it was made of)");
+                fprintf (stdout, "\n    -b list          batch: one image per line, key in the template replaced by the line");
+                fprintf (stdout, "\n    -d dir           batch: write images to dir/0001.bin .. (default .)");
+                fprintf (stdout, "\n    -k key           batch: placeholder (default %s)", key);
+                fprintf (stdout, "\n    -j n             batch: worker processes (default: one per cpu)");
+                fprintf (stdout, "\n   --csv             batch: list is csv, the header line names the placeholders");
+                fprintf (stdout, "\n   --lines           one image per line of stdin, written as soon as the line is read");
+                fprintf (stdout, "\n    -O, --optimize   smallest image that shows the same: no settings that change nothing,\n                     waits and blanks w/ as few codes as possible, pictures of the same content once");
+                fprintf (stdout, "\n   --timeline        how long every message plays (one pass, its parts), how long the button\n                     takes at most, what scrolls unevenly");
                 fprintf (stdout, "\n   --hex             use readable hex format as output");
                 fprintf (stdout, "\n   --ee              output for flashing eeprom directly (adds two dummy bytes at the beginning)");
                 fprintf (stdout, "\n   --verbose         print err/log on stdout\n\n");
@@ -282,12 +211,34 @@ int main (int argc, char **argv)
         }
 
     } while ( (a < argc) && (a != last_a) );
+
+    flags = (useEE ? BL_EE : 0) | (optimize ? BL_OPTIMIZE : 0);
     
-	// direct eeprom flash: picture positions moved left by two
-    if (useEE) { lastpos = 128; } else { lastpos = 126; } 
-    
+    msgf = stdout;
+    if (input == NULL && batch == NULL) { msgf = stderr; }
+
     // load picture data
     if (picture != NULL ) { readPicture(); }
+    if (flipbook != NULL ) { readFlipbook(); }
+
+    if (fontmap != NULL && bl_read_glyphs(fontmap, glyphmap) < 0) {
+        fprintf (stderr, "%s: can not read the glyphs %s\n", program_name, fontmap);
+        exit (EXIT_FAILURE);
+    }
+
+    // many images from one template
+    if (batch != NULL) {
+        if (input == NULL) {
+            fprintf (stderr, "%s: batch mode needs the template (-i)\n", program_name);
+            exit (EXIT_FAILURE);
+        }
+        exit (batchConvert() ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    // stream of texts
+    if (uselines) {
+        exit (convertLines() ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
     
     // read from file
     if (input != NULL) { 
@@ -295,14 +246,24 @@ int main (int argc, char **argv)
     
     // read from stdin
     } else {
-        // TODO
+        readStdin();
     }
     
     // start converting
-    int len = convert();
-    // if memory contains pictures, dump the whole range
-    //if (picpos > 0) {len = 127;}
-                
+    int over = bl_convert((char *)text, textsize, &pics, prof, flags, &img);
+    report(&img);
+
+    if (optimize) {
+        char s[100];
+        snprintf(s, sizeof(s), "optimized: %d bytes of text, %d bytes saved", img.len, img.saved);
+        info(s);
+    }
+
+    if (over || subset(&img)) {
+        exit (EXIT_FAILURE);
+    }
+    writeGlyphs();
+    if (usetimeline) { timeline(&img); }
   
 
     // dump result to file
@@ -312,178 +273,616 @@ int main (int argc, char **argv)
         info ("dumping output to file");
 
         f = fopen(output,"w");
-        
-        int p;
-        if (usehex) {
-            for (p=0; p<lastpos; p++) { fprintf(f,"0x%1x,",outb[p]);  }
-        } else {
-            for (p=0; p<lastpos; p++) { fprintf(f,"%c",(char)outb[p]);  }
-        }
+        dump(f, &img);
         fclose(f);
     }
+
+    // stdin -> stdout: nothing but the image, for pipes
+    if (input == NULL) {
+        dump(stdout, &img);
+        exit (EXIT_SUCCESS);
+    }
     
     info ("Done\nresult:\n\n");
     
     // print to stdout
-    int p;
+    dump(stdout, &img);
+    fprintf(stdout,"\n\n");
     
+    exit (EXIT_SUCCESS);
+}
+
+
+
+// dump the image, binary or readable hex
+void dump (FILE *f, struct bl_image *img) {
+    int p;
     if (usehex) {
-        for (p=0; p<lastpos; p++) { fprintf(stdout,"0x%1x,",outb[p]);  }
+        for (p=0; p<img->size; p++) { fprintf(f,"0x%1x,",img->data[p]);  }
     } else {
-        for (p=0; p<lastpos; p++) { fprintf(stdout,"%c",(char)outb[p]);  }
+        fwrite(img->data, 1, img->size, f);
     }
-    fprintf(stdout,"\n\n");
-    
-    exit (EXIT_SUCCESS);
 }
 
 
+/*
+ * font subsets: collects the chars for --glyphs, renumbers them w/
+ * --font-map. returns the number of chars that are not in the subset
+ */
+int subset (struct bl_image *img) {
+    int missing = 0;
 
-void readStdin () {
-    
+    if (glyphout != NULL) { bl_glyphs_used(img, used); }
+    if (fontmap != NULL && (missing = bl_remap(img, glyphmap))) {
+        fprintf (stderr, "%s: %d chars not in the font subset %s\n", program_name, missing, fontmap);
+    }
+    return missing;
+}
+
+
+void writeGlyphs () {
+    int n;
+    char s[100];
+
+    if (glyphout == NULL) { return; }
+    n = bl_write_glyphs(glyphout, used);
+    if (n < 0) {
+        fprintf (stderr, "%s: can not write %s\n", program_name, glyphout);
+        exit (EXIT_FAILURE);
+    }
+    snprintf(s, sizeof(s), "%d font chars used, written to %s", n, glyphout);
+    info(s);
+}
+
+
+// what the converter skipped or complained about
+void report (struct bl_image *img) {
+    int i;
+    char s[100];
+    for (i=0; i<img->ndiag; i++) {
+        snprintf(s, sizeof(s), "%s (at %d)", img->diag[i].msg, img->diag[i].pos);
+        err(s);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// timeline: the image on the player, every code and column w/ its time
+
+#define TL_PASSES   (2)         // the first pass of a message, then one as it loops
+#define TL_LIMIT    (3600 * 1000000LL / BL_TICK_US)
+#define TL_UNEVEN   (0.2)       // columns (frames) that take this much longer than others look jerky
+
+struct event {
+    int pos;                    // code: eeprom address, -1: a column (or flipbook frame)
+    int64_t tick;               // code read, column transmitted
+    int msg, pass;
+};
+
+struct event *events;
+int nevents, maxevents;
+
+
+void addEvent (int pos, int64_t tick, int msg, int pass) {
+    if (nevents == maxevents) {
+        maxevents = maxevents * 2 + 1024;
+        events = realloc(events, maxevents * sizeof(struct event));
+        if (events == NULL) {
+            fprintf (stderr, "%s: out of memory\n", program_name);
+            exit (EXIT_FAILURE);
+        }
+    }
+    events[nevents].pos = pos;
+    events[nevents].tick = tick;
+    events[nevents].msg = msg;
+    events[nevents].pass = pass;
+    nevents++;
+}
+
+
+void onStep (struct bl_player *pl, int pos, void *arg) {
+    (void)arg;
+    addEvent(pos, pl->tick, pl->msg, pl->pass);
+}
+
+
+double ms (int64_t ticks) { return ticks * BL_TICK_US / 1000.0; }
+
+
+/*
+ * one part of a message: codes that scroll (text, pictures, blanks), a
+ * wait, a flipbook (its frames and the waits between them), a halt.
+ * settings (speed, font, invert) take no time, they go w/ the next part
+ */
+struct part {
+    int kind, from, to;         // kind: 'T'ext, 'W'ait, 'F'lipbook, 'H'alt; eeprom addresses
+    int64_t at, ticks;          // since the message started
+    int columns, speed;         // columns, flipbook frames
+    int64_t colmin, colmax;     // per column, between the frames
+    int64_t lastframe;
+    char label[28];
+};
+
+
+// one line, and a second one w/ ! if it looks jerky
+void printPart (struct part *p, struct part *before) {
+    char where[24];
+    int64_t spread = p->colmax - p->colmin;
+
+    snprintf(where, sizeof(where), p->to > p->from + 1 ? "%d..%d" : "%d", p->from, p->to - 1);
+    if (p->kind == 'H') {
+        fprintf (msgf, "  %10.1f %10s  %-9s ", ms(p->at), "-", where);
+    } else {
+        fprintf (msgf, "  %10.1f %10.1f  %-9s ", ms(p->at), ms(p->ticks), where);
+    }
+
+    if (p->kind == 'T') {
+        if (p->columns && !p->colmax) {
+            fprintf (msgf, "\\S1 \"%s\", %d columns at once\n", p->label, p->columns);
+        } else {
+            fprintf (msgf, "\\S%d \"%s\", %d columns, %.1f..%.1f ms each\n", p->speed + 1, p->label, p->columns,
+                     ms(p->colmin), ms(p->colmax));
+        }
+        if (p->columns > 1 && spread > TL_UNEVEN * p->colmin) {
+            fprintf (msgf, "  ! uneven: sending a column to the next display takes longer the more bits are set,\n"
+                           "    at \\S%d that is a large part of the time of a column. a slower speed evens it out\n", p->speed + 1);
+        }
+        // one text right after the other, at another speed
+        if (before->kind == 'T' && before->at + before->ticks == p->at && p->columns && before->columns
+                && p->speed != before->speed && p->colmin && before->colmin) {
+            double a = (double)before->ticks / before->columns, b = (double)p->ticks / p->columns;
+            if (a > b * (1 + TL_UNEVEN) || b > a * (1 + TL_UNEVEN)) {
+                fprintf (msgf, "  ! the speed jumps in the middle of the scrolling, %.1f -> %.1f ms per column\n", ms(a), ms(b));
+            }
+        }
+
+    } else if (p->kind == 'F') {
+        fprintf (msgf, "flipbook, %d frames, %.1f..%.1f ms apart\n", p->columns, ms(p->colmin), ms(p->colmax));
+        if (p->columns > 2 && spread > TL_UNEVEN * p->colmin) {
+            fprintf (msgf, "  ! the frames come at uneven intervals\n");
+        }
+    } else if (p->kind == 'H') {
+        fprintf (msgf, "halt, until the button\n");
+    } else {
+        fprintf (msgf, "wait\n");
+    }
 }
 
 
+/*
+ * the image on the player (the firmware's timing): every message a pass,
+ * then once more as it loops, then the button. per message the time of a
+ * pass, its parts, and how long the button takes at most: waits and the
+ * column that is scrolling are not cut short, the rest of the message is
+ * skipped at once. parts that look jerky are marked w/ !
+ */
+void timeline (struct bl_image *img) {
+
+    struct bl_player pl;
+    struct bl_frame fr;
+    struct part p, before;
+    int i, m, c, first = 0, next, speed = 4;
+    int64_t total = 0;
+
+    bl_player_init(&pl, img->data, img->size, prof);
+    pl.loops = TL_PASSES;
+    pl.hold = 1;
+    pl.onstep = onStep;
+    nevents = 0;
+
+    while (bl_player_next(&pl, &fr) && pl.tick < BL_BOOT_TICKS + TL_LIMIT) {
+        addEvent(-1, fr.txtick, fr.msg, pl.pass);
+    }
+    addEvent(-2, pl.tick, -1, 0);
+
+    fprintf (msgf, "\ntimeline (%s): every message one pass, then it loops until the button\n", prof->name);
+
+    for (m=0; first < nevents - 1; m++) {
+
+        int64_t start = events[first].tick, end, loop = -1, latency = 0;
+        int halted = 0, lost = 0;
+
+        // this pass: up to the next one / message. the loop: up to the message after
+        for (next = first; events[next].msg == m && events[next].pass == 0; next++) { }
+        end = events[next].tick;
+        if (events[next].msg == m) {
+            for (i = next; events[i].msg == m; i++) { }
+            loop = events[i].tick - end;
+        }
+
+        memset(&before, 0, sizeof(before));
+        memset(&p, 0, sizeof(p));
+        fprintf (msgf, "\nmessage %d\n  %10s %10s  %-9s what\n", m + 1, "at [ms]", "time [ms]", "eeprom");
+
+        for (i = first; i < next; i++) {
+            struct event *e = &events[i];
+            int64_t len = events[i+1].tick - e->tick;
+
+            // a column (till the next one / code), a flipbook frame
+            if (e->pos == -1) {
+                if (p.kind == 'T') {
+                    if (!p.columns || len < p.colmin) { p.colmin = len; }
+                    if (len > p.colmax) { p.colmax = len; }
+                    if (len > latency) { latency = len; }
+                } else if (p.kind == 'F' && p.columns) {
+                    int64_t gap = e->tick - p.lastframe;
+                    if (p.columns == 1 || gap < p.colmin) { p.colmin = gap; }
+                    if (gap > p.colmax) { p.colmax = gap; }
+                }
+                p.lastframe = e->tick;
+                p.columns++;
+                continue;
+            }
+
+            c = pl.ee[e->pos];
+            if (c <= END_OF_MEMORY) { break; }
+
+            // after a halt the button was pressed: the rest of the message is skipped
+            if (halted) {
+                if (bl_scrolls(c) || c == FLIP_KEY || c == FLIP_DELTA) { lost = 1; }
+                continue;
+            }
+
+            if (c >= SPEED1 && c <= SPEED8) { speed = c - SPEED1; }
+            if (c >= WAIT1 && c <= WAIT8 && len > latency) { latency = len; }
+
+            // goes on: text w/ text at the same speed, a flipbook w/ its frames and the waits between them
+            if ((p.kind == 'T' && bl_scrolls(c) && speed == p.speed) || (p.kind == 'F' && (c == FLIP_KEY || c == FLIP_DELTA || (c >= WAIT1 && c <= WAIT8)))) {
+
+            } else if (bl_scrolls(c) || c == FLIP_KEY || c == FLIP_DELTA || c == HALT || (c >= WAIT1 && c <= WAIT8)) {
+                if (p.kind) { p.ticks = e->tick - start - p.at; printPart(&p, &before); before = p; }
+                memset(&p, 0, sizeof(p));
+                p.kind = bl_scrolls(c) ? 'T' : c == HALT ? 'H' : c >= WAIT1 && c <= WAIT8 ? 'W' : 'F';
+                p.from = e->pos;
+                p.at = e->tick - start;
+                p.speed = speed;
+                halted = c == HALT;
+
+            // a setting
+            } else {
+                continue;
+            }
+
+            p.to = e->pos + (c == PICTURE_X ? 2 : 1);
+            if (p.kind == 'T' && strlen(p.label) < sizeof(p.label) - 5) {
+                char *l = p.label + strlen(p.label);
+                if (c >= PICTURE1 && c <= PICTURE8) { sprintf(l, "[P%d]", c - PICTURE1 + 1); }
+                else if (c == PICTURE_X) { sprintf(l, "[P%d]", pl.ee[e->pos + 1] + 1); }
+                else if (c <= SPACE) { *l = ' '; }
+                else { *l = c < 127 && c != '"' ? c : '?'; }
+            }
+        }
+        // up to the end of the pass (the last column's framewait, the flipbook's last wait)
+        if (p.kind && !halted) { p.ticks = end - start - p.at; }
+        if (p.kind) { printPart(&p, &before); }
+
+        fprintf (msgf, "  %s %.3f s", halted ? "up to the halt" : "one pass", ms(end - start) / 1000);
+        if (loop >= 0 && loop != end - start) { fprintf (msgf, ", as it loops %.3f s", ms(loop) / 1000); }
+        fprintf (msgf, ", the button: next message after %.1f ms at most\n", ms(latency));
+        if (lost) { fprintf (msgf, "  ! after the halt: never shown, the button skips the rest of the message\n"); }
+        total += end - start;
+
+        for (first = next; events[first].msg == m; first++) { }
+    }
+
+    fprintf (msgf, "\nplaylist %.3f s, every message one pass\n", ms(total) / 1000);
+}
+
+void readStdin () {
+
+    info ("reading utf8 from stdin");
+
+    textsize = fread(text, 1, sizeof(text), stdin);
+    if (getchar() != EOF) {
+        fprintf (stderr, "%s: stdin: more than %d bytes of text\n", program_name, (int)sizeof(text));
+        exit (EXIT_FAILURE);
+    }
+}
+
 
-// process unicode low level (we need only a few special chars for german text)
 void readFile () {
     
     FILE *f;
-    int pos=0;
     
     info ("reading input utf8 file");
     
     f = fopen(input,"r");
-  
-    int ic;
-    do {
-        ic = fgetc(f);
-    
-        
-        // ascii, utf8 compatible
-        if (ic < 128) { 
-            inb[pos++] = ic;
-            
-        // utf8
-        } else {
-            int fail = FALSE;
-            
-            if (ic == 195) {
-                ic = fgetc(f);
-                switch (ic) {
-                    case 132 : inb[pos++] = 129; break; //Ä
-                    case 150 : case 182 :  inb[pos++] = 130; break;//Ö//ö
-                    case 156 : case 188 :  inb[pos++] = 131; break;//Ü //ü
-                    case 159 : inb[pos++] = 132; break; //ß
-                    case 164 : inb[pos++] = 133; break; //ä
-                    default : fail = TRUE;
-                }
-            } else if (ic == 226) {
-                ic = fgetc(f);
-                if (ic == 130) {
-                    ic = fgetc(f);
-                    if (ic == 172) {        // €
-                        inb[pos++] = 128;
-                        
-                    } else { fail = TRUE; }
-                } else { fail = TRUE; }
-             }
-             
-             if (fail) { err ("unknow char in UTF range"); }
-        }
-    } while (ic != EOF);
-    
-    inpsize = pos;
-    
+    if (f == NULL) {
+        fprintf (stderr, "%s: can not open %s\n", program_name, input);
+        exit (EXIT_FAILURE);
+    }
+    textsize = fread(text, 1, sizeof(text), f);
+    if (fgetc(f) != EOF) {
+        fprintf (stderr, "%s: %s: more than %d bytes of text\n", program_name, input, (int)sizeof(text));
+        fclose(f);
+        exit (EXIT_FAILURE);
+    }
     fclose(f);
-    
 }
 
-void info (char * str) {
-    if (!quiet) {
-        fprintf(stdout,"\n%s",str);
+
+
+/*
+ * stdin -> stdout, one image per line, flushed right away: for pipes from
+ * other programs that produce the texts. a line that does not fit is
+ * reported on stderr and gives no image (an empty line w/ --hex). returns
+ * the number of those
+ */
+int convertLines () {
+
+    char line[sizeof(text) + 3];     // w/ \r\n
+    int nr = 0, failed = 0, c;
+
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        int len = strlen(line), cut = FALSE;
+        nr++;
+
+        // no newline in the buffer: skip the rest of the line, no image for it
+        if (len == sizeof(line) - 1 && line[len-1] != '\n') {
+            while ((c = getchar()) != EOF && c != '\n') { }
+            cut = TRUE;
+        }
+        if (len && line[len-1] == '\n') { line[--len] = 0; }
+        if (len && line[len-1] == '\r') { line[--len] = 0; }
+
+        if (cut || len > (int)sizeof(text)) {
+            fprintf (stderr, "%s: line %d: more than %d bytes of text\n", program_name, nr, (int)sizeof(text));
+            failed++;
+            if (usehex) { fprintf(stdout, "\n"); }
+            fflush(stdout);
+            continue;
+        }
+
+        int over = bl_convert(line, len, &pics, prof, flags, &img);
+        report(&img);
+        if (over) {
+            fprintf (stderr, "%s: line %d: %d bytes over the %d byte budget\n",
+                     program_name, nr, over, img.budget);
+            failed++;
+        } else if (subset(&img)) {
+            fprintf (stderr, "%s: line %d: not for this font\n", program_name, nr);
+            failed++;
+        } else {
+            dump(stdout, &img);
+        }
+        if (usehex) { fprintf(stdout, "\n"); }
+        fflush(stdout);
     }
+    writeGlyphs();
+    return failed;
 }
 
-void err (char * str) {
-    if (!quiet) {
-        fprintf(stdout, "\nfail : %s",str);
+
+
+////////////////////////////////////////////////////////////////////////
+// batch mode
+
+#define MAXKEYS     16
+
+// split a csv line in place: fields separated by ',', "quoted" w/ "" inside
+int splitCsv (char *line, char **fields, int max) {
+    int n = 0;
+    char *r = line, *w;
+
+    while (n < max) {
+        fields[n++] = w = r;
+        if (*r == '"') {
+            r++;
+            while (*r && !(*r == '"' && r[1] != '"')) {
+                if (*r == '"') { r++; }
+                *w++ = *r++;
+            }
+            if (*r == '"') { r++; }
+        } else {
+            while (*r && *r != ',') { *w++ = *r++; }
+        }
+        if (*r != ',') { *w = 0; break; }
+        *w = 0;
+        r++;
     }
+    return n;
 }
 
 
-////////////////////////////////////////////////////////////////////////
+// template w/ every key replaced by the matching field, into buf
+int substitute (char *buf, int size, char **keys, char **fields, int n) {
+    int i, k, len = 0;
 
-void readPicture () {
-    FILE* f;
-    char s[60];
-    char c;
-    int x,y;
-    int width, height, maxgrey;
-    
-    info ("reading input picture");
-    f = fopen(picture,"r");
+    for (i=0; i<textsize; i++) {
+        for (k=0; k<n; k++) {
+            int kl = strlen(keys[k]);
+            if (kl && i + kl <= textsize && !memcmp(text + i, keys[k], kl)) { break; }
+        }
+        if (k < n) {
+            int fl = strlen(fields[k]);
+            if (len + fl >= size) { return -1; }
+            memcpy(buf + len, fields[k], fl);
+            len += fl;
+            i += strlen(keys[k]) - 1;
+        } else {
+            if (len + 1 >= size) { return -1; }
+            buf[len++] = text[i];
+        }
+    }
+    return len;
+}
 
-    fscanf(f,"%s", s);  // pgm descriptor
 
-    fscanf(f,"%c",&c);  // newline
+/*
+ * the template (-i) once per entry of the list (-b). the entries are split
+ * among -j worker processes; the pictures are read before the fork, so they
+ * are parsed only once. every entry that does not fit is reported on stderr.
+ * returns the number of those
+ */
+int batchConvert () {
 
-    fscanf(f,"%c",&c);  // sharp or number
-    if (c == '#') {
-        do {
-            fscanf(f,"%c",&c);
-        } while (c != '\n');  // skip line
+    FILE *f;
+    char **lines = NULL, *list, *keys[MAXKEYS];
+    int nlines = 0, maxlines = 0, nkeys = 1, first = 0, i, w;
+    long size;
+
+    readFile();
+
+    // whole list in memory, split in lines
+    f = fopen(batch, "r");
+    if (f == NULL) {
+        fprintf (stderr, "%s: can not open %s\n", program_name, batch);
+        exit (EXIT_FAILURE);
     }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    rewind(f);
+    list = malloc(size + 1);
+    size = fread(list, 1, size, f);
+    list[size] = 0;
+    fclose(f);
 
-    fscanf(f,"%d %d", &width, &height);
+    char *l = list;
+    while (*l) {
+        char *nl = strchr(l, '\n');
+        if (nl) { *nl = 0; }
+        if (nl > l && nl[-1] == '\r') { nl[-1] = 0; }
+        if (nlines == maxlines) {
+            maxlines = maxlines ? 2 * maxlines : 1024;
+            lines = realloc(lines, maxlines * sizeof(char *));
+            if (lines == NULL) {
+                fprintf (stderr, "%s: %s: out of memory at entry %d\n", program_name, batch, nlines);
+                exit (EXIT_FAILURE);
+            }
+        }
+        if (*l) { lines[nlines++] = l; }
+        if (!nl) { break; }
+        l = nl + 1;
+    }
 
-    if (width != 64 || height != 8) {
-      err("picture dimensions do not match w*h = 64*8 pixels");
-      fclose (f);
-      exit(EXIT_FAILURE);
+    keys[0] = key;
+    if (usecsv && nlines) {
+        nkeys = splitCsv(lines[0], keys, MAXKEYS);
+        first = 1;
     }
 
-    fscanf(f,"%d\n",&maxgrey);
-    tresh = maxgrey/2;
+    // the font chars of all entries, before the workers
+    if (glyphout != NULL) {
+        for (i=first; i<nlines; i++) {
+            char buf[sizeof(text)], *fields[MAXKEYS], *line = strdup(lines[i]);  // split in place
+            int n = 1, len;
 
-    for (y = 0; y < 8; ++y) {
-        for (x = 0; x < 64; ++x) {
-            fscanf(f,"%d ", &(picdata[x][y]));
+            fields[0] = line;
+            if (usecsv) { n = splitCsv(line, fields, nkeys); }
+            while (n < nkeys) { fields[n++] = ""; }
+
+            len = substitute(buf, sizeof(buf), keys, fields, nkeys);
+            if (len >= 0) {
+                bl_convert(buf, len, &pics, prof, flags, &img);
+                bl_glyphs_used(&img, used);
+            }
+            free(line);
         }
+        writeGlyphs();
     }
 
-    fclose (f);
-}
+    if (jobs <= 0) { jobs = sysconf(_SC_NPROCESSORS_ONLN); }
+    if (jobs > nlines - first) { jobs = nlines - first; }
+    if (jobs < 1) { jobs = 1; }
+
+    // workers report their number of failed entries through the pipe
+    int fds[2];
+    if (pipe(fds)) {
+        fprintf (stderr, "%s: pipe failed\n", program_name);
+        exit (EXIT_FAILURE);
+    }
 
+    for (w=0; w<jobs; w++) {
+        if (fork() == 0) {
+            int failed = 0;
+            close(fds[0]);
 
+            for (i=first+w; i<nlines; i+=jobs) {
+                char buf[sizeof(text)], *fields[MAXKEYS], name[4096];
+                int n = 1, len;
 
-// converts slice of loaded image to one eeprom picture (#idx) and places result at corresponding position at the end of memory
-// decrements maxmem, returns real pic id
-int convertPicture (int idx) {
-    
-    // pic is not used yet
-    if (picid[idx] == -1) {    
-        picid[idx] = picpos;
-
-        // copy data to eeprom
-        int i,b;
-        for (i = 0; i < 8; ++i) {
-
-            int col = 0;
-            for (b = 0; b < 8; ++b) {
-                if (picdata[idx*8+i][b] > tresh) {
-                    col |= (1<<b);
+                fields[0] = lines[i];
+                if (usecsv) { n = splitCsv(lines[i], fields, nkeys); }
+                while (n < nkeys) { fields[n++] = ""; }
+
+                len = substitute(buf, sizeof(buf), keys, fields, nkeys);
+                if (len < 0) {
+                    fprintf (stderr, "%s: entry %d (%s): too long\n", program_name, i+1-first, fields[0]);
+                    failed++;
+                    continue;
+                }
+                int over = bl_convert(buf, len, &pics, prof, flags, &img);
+                if (over) {
+                    fprintf (stderr, "%s: entry %d (%s): %d bytes over the %d byte budget\n",
+                             program_name, i+1-first, fields[0], over, img.budget);
+                    failed++;
+                    continue;
+                }
+                if (fontmap != NULL && bl_remap(&img, glyphmap)) {
+                    fprintf (stderr, "%s: entry %d (%s): not for the font subset %s\n",
+                             program_name, i+1-first, fields[0], fontmap);
+                    failed++;
+                    continue;
+                }
+
+                snprintf(name, sizeof(name), "%s/%04d.%s", outdir, i+1-first, usehex ? "hex" : "bin");
+                f = fopen(name, "w");
+                if (f == NULL) {
+                    fprintf (stderr, "%s: can not write %s\n", program_name, name);
+                    failed++;
+                    continue;
                 }
+                dump(f, &img);
+                fclose(f);
             }
-            
-			outb[lastpos - picpos*8 - 8 + i] = col;
-            
+
+            if (write(fds[1], &failed, sizeof(failed)) != sizeof(failed)) { exit (EXIT_FAILURE); }
+            exit (EXIT_SUCCESS);
         }
-        
-        maxmem -= 8;
-        picpos++;
     }
-    
-    // return the actual used pic-ID used in eeprom
-    return picid[idx];  
+
+    close(fds[1]);
+    int failed = 0, n;
+    while (read(fds[0], &n, sizeof(n)) == sizeof(n)) { failed += n; }
+    while (wait(NULL) > 0) {}
+
+    fprintf (stdout, "%d images from %s in %s, %d did not fit, %d workers\n",
+             nlines - first - failed, input, outdir, failed, jobs);
+    return failed;
+}
+
+void info (char * str) {
+    if (!quiet) {
+        fprintf(msgf,"\n%s",str);
+    }
+}
+
+void err (char * str) {
+    if (!quiet) {
+        fprintf(msgf, "\nfail : %s",str);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+
+void readPicture () {
+
+    info ("reading input picture");
+
+    if (bl_read_pictures(picture, &pics) < 0) {
+        fprintf (stderr, "%s: %s is no pgm/pbm of at least 8 rows\n", program_name, picture);
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+void readFlipbook () {
+
+    info ("reading flipbook");
+
+    if (bl_read_flipbook(flipbook, &pics) < 0) {
+        fprintf (stderr, "%s: %s is no pgm/pbm of at least 8 rows\n", program_name, flipbook);
+        exit (EXIT_FAILURE);
+    }
 }